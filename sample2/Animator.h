@@ -0,0 +1,162 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+
+//関節の階層と動き
+#include "Skeleton.h"
+
+//ユニフォームバッファオブジェクト
+#include "Uniform.h"
+
+//パレットの結合ポイント
+#include "ShaderVariants.h"
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+// 同じ骨格を持つ多数のキャラクタの動き
+//  キャラクタごとに二つの動きとその混ぜる割合を持ち、update() で時刻を進めて
+//  サンプリング、混ぜ合わせ、関節の階層の計算をキャラクタごとに並列に行い、
+//  全てのキャラクタのパレットを一つの Uniform<Palette> にまとめて転送する
+//  描画するときは select() でそのキャラクタのパレットを結合する
+class Animator
+{
+    //キャラクタの状態
+    struct Character
+    {
+        //再生している動きと混ぜる動き（なければ NULL）
+        const AnimationClip *clip[2];
+
+        //それぞれの動きの時刻（秒）
+        GLfloat time[2];
+
+        //二つ目の動きを混ぜる割合
+        GLfloat weight;
+    };
+
+    //骨格
+    const Skeleton &skeleton;
+
+    //キャラクタ
+    std::vector<Character> characters;
+
+    //キャラクタごとのパレット
+    std::vector<Palette> palettes;
+
+    //パレットのユニフォームバッファオブジェクト
+    Uniform<Palette> uniform;
+
+    //一つのスレッドが一度に処理するキャラクタの数
+    static constexpr std::size_t grain = 32;
+
+    //[begin, end) のキャラクタの姿勢を求めてパレットにする
+    void evaluate(std::size_t begin, std::size_t end)
+    {
+        //作業用の姿勢はスレッドごとの範囲で一度だけ確保する
+        Pose pose(skeleton.size()), other(skeleton.size());
+        for(std::size_t i = begin; i < end; i++)
+        {
+            const Character &c(characters[i]);
+            if(c.clip[0] != NULL) c.clip[0] -> sample(c.time[0], pose);
+            else pose.resize(skeleton.size());
+            if(c.clip[1] != NULL && c.weight > 0.0f)
+            {
+                c.clip[1] -> sample(c.time[1], other);
+                blend(pose, other, c.weight, pose);
+            }
+            skeleton.evaluate(pose, palettes[i].joint);
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  skeleton: 全てのキャラクタに共通の骨格
+    //  capacity: キャラクタの数の上限
+    Animator(const Skeleton &skeleton, GLsizei capacity)
+    : skeleton(skeleton)
+    , palettes(capacity)
+    , uniform(NULL, capacity, "Animator")
+    {
+        characters.reserve(capacity);
+    }
+
+    //デストラクタ
+    virtual ~Animator()
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    Animator(const Animator &a);
+    //代入によるコピー禁止
+    Animator &operator = (const Animator &a);
+
+public:
+
+    //キャラクタの数
+    GLsizei size() const { return static_cast<GLsizei>(characters.size()); }
+
+    //キャラクタを追加する
+    //  clip: 再生する動き
+    //  time: 動きの開始の時刻（秒）
+    //  戻り値: キャラクタの番号（上限に達していたら -1）
+    GLint add(const AnimationClip &clip, GLfloat time = 0.0f)
+    {
+        if(characters.size() >= palettes.size()) return -1;
+        const Character c = { { &clip, NULL }, { time, 0.0f }, 0.0f };
+        characters.push_back(c);
+        return size() - 1;
+    }
+
+    //キャラクタにもう一つの動きを混ぜる（混ぜる割合を少しずつ変えれば動きを切り替えられる）
+    //  i: キャラクタの番号
+    //  clip: 混ぜる動き（NULL なら混ぜない）
+    //  time: 混ぜる動きの時刻（秒）
+    //  weight: 混ぜる割合
+    void mix(GLint i, const AnimationClip *clip, GLfloat time, GLfloat weight)
+    {
+        Character &c(characters[i]);
+        c.clip[1] = clip;
+        c.time[1] = time;
+        c.weight = weight;
+    }
+
+    //全てのキャラクタの時刻を進めてパレットを求める
+    //  dt: 進める時間（秒）
+    //  pool: 並列に処理するワーカースレッド（NULL なら呼び出したスレッドだけで処理する）
+    void update(GLfloat dt, ThreadPool *pool = NULL)
+    {
+        for(Character &c : characters)
+        {
+            c.time[0] += dt;
+            c.time[1] += dt;
+        }
+        if(pool != NULL)
+        {
+            pool -> parallelFor(characters.size(), grain, [this](std::size_t begin, std::size_t end)
+            {
+                evaluate(begin, end);
+            });
+        }
+        else evaluate(0, characters.size());
+    }
+
+    //全てのキャラクタのパレットを転送する
+    void upload() const
+    {
+        if(!characters.empty()) uniform.set(palettes.data(), 0, static_cast<unsigned int>(characters.size()));
+    }
+
+    //キャラクタのパレットをシェーダのユニフォームブロックに結合する
+    //  i: キャラクタの番号
+    void select(GLint i) const
+    {
+        uniform.select(ShaderVariants::paletteBinding, i);
+    }
+
+    //キャラクタのパレット
+    //  i: キャラクタの番号
+    const Palette &getPalette(GLint i) const { return palettes[i]; }
+};
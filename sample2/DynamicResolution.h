@@ -0,0 +1,253 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <GL/glew.h>
+
+//GPU メモリの使用量の記録
+#include "GpuMemory.h"
+
+// 解像度を動的に変える描画先
+//  場面をフレームバッファオブジェクトの一部に縮小して描画し、
+//  ウィンドウのフレームバッファに線形補間で拡大して写す
+//  描画にかかった GPU の時間をタイマクエリで計り、
+//  目標のフレームレートに収まるように縮小率を調節する
+//  （タイマクエリが使えなければ垂直同期で揃ったフレームの間隔しか分からないので縮小しない）
+class DynamicResolution
+{
+public:
+
+    //縮小率と時間の統計
+    struct Stats
+    {
+        //現在の縮小率（縦横それぞれ）
+        GLfloat scale;
+
+        //一フレームの描画に使える GPU の時間（秒）
+        double budget;
+
+        //計測した描画の時間の移動平均と最大（秒）
+        double gpuMean, gpuMax;
+
+        //計測したフレームの数と予算を超えたフレームの数
+        unsigned long frames, over;
+
+        //縮小率を変えた回数
+        unsigned long changes;
+    };
+
+private:
+
+    //計測の結果を待つタイマクエリの数（結果は数フレーム遅れて届く）
+    static constexpr int queries = 4;
+
+    //縮小率の刻み（細かく揺れないように刻みに丸める）
+    static constexpr GLfloat step = 1.0f / 32.0f;
+
+    //フレームバッファオブジェクトとカラーバッファ、デプスバッファのレンダーバッファ
+    GLuint fbo, color, depth;
+
+    //ウィンドウのフレームバッファのサイズ（フレームバッファオブジェクトもこの大きさで確保する）
+    GLsizei width, height;
+
+    //縮小率の下限と現在の縮小率
+    const GLfloat minScale;
+    GLfloat scale;
+
+    //このフレームで描画している大きさ
+    GLsizei viewport[2];
+
+    //一フレームの描画に使える GPU の時間（秒）
+    const double budget;
+
+    //タイマクエリとそれぞれで計ったときの縮小率
+    GLuint query[queries];
+    GLfloat measured[queries];
+    const bool timer;
+
+    //次に使うタイマクエリと結果を待っているタイマクエリの数
+    int next, waiting;
+
+    //描画の時間と縮小率 1 に換算した描画の時間の移動平均
+    double average, unit;
+
+    //統計
+    double gpuMax;
+    unsigned long frames, over, changes;
+
+    //フレームバッファオブジェクトの記憶領域を確保する
+    void allocate()
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        account();
+    }
+
+    //レンダーバッファの使用量を記録する（縮小して使っていない部分は詰め物とする）
+    void account() const
+    {
+        //どちらも一画素 4 バイトとする（24 ビットのデプスバッファも普通は 32 ビットに詰める）
+        const GLsizeiptr bytes(static_cast<GLsizeiptr>(width) * height * 4);
+        const GLsizeiptr used(static_cast<GLsizeiptr>(viewport[0]) * viewport[1] * 4);
+        GpuMemory &memory(GpuMemory::instance());
+        memory.allocate(GpuMemory::Renderbuffer, color, bytes, used, 0, "DynamicResolution");
+        memory.allocate(GpuMemory::Renderbuffer, depth, bytes, used, 0, "DynamicResolution");
+    }
+
+    //描画の時間を一つ記録して縮小率を調節する
+    //  t: 描画の時間（秒）
+    //  s: 計ったときの縮小率
+    void measure(double t, GLfloat s)
+    {
+        //描画の時間は画素数（縮小率の二乗）に比例するとして縮小率 1 のときの時間に直す
+        //  結果は数フレーム遅れて届くので、今の縮小率ではなく計ったときの縮小率で割る
+        const double u(t / (static_cast<double>(s) * s));
+
+        //外れ値に振り回されないように移動平均をとる
+        average = frames == 0 ? t : average * 0.9 + t * 0.1;
+        unit = frames == 0 ? u : unit * 0.9 + u * 0.1;
+        gpuMax = std::max(gpuMax, t);
+        ++frames;
+        if(t > budget) ++over;
+
+        //予算に収まる縮小率を求め、下げるときはすぐに、上げるときは余裕が二刻み以上あるときに一刻みずつ
+        const GLfloat ideal(static_cast<GLfloat>(std::sqrt(budget / unit)));
+        GLfloat target(scale);
+        if(ideal < scale)
+            target = std::floor(ideal / step) * step;
+        else if(ideal >= scale + 2.0f * step)
+            target = scale + step;
+        target = std::min(std::max(target, minScale), 1.0f);
+
+        if(target != scale)
+        {
+            scale = target;
+            ++changes;
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  fps: 目標のフレームレート
+    //  minScale: 縮小率の下限
+    //  headroom: 一フレームの時間のうち描画に使ってよい割合
+    DynamicResolution(double fps = 60.0, GLfloat minScale = 0.5f, double headroom = 0.8)
+    : width(0), height(0)
+    , minScale(minScale), scale(1.0f)
+    , budget(headroom / fps)
+    , timer(GLEW_ARB_timer_query != GL_FALSE)
+    , next(0), waiting(0)
+    , average(0.0), unit(0.0), gpuMax(0.0), frames(0), over(0), changes(0)
+    {
+        viewport[0] = viewport[1] = 0;
+
+        //フレームバッファオブジェクトにレンダーバッファを取り付ける（大きさは begin() で決める）
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &depth);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if(timer) glGenQueries(queries, query);
+    }
+
+    //デストラクタ
+    virtual ~DynamicResolution()
+    {
+        GpuMemory::instance().release(GpuMemory::Renderbuffer, color);
+        GpuMemory::instance().release(GpuMemory::Renderbuffer, depth);
+        if(timer) glDeleteQueries(queries, query);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    DynamicResolution(const DynamicResolution &d);
+    //代入によるコピー禁止
+    DynamicResolution &operator = (const DynamicResolution &d);
+
+public:
+
+    //フレームバッファオブジェクトへの描画を始める
+    //  size: ウィンドウのフレームバッファのサイズ
+    void begin(const GLsizei *size)
+    {
+        //ウィンドウのフレームバッファの大きさが変わったら確保し直す
+        if(size[0] != width || size[1] != height)
+        {
+            width = size[0];
+            height = size[1];
+            allocate();
+        }
+
+        //届いている計測の結果を受け取る（待たない）
+        if(timer)
+        {
+            while(waiting > 0)
+            {
+                const int oldest((next + queries - waiting) % queries);
+                GLint available;
+                glGetQueryObjectiv(query[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+                if(available == GL_FALSE) break;
+                GLuint64 elapsed;
+                glGetQueryObjectui64v(query[oldest], GL_QUERY_RESULT, &elapsed);
+                measure(static_cast<double>(elapsed) * 1.0e-9, measured[oldest]);
+                --waiting;
+            }
+        }
+
+        //縮小した大きさで描画する
+        const GLsizei previous[] = { viewport[0], viewport[1] };
+        viewport[0] = std::max(static_cast<GLsizei>(static_cast<GLfloat>(width) * scale), 1);
+        viewport[1] = std::max(static_cast<GLsizei>(static_cast<GLfloat>(height) * scale), 1);
+        if(viewport[0] != previous[0] || viewport[1] != previous[1]) account();
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, viewport[0], viewport[1]);
+
+        //結果を待っているタイマクエリが一杯なら今回は計らない
+        if(timer && waiting < queries)
+        {
+            measured[next] = scale;
+            glBeginQuery(GL_TIME_ELAPSED, query[next]);
+        }
+    }
+
+    //フレームバッファオブジェクトへの描画を終えてウィンドウに拡大して写す
+    void end()
+    {
+        if(timer && waiting < queries)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            next = (next + 1) % queries;
+            ++waiting;
+        }
+
+        //縮小して描画した部分をウィンドウ全体に線形補間で拡大する
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, viewport[0], viewport[1], 0, 0, width, height,
+                          GL_COLOR_BUFFER_BIT, scale < 1.0f ? GL_LINEAR : GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+
+    //現在の縮小率
+    GLfloat getScale() const { return scale; }
+
+    //このフレームで描画している大きさ（begin() の後で使う）
+    const GLsizei *getSize() const { return viewport; }
+
+    //縮小率と時間の統計を取り出す
+    Stats stats() const
+    {
+        const Stats s = { scale, budget, average, gpuMax, frames, over, changes };
+        return s;
+    }
+};
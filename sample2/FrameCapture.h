@@ -0,0 +1,614 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <memory>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <GL/glew.h>
+
+//GPU 資源の管理
+#include "GpuResources.h"
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+// フレームの取り込み
+//  描画したフレームをピクセルバッファオブジェクトのリングに glReadPixels() で読み出し、
+//  同期オブジェクトで読み出しが終わったことを確かめてから数フレーム後にマップして取り出すので、
+//  描画のスレッドは GPU の完了を待たない
+//  取り出した画素はワーカースレッドで PNG（連番のファイル）か Y4M（一つのファイル）に書き出す
+class FrameCapture
+{
+public:
+
+    //書き出す形式
+    enum Format
+    {
+        Png,    //フレームごとの PNG ファイル（パスは %05lu のような整数の変換を一つだけ含む printf の書式で連番を入れる）
+        Y4m     //全てのフレームを一つの YUV4MPEG2 ファイルに書き出す（4:2:0）
+    };
+
+    //取り込みの統計
+    struct Stats
+    {
+        //書き出しに回したフレームの数、書き出したフレームの数、取りこぼしたフレームの数
+        unsigned long captured, written, dropped;
+
+        //一フレームあたりの描画のスレッドでの時間と書き出しの時間の平均（秒）
+        double readMean, encodeMean;
+    };
+
+private:
+
+    //ピクセルバッファオブジェクトのリングの要素
+    struct Slot
+    {
+        //読み出し先
+        GpuResources::Buffer pbo;
+
+        //読み出しの完了を待つ同期オブジェクト（読み出していなければ 0）
+        GLsync fence;
+
+        //読み出した大きさ
+        GLsizei width, height;
+    };
+
+    //書き出しの形式と書き出し先
+    const Format format;
+    const std::string path;
+
+    //PNG のファイル名の通し番号の前と後ろ、通し番号の桁数と詰め物の文字、書式が正しいか
+    std::string prefix, suffix;
+    std::size_t digits;
+    char fill;
+    bool named;
+
+    //Y4M のフレームレート（分子と分母）
+    const long rateNumerator, rateDenominator;
+
+    //書き出しを分担するワーカースレッド
+    ThreadPool &pool;
+
+    //ピクセルバッファオブジェクトのリングと一番古い読み出し中の位置、読み出し中の数
+    std::vector<Slot> ring;
+    int oldest, count;
+
+    //書き出しを待つフレームの数の上限
+    const int backlog;
+
+    //リングや書き出しが一杯のときに待つか（false なら取りこぼす）
+    const bool wait;
+
+    //Y4M の出力先と最初のフレームの大きさ
+    std::ofstream stream;
+    GLsizei width, height;
+
+    //書き出しに回したフレームの通し番号
+    unsigned long sequence;
+
+    //以下はワーカースレッドと共有する
+
+    //outstanding, spare, ready, nextWrite, 統計の排他制御と書き出しが終わったことの通知
+    std::mutex mutex;
+    std::condition_variable done;
+
+    //書き出し中のフレームの数
+    int outstanding;
+
+    //使い回す画素の記憶領域
+    std::vector<std::vector<unsigned char>> spare;
+
+    //Y4M で順番を待っている変換済みのフレーム
+    std::map<unsigned long, std::vector<unsigned char>> ready;
+    unsigned long nextWrite;
+
+    //統計
+    unsigned long written, dropped;
+    double readTime, encodeTime;
+
+    //連番の書式を通し番号の前と後ろに分ける（%% は % にし、整数の変換はちょうど一つだけ許す）
+    //  書式を printf に渡さずに自分で通し番号を入れるので、%s や %n が含まれていても安全に断れる
+    bool split()
+    {
+        int conversions(0);
+        std::string *out(&prefix);
+        for(std::size_t i = 0; i < path.size(); i++)
+        {
+            if(path[i] != '%')
+            {
+                *out += path[i];
+                continue;
+            }
+            if(i + 1 < path.size() && path[i + 1] == '%')
+            {
+                *out += '%';
+                ++i;
+                continue;
+            }
+
+            // %[0][桁数][h|l|z]{d|i|u} だけを受け付ける
+            std::size_t j(i + 1);
+            fill = ' ';
+            if(j < path.size() && path[j] == '0')
+            {
+                fill = '0';
+                ++j;
+            }
+            digits = 0;
+            for(; j < path.size() && isdigit(static_cast<unsigned char>(path[j])) && digits < 100; j++)
+                digits = digits * 10 + (path[j] - '0');
+            while(j < path.size() && (path[j] == 'h' || path[j] == 'l' || path[j] == 'z')) ++j;
+            if(j >= path.size() || strchr("diu", path[j]) == NULL || ++conversions > 1) return false;
+            out = &suffix;
+            i = j;
+        }
+        return conversions == 1;
+    }
+
+    //通し番号のファイル名
+    //  n: フレームの通し番号
+    std::string name(unsigned long n) const
+    {
+        std::string number(std::to_string(n));
+        if(number.size() < digits) number.insert(0, digits - number.size(), fill);
+        return prefix + number + suffix;
+    }
+
+    //現在時刻（秒）
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //一番古い読み出し中のフレームが読み出せていれば取り出して書き出しに回す
+    //  block: 読み出しが終わるまで待つか
+    //  戻り値: 取り出したら true
+    bool retire(bool block)
+    {
+        if(count == 0) return false;
+        Slot &s(ring[oldest]);
+
+        const GLenum status(glClientWaitSync(s.fence, block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0));
+        if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+        {
+            if(!block) return false;
+            while(glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(s.fence);
+        s.fence = 0;
+        oldest = (oldest + 1) % static_cast<int>(ring.size());
+        --count;
+
+        //書き出しが溜まっていれば待つか取りこぼす
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(outstanding >= backlog)
+            {
+                if(!wait)
+                {
+                    ++dropped;
+                    return true;
+                }
+                done.wait(lock, [this]{ return outstanding < backlog; });
+            }
+            ++outstanding;
+        }
+
+        //マップして写し、すぐに返す（書き出しはワーカースレッドで行う）
+        const std::size_t bytes(static_cast<std::size_t>(s.width) * s.height * 4);
+        std::vector<unsigned char> pixels(take(bytes));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo.get());
+        const void *const p(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+        if(p != NULL)
+        {
+            memcpy(pixels.data(), p, bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if(p == NULL)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(std::move(pixels));
+            --outstanding;
+            ++dropped;
+            done.notify_all();
+            return true;
+        }
+
+        //ワーカースレッドで書き出す
+        const unsigned long n(sequence++);
+        const GLsizei w(s.width), h(s.height);
+        auto frame(std::make_shared<std::vector<unsigned char>>(std::move(pixels)));
+        pool.submit([this, n, w, h, frame]{ encode(n, w, h, *frame); });
+        return true;
+    }
+
+    //使い回す画素の記憶領域を取り出す
+    std::vector<unsigned char> take(std::size_t bytes)
+    {
+        std::vector<unsigned char> pixels;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!spare.empty())
+            {
+                pixels = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        pixels.resize(bytes);
+        return pixels;
+    }
+
+    //一つのフレームを書き出す（ワーカースレッドで実行する）
+    //  n: フレームの通し番号
+    //  w, h: フレームの大きさ
+    //  pixels: 下の行から並んだ RGBA の画素
+    void encode(unsigned long n, GLsizei w, GLsizei h, std::vector<unsigned char> &pixels)
+    {
+        const double t0(now());
+        std::vector<unsigned char> out;
+        bool ok(true);
+
+        if(format == Png)
+        {
+            //連番のファイルはそれぞれ別に書き出せる
+            png(pixels.data(), w, h, out);
+            const std::string filename(name(n));
+            std::ofstream file(filename, std::ios::binary);
+            file.write(reinterpret_cast<const char *>(out.data()), out.size());
+            ok = !file.fail();
+            if(!ok) std::cerr << "Error: Can't write frame: " << filename << std::endl;
+        }
+        else y4m(pixels.data(), w, h, out);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(format == Y4m)
+        {
+            //通し番号の順に一つのファイルに書き出す（前のフレームがまだなら待たせておく）
+            ready[n] = std::move(out);
+            for(auto i = ready.find(nextWrite); i != ready.end(); i = ready.find(nextWrite))
+            {
+                stream.write(reinterpret_cast<const char *>(i -> second.data()), i -> second.size());
+                ready.erase(i);
+                ++nextWrite;
+                ++written;
+            }
+        }
+        else if(ok) ++written;
+        encodeTime += now() - t0;
+
+        spare.push_back(std::move(pixels));
+        --outstanding;
+        done.notify_all();
+    }
+
+    //CRC-32 を求める
+    static std::uint32_t crc32(const unsigned char *data, std::size_t size, std::uint32_t crc = 0)
+    {
+        static const struct Table
+        {
+            std::uint32_t value[256];
+            Table()
+            {
+                for(std::uint32_t n = 0; n < 256; n++)
+                {
+                    std::uint32_t c(n);
+                    for(int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    value[n] = c;
+                }
+            }
+        } table;
+
+        crc = ~crc;
+        for(std::size_t i = 0; i < size; i++) crc = table.value[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    //ビッグエンディアンの 32 ビット整数を書き込む
+    static void put32(std::vector<unsigned char> &out, std::uint32_t v)
+    {
+        const unsigned char b[] =
+        {
+            static_cast<unsigned char>(v >> 24), static_cast<unsigned char>(v >> 16),
+            static_cast<unsigned char>(v >> 8), static_cast<unsigned char>(v)
+        };
+        out.insert(out.end(), b, b + 4);
+    }
+
+    //PNG のチャンクを書き込む
+    static void chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, std::size_t size)
+    {
+        put32(out, static_cast<std::uint32_t>(size));
+        const std::size_t start(out.size());
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        put32(out, crc32(out.data() + start, size + 4));
+    }
+
+    //RGBA の画素を上下を反転して RGB の PNG にする
+    //  圧縮のライブラリを使わないので zlib のストアブロック（無圧縮）で格納する
+    static void png(const unsigned char *rgba, GLsizei w, GLsizei h, std::vector<unsigned char> &out)
+    {
+        //フィルタなしの行を上から並べる
+        const std::size_t row(static_cast<std::size_t>(w) * 3 + 1);
+        std::vector<unsigned char> raw(row * h);
+        for(GLsizei y = 0; y < h; y++)
+        {
+            const unsigned char *src(rgba + static_cast<std::size_t>(h - 1 - y) * w * 4);
+            unsigned char *dst(raw.data() + row * y);
+            *dst++ = 0;
+            for(GLsizei x = 0; x < w; x++, src += 4, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+
+        //zlib の形式で 65535 バイトずつのストアブロックに分ける
+        std::vector<unsigned char> z;
+        z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        z.push_back(0x78);
+        z.push_back(0x01);
+        std::uint32_t a(1), b(0);
+        for(std::size_t i = 0; i < raw.size(); )
+        {
+            const std::size_t n(std::min<std::size_t>(raw.size() - i, 65535));
+            z.push_back(i + n == raw.size() ? 1 : 0);
+            z.push_back(static_cast<unsigned char>(n));
+            z.push_back(static_cast<unsigned char>(n >> 8));
+            z.push_back(static_cast<unsigned char>(~n));
+            z.push_back(static_cast<unsigned char>(~n >> 8));
+            z.insert(z.end(), raw.begin() + i, raw.begin() + i + n);
+
+            //Adler-32（5552 バイトごとに剰余を取れば溢れない）
+            for(std::size_t j = i; j < i + n; )
+            {
+                const std::size_t end(std::min(i + n, j + 5552));
+                for(; j < end; j++)
+                {
+                    a += raw[j];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+            }
+            i += n;
+        }
+        put32(z, (b << 16) | a);
+
+        static constexpr unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        out.assign(signature, signature + sizeof signature);
+        std::vector<unsigned char> header;
+        put32(header, static_cast<std::uint32_t>(w));
+        put32(header, static_cast<std::uint32_t>(h));
+        static constexpr unsigned char format[] = { 8, 2, 0, 0, 0 };
+        header.insert(header.end(), format, format + sizeof format);
+        chunk(out, "IHDR", header.data(), header.size());
+        chunk(out, "IDAT", z.data(), z.size());
+        chunk(out, "IEND", NULL, 0);
+    }
+
+    //RGBA の画素を上下を反転して Y4M の一フレーム（BT.601、4:2:0）にする
+    static void y4m(const unsigned char *rgba, GLsizei w, GLsizei h, std::vector<unsigned char> &out)
+    {
+        static constexpr char tag[] = "FRAME\n";
+        const GLsizei cw((w + 1) / 2), ch((h + 1) / 2);
+        const std::size_t luma(static_cast<std::size_t>(w) * h), chroma(static_cast<std::size_t>(cw) * ch);
+        out.resize(sizeof tag - 1 + luma + chroma * 2);
+        memcpy(out.data(), tag, sizeof tag - 1);
+        unsigned char *const Y(out.data() + sizeof tag - 1), *const U(Y + luma), *const V(U + chroma);
+
+        //GL の画素は下の行からなので上下を入れ替えて読む
+        const auto pixel([rgba, w, h](GLsizei x, GLsizei y)
+        {
+            return rgba + (static_cast<std::size_t>(h - 1 - y) * w + x) * 4;
+        });
+
+        for(GLsizei y = 0; y < h; y++)
+        {
+            for(GLsizei x = 0; x < w; x++)
+            {
+                const unsigned char *const p(pixel(x, y));
+                Y[static_cast<std::size_t>(y) * w + x] =
+                    static_cast<unsigned char>(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+            }
+        }
+
+        //色差は 2 × 2 画素の平均から求める
+        for(GLsizei y = 0; y < ch; y++)
+        {
+            for(GLsizei x = 0; x < cw; x++)
+            {
+                int r(0), g(0), b(0), n(0);
+                for(GLsizei dy = 0; dy < 2 && y * 2 + dy < h; dy++)
+                {
+                    for(GLsizei dx = 0; dx < 2 && x * 2 + dx < w; dx++)
+                    {
+                        const unsigned char *const p(pixel(x * 2 + dx, y * 2 + dy));
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        ++n;
+                    }
+                }
+                r /= n;
+                g /= n;
+                b /= n;
+                U[static_cast<std::size_t>(y) * cw + x] =
+                    static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                V[static_cast<std::size_t>(y) * cw + x] =
+                    static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  path: 書き出し先（Png なら "frame%05lu.png" のように通し番号を入れる整数の変換を一つだけ含む printf の書式）
+    //  format: 書き出す形式
+    //  pool: 書き出しを分担するワーカースレッド
+    //  fps: Y4M に記録するフレームレート
+    //  depth: ピクセルバッファオブジェクトの数（読み出してから取り出すまでのフレーム数）
+    //  backlog: 書き出しを待つフレームの数の上限
+    //  wait: リングや書き出しが一杯のときに待つか（false なら取りこぼして描画を遅らせない）
+    FrameCapture(const char *path, Format format, ThreadPool &pool, double fps = 60.0,
+                 int depth = 3, int backlog = 8, bool wait = false)
+    : format(format)
+    , path(path)
+    , digits(0)
+    , fill(' ')
+    , named(false)
+    , rateNumerator(std::lround(fps * 1000.0)), rateDenominator(1000)
+    , pool(pool)
+    , ring(std::max(depth, 1))
+    , oldest(0), count(0)
+    , backlog(std::max(backlog, 1))
+    , wait(wait)
+    , width(0), height(0)
+    , sequence(0)
+    , outstanding(0)
+    , nextWrite(0)
+    , written(0), dropped(0)
+    , readTime(0.0), encodeTime(0.0)
+    {
+        for(Slot &s : ring)
+        {
+            s.fence = 0;
+            s.width = s.height = 0;
+        }
+
+        if(format == Y4m)
+        {
+            stream.open(path, std::ios::binary);
+            if(stream.fail()) std::cerr << "Error: Can't open capture file: " << path << std::endl;
+        }
+        else if(!(named = split()))
+        {
+            std::cerr << "Error: Capture file must contain exactly one integer conversion such as %05lu: "
+                      << path << std::endl;
+        }
+    }
+
+    //デストラクタ（読み出し中と書き出し中のフレームを全て書き出す）
+    virtual ~FrameCapture()
+    {
+        finish();
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    FrameCapture(const FrameCapture &c);
+    //代入によるコピー禁止
+    FrameCapture &operator = (const FrameCapture &c);
+
+public:
+
+    //書き出せるか
+    explicit operator bool() const
+    {
+        return format == Png ? named : stream.is_open();
+    }
+
+    //描画したフレームを読み出す（swapBuffers() の前に呼ぶ）
+    //  size: 読み出す大きさ（フレームバッファのサイズ）
+    //  framebuffer: 読み出すフレームバッファオブジェクト（0 ならウィンドウのフレームバッファ）
+    void capture(const GLsizei *size, GLuint framebuffer = 0)
+    {
+        const double t0(now());
+
+        //読み出しが終わっているフレームを取り出す
+        poll();
+
+        //Y4M は最初のフレームと同じ大きさのものだけ記録する
+        if(width == 0)
+        {
+            width = size[0];
+            height = size[1];
+            if(format == Y4m && stream.is_open())
+            {
+                stream << "YUV4MPEG2 W" << width << " H" << height << " F" << rateNumerator << ":"
+                       << rateDenominator << " Ip A1:1 C420jpeg\n";
+            }
+        }
+        if(!*this || (format == Y4m && (size[0] != width || size[1] != height)))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++dropped;
+            return;
+        }
+
+        //リングが一杯なら一番古いものの完了を待つか取りこぼす
+        if(count == static_cast<int>(ring.size()))
+        {
+            if(!wait)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++dropped;
+                readTime += now() - t0;
+                return;
+            }
+            retire(true);
+        }
+
+        //大きさが変わっていたら確保し直す（前のものは描画が終わってから使い回される）
+        Slot &s(ring[(oldest + count) % ring.size()]);
+        const GLsizeiptr bytes(static_cast<GLsizeiptr>(size[0]) * size[1] * 4);
+        if(!s.pbo || s.pbo.size() < bytes)
+            s.pbo = GpuResources::instance().acquireBuffer(bytes, GL_STREAM_READ, NULL, "FrameCapture");
+        s.width = size[0];
+        s.height = size[1];
+
+        //ピクセルバッファオブジェクトに読み出す（glReadPixels() はここでは待たない）
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo.get());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, s.width, s.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++count;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readTime += now() - t0;
+    }
+
+    //読み出しが終わっているフレームを待たずに取り出して書き出しに回す
+    void poll()
+    {
+        while(retire(false));
+    }
+
+    //読み出し中のフレームを全て取り出し、書き出しが終わるまで待つ
+    void finish()
+    {
+        while(retire(true));
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]{ return outstanding == 0; });
+        if(stream.is_open()) stream.flush();
+    }
+
+    //取り込みの統計を取り出す
+    Stats stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const unsigned long frames(sequence + dropped);
+        const Stats s =
+        {
+            sequence, written, dropped,
+            frames > 0 ? readTime / static_cast<double>(frames) : 0.0,
+            written > 0 ? encodeTime / static_cast<double>(written) : 0.0
+        };
+        return s;
+    }
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// フレームの間隔と描画中のフレームの数の制御
+//  フレームの終わり（swapBuffers() の後）に endFrame() を呼ぶと、
+//  描画中のフレームが上限を超えないように古いフレームの完了を同期オブジェクトで待ち、
+//  Fixed のときは次のフレームの開始予定の時刻まで待つ
+//  待つのは入力を取り出す前なので、次のフレームはできるだけ新しい入力で描画できる
+class FramePacer
+{
+public:
+
+    //フレームの間隔の決め方
+    enum Mode
+    {
+        Uncapped,   //垂直同期を待たない
+        VSync,      //垂直同期を待つ
+        Adaptive,   //垂直同期に間に合わなかったときだけ待たない（使えなければ VSync）
+        Fixed       //垂直同期を待たずに一定の間隔で描画する
+    };
+
+    //フレームの間隔と遅延の統計（秒）
+    struct Stats
+    {
+        //計測したフレームの数
+        unsigned long frames;
+
+        //フレームの間隔の平均と最大
+        double frameMean, frameMax;
+
+        //描画中のフレームの完了を待った時間の平均
+        double stallMean;
+
+        //入力を受け取ってからそれを使ったフレームの描画が完了するまでの時間の平均と最大
+        double latencyMean, latencyMax;
+    };
+
+private:
+
+    //描画中のフレームの数の上限の最大値
+    static constexpr int maxFrames = 4;
+
+    //描画中のフレーム
+    struct Pending
+    {
+        //フレームのコマンドの完了を待つ同期オブジェクト
+        GLsync fence;
+
+        //フレームが使った最も古い入力の時刻（なければ負）
+        double input;
+    };
+
+    //描画中のフレームのリングバッファ
+    Pending pending[maxFrames];
+
+    //一番古い描画中のフレームの位置と描画中のフレームの数
+    int oldest, count;
+
+    //描画中のフレームの数の上限
+    const int frames;
+
+    //入力を提出の直前に読み直すか
+    const bool late;
+
+    //フレームの間隔の決め方
+    Mode mode;
+
+    //Fixed のときのフレームの間隔（秒）
+    double period;
+
+    //Fixed のときの次のフレームの開始予定の時刻
+    double deadline;
+
+    //このフレームが使った最も古い入力の時刻（なければ負）
+    double input;
+
+    //前のフレームの終わりの時刻
+    double last;
+
+    //統計
+    unsigned long frameCount, latencyCount;
+    double frameSum, frameMax, stallSum, latencySum, latencyMax;
+
+    //一番古い描画中のフレームが完了したことを記録して取り除く
+    //  t: 完了を確かめた時刻
+    void retire(double t)
+    {
+        Pending &p(pending[oldest]);
+        glDeleteSync(p.fence);
+        if(p.input >= 0.0)
+        {
+            const double latency(t - p.input);
+            latencySum += latency;
+            latencyMax = std::max(latencyMax, latency);
+            ++latencyCount;
+        }
+        oldest = (oldest + 1) % maxFrames;
+        --count;
+    }
+
+public:
+
+    //コンストラクタ（ウィンドウのコンテキストを処理対象にしてから作る）
+    //  mode: フレームの間隔の決め方
+    //  fps: Fixed のときの一秒あたりのフレーム数
+    //  frames: 描画中のフレームの数の上限（1 から 4）
+    //  late: 入力を提出の直前に読み直すか
+    FramePacer(Mode mode = VSync, double fps = 60.0, int frames = 2, bool late = true)
+    : oldest(0), count(0)
+    , frames(std::min(std::max(frames, 1), static_cast<int>(maxFrames)))
+    , late(late)
+    , input(-1.0)
+    , last(glfwGetTime())
+    , frameCount(0), latencyCount(0)
+    , frameSum(0.0), frameMax(0.0), stallSum(0.0), latencySum(0.0), latencyMax(0.0)
+    {
+        setMode(mode, fps);
+    }
+
+    //デストラクタ
+    virtual ~FramePacer()
+    {
+        while(count > 0)
+        {
+            glDeleteSync(pending[oldest].fence);
+            oldest = (oldest + 1) % maxFrames;
+            --count;
+        }
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    FramePacer(const FramePacer &p);
+    //代入によるコピー禁止
+    FramePacer &operator = (const FramePacer &p);
+
+public:
+
+    //フレームの間隔の決め方を変える（現在のコンテキストの垂直同期の設定を変える）
+    //  mode: フレームの間隔の決め方
+    //  fps: Fixed のときの一秒あたりのフレーム数
+    void setMode(Mode mode, double fps = 60.0)
+    {
+        this -> mode = mode;
+        period = 1.0 / std::max(fps, 1.0);
+        deadline = glfwGetTime() + period;
+
+        switch(mode)
+        {
+            case VSync:
+                glfwSwapInterval(1);
+                break;
+
+            case Adaptive:
+                //垂直同期に遅れたフレームはすぐに表示する拡張機能があれば使う
+                glfwSwapInterval(glfwExtensionSupported("WGL_EXT_swap_control_tear")
+                              || glfwExtensionSupported("GLX_EXT_swap_control_tear") ? -1 : 1);
+                break;
+
+            default:
+                glfwSwapInterval(0);
+                break;
+        }
+    }
+
+    //フレームの間隔の決め方
+    Mode getMode() const { return mode; }
+
+    //入力を提出の直前に読み直すか
+    bool lateLatch() const { return late; }
+
+    //このフレームで入力を使ったことを記録する
+    //  time: 入力イベントを受け取った時刻（glfwGetTime() の値）
+    void latch(double time)
+    {
+        if(input < 0.0 || time < input) input = time;
+    }
+
+    //フレームを終える（swapBuffers() の後に呼ぶ）
+    //  このフレームに同期オブジェクトを付け、次のフレームを始めてよくなるまで待つ
+    void endFrame()
+    {
+        const Pending p = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), input };
+        pending[(oldest + count) % maxFrames] = p;
+        ++count;
+        input = -1.0;
+
+        //もう完了しているフレームを取り除く
+        while(count > 0)
+        {
+            const GLenum status(glClientWaitSync(pending[oldest].fence, 0, 0));
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            retire(glfwGetTime());
+        }
+
+        //描画中のフレームが上限を超えていたら一番古いものの完了を待つ
+        const double stall(glfwGetTime());
+        while(count >= frames)
+        {
+            while(glClientWaitSync(pending[oldest].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            retire(glfwGetTime());
+        }
+        double now(glfwGetTime());
+        stallSum += now - stall;
+
+        //Fixed のときは次のフレームの開始予定の時刻まで待つ
+        if(mode == Fixed)
+        {
+            if(now < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(deadline - now));
+                now = glfwGetTime();
+            }
+
+            //大きく遅れたら追いつくのを諦めて今を基準にする
+            deadline = now - deadline > period ? now + period : deadline + period;
+        }
+
+        //フレームの間隔を記録する
+        const double interval(now - last);
+        frameSum += interval;
+        frameMax = std::max(frameMax, interval);
+        ++frameCount;
+        last = now;
+    }
+
+    //フレームの間隔と遅延の統計を取り出す
+    Stats stats() const
+    {
+        const Stats s =
+        {
+            frameCount,
+            frameCount > 0 ? frameSum / static_cast<double>(frameCount) : 0.0,
+            frameMax,
+            frameCount > 0 ? stallSum / static_cast<double>(frameCount) : 0.0,
+            latencyCount > 0 ? latencySum / static_cast<double>(latencyCount) : 0.0,
+            latencyMax
+        };
+        return s;
+    }
+};
@@ -0,0 +1,422 @@
+#pragma once
+#include <set>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <GL/glew.h>
+
+//図形データ
+#include "Object.h"
+
+//材質
+#include "Material.h"
+
+//光源の位置
+#include "Vector.h"
+
+//シェーダの機能の組み合わせ
+#include "ShaderVariants.h"
+
+// フレームごとの描画の記録
+//  時刻や入力に依存して決まった値（変換行列、光源、材質の番号、パーティクルの進め方）と
+//  どの図形を描いたかをバイナリのログに書き出し、replay で同じ描画を何度でも再現できるようにする
+//  ログは先頭の "FRM1" の後に一バイトの命令とその引数を並べたもので、
+//  図形や材質の定義を最初に置き、その後に BeginFrame から EndFrame までをフレームの数だけ置く
+//  フレームの記録はメモリに溜めて EndFrame で一度に書き出す
+class FrameRecorder
+{
+public:
+
+    //命令
+    enum Op : unsigned char
+    {
+        DefineShape = 1,    //図形の定義（番号、種類、頂点の位置の次元、頂点属性、インデックス）
+        DefineMaterial,     //材質の定義（番号、材質）
+        DefineProgram,      //使うシェーダの機能の組み合わせ
+        DefineParticles,    //パーティクルの定義（最大数、寿命）
+        BeginFrame,         //フレームの開始
+        StepParticles,      //パーティクルを進めて転送する（時間、放出する数、放出の位置、速さ、広がり、重力）
+        Pass,               //描画先を消去して材質のバッファを結合する（描画先の大きさ）
+        View,               //ビューポートと共通の uniform 変数（ビューポート、投影変換行列、光源）
+        Draw,               //図形の描画（図形の番号、シェーダ、材質の番号、モデルビュー変換行列、法線ベクトルの変換行列）
+        DrawParticles,      //パーティクルの描画（投影変換行列、モデルビュー変換行列、大きさ、色）
+        EndFrame            //フレームの終了
+    };
+
+    //図形の種類
+    enum Kind : unsigned char
+    {
+        Lines,              //Shape
+        LineIndex,          //ShapeIndex
+        Solid,              //SolidShape
+        SolidIndex          //SolidShapeIndex
+    };
+
+    //ログを読み出す
+    class Reader
+    {
+        //ログの内容
+        const std::vector<unsigned char> &data;
+
+        //次に読み出す位置
+        size_t position;
+
+        //壊れたログを読んだか
+        bool failed;
+
+    public:
+
+        //コンストラクタ（先頭の識別子を確かめる）
+        //  data: ログの内容
+        explicit Reader(const std::vector<unsigned char> &data)
+        : data(data)
+        , position(4)
+        , failed(data.size() < 4 || memcmp(data.data(), "FRM1", 4) != 0)
+        {
+        }
+
+        //次の命令を読み出す（終わりか壊れていれば false）
+        bool next(Op &op)
+        {
+            if(failed || position >= data.size()) return false;
+            op = static_cast<Op>(data[position++]);
+            return true;
+        }
+
+        //値を読み出す（足りなければ 0 にして壊れたことにする）
+        template<typename T>
+        void get(T *v, size_t count = 1)
+        {
+            const size_t bytes(sizeof (T) * count);
+            if(failed || data.size() - position < bytes)
+            {
+                failed = true;
+                memset(static_cast<void *>(v), 0, bytes);
+                return;
+            }
+            memcpy(static_cast<void *>(v), data.data() + position, bytes);
+            position += bytes;
+        }
+
+        //値が正しいか確かめる（正しくなければ壊れたことにする）
+        //  ok: 値が正しければ true
+        bool check(bool ok)
+        {
+            if(!ok) failed = true;
+            return !failed;
+        }
+
+        //この後に T 型の値が count 個残っているか確かめる（領域を確保する前に使う）
+        //  count: 読み出す値の数（負なら壊れている）
+        template<typename T>
+        bool fits(GLsizei count)
+        {
+            return check(count >= 0
+                && static_cast<size_t>(count) <= (data.size() - position) / sizeof (T));
+        }
+
+        //T 型の値を count 個読み飛ばす（残りの長さに収まらなければ壊れたことにする）
+        //  count: 読み飛ばす値の数
+        template<typename T>
+        bool skip(GLsizei count)
+        {
+            if(!fits<T>(count)) return false;
+            position += sizeof (T) * static_cast<size_t>(count);
+            return true;
+        }
+
+        //値を一つ読み出す
+        template<typename T>
+        T get()
+        {
+            T v;
+            get(&v);
+            return v;
+        }
+
+        //シェーダの機能の組み合わせを読み出す
+        ShaderFeature getFeature()
+        {
+            const int lights(get<GLint>());
+            const unsigned char flags(get<unsigned char>());
+            const ShaderFeature f =
+            {
+                lights, (flags & 4u) != 0, (flags & 2u) != 0, (flags & 1u) != 0, (flags & 8u) != 0
+            };
+            return f;
+        }
+
+        //材質を読み出す
+        Material getMaterial()
+        {
+            Material m = {};
+            get(m.ambient.data(), 3);
+            get(m.diffuse.data(), 3);
+            get(m.specular.data(), 3);
+            get(&m.shininess);
+            return m;
+        }
+
+        //壊れたログを読んだか
+        bool fail() const { return failed; }
+    };
+
+private:
+
+    //書き出し先
+    std::ofstream stream;
+
+    //書き出していない記録（定義とこのフレームの命令）
+    std::vector<char> buffer;
+
+    //記録したフレームの数と書き出した大きさ
+    unsigned long frames, bytes;
+
+    //記録したシェーダの機能の組み合わせ
+    std::set<GLuint> programs;
+
+    //値を記録する
+    template<typename T>
+    void put(const T *v, size_t count = 1)
+    {
+        const char *const p(reinterpret_cast<const char *>(v));
+        buffer.insert(buffer.end(), p, p + sizeof (T) * count);
+    }
+
+    //命令を記録する
+    void put(Op op)
+    {
+        buffer.push_back(static_cast<char>(op));
+    }
+
+    //記録を書き出す
+    void flush()
+    {
+        if(buffer.empty()) return;
+        stream.write(buffer.data(), buffer.size());
+        bytes += static_cast<unsigned long>(buffer.size());
+        buffer.clear();
+    }
+
+public:
+
+    //コンストラクタ
+    //  path: 書き出すファイル（NULL なら何も記録しない）
+    explicit FrameRecorder(const char *path = NULL)
+    : frames(0)
+    , bytes(0)
+    {
+        if(path == NULL) return;
+        stream.open(path, std::ios::binary);
+        if(stream.fail())
+        {
+            std::cerr << "Error: Can't open record file: " << path << std::endl;
+            return;
+        }
+        buffer.assign("FRM1", "FRM1" + 4);
+    }
+
+    //デストラクタ（記録の途中のフレームは捨てずに書き出す）
+    virtual ~FrameRecorder()
+    {
+        if(stream.is_open()) flush();
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    FrameRecorder(const FrameRecorder &r);
+    //代入によるコピー禁止
+    FrameRecorder &operator = (const FrameRecorder &r);
+
+public:
+
+    //記録しているか
+    explicit operator bool() const { return stream.is_open(); }
+
+    //図形を定義する
+    //  id: 図形の番号（Draw で指定する）
+    //  kind: 図形の種類
+    //  size: 頂点の位置の次元
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    void defineShape(GLuint id, Kind kind, GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+                     GLsizei indexcount = 0, const GLuint *index = NULL)
+    {
+        if(!*this) return;
+        put(DefineShape);
+        put(&id);
+        put(&kind);
+        put(&size);
+        put(&vertexcount);
+        put(vertex, vertexcount);
+        put(&indexcount);
+        put(index, indexcount);
+    }
+
+    //材質を定義する
+    //  index: 材質の番号（Draw で指定する）
+    //  m: 材質
+    void defineMaterial(GLuint index, const Material &m)
+    {
+        if(!*this) return;
+        put(DefineMaterial);
+        put(&index);
+        put(m.ambient.data(), 3);
+        put(m.diffuse.data(), 3);
+        put(m.specular.data(), 3);
+        put(&m.shininess);
+    }
+
+    //使うシェーダの機能の組み合わせを定義する（再現するときに最初のフレームの前にリンクしておく）
+    //  f: シェーダの機能の組み合わせ
+    void defineProgram(const ShaderFeature &f)
+    {
+        if(!*this || !programs.insert(f.key()).second) return;
+        put(DefineProgram);
+        putFeature(f);
+    }
+
+    //パーティクルを定義する
+    //  capacity: パーティクルの最大数
+    //  lifetime: パーティクルの寿命の最大値（秒）
+    void defineParticles(GLsizei capacity, GLfloat lifetime)
+    {
+        if(!*this) return;
+        put(DefineParticles);
+        put(&capacity);
+        put(&lifetime);
+    }
+
+    //フレームの記録を始める
+    void beginFrame()
+    {
+        if(!*this) return;
+        put(BeginFrame);
+    }
+
+    //パーティクルを進めたことを記録する
+    //  dt: 進めた時間
+    //  count: 放出した数
+    //  origin: 放出した位置
+    //  speed, spread: 放出した速さと広がり
+    //  gravity: 重力加速度
+    void stepParticles(GLfloat dt, GLsizei count, const GLfloat *origin, GLfloat speed, GLfloat spread,
+                       const GLfloat *gravity)
+    {
+        if(!*this) return;
+        put(StepParticles);
+        put(&dt);
+        put(&count);
+        put(origin, 3);
+        put(&speed);
+        put(&spread);
+        put(gravity, 3);
+    }
+
+    //描画先を消去して材質のバッファを結合したことを記録する
+    //  target: 描画先の大きさ（画素）
+    void pass(const GLsizei *target)
+    {
+        if(!*this) return;
+        put(Pass);
+        put(target, 2);
+    }
+
+    //ビューポートと共通の uniform 変数を記録する
+    //  pixels: ビューポート（画素で x, y, 幅, 高さ）
+    //  projection: 投影変換行列
+    //  lights: 光源の数
+    //  Lview: 視点座標系での光源の位置
+    //  Lamb, Ldiff, Lspec: 光源の環境光、拡散反射光、鏡面反射光の強さ
+    void view(const GLint *pixels, const GLfloat *projection, GLint lights, const Vector *Lview,
+              const GLfloat *Lamb, const GLfloat *Ldiff, const GLfloat *Lspec)
+    {
+        if(!*this) return;
+        put(View);
+        put(pixels, 4);
+        put(projection, 16);
+        put(&lights);
+        for(int i = 0; i < lights; i++) put(Lview[i].data(), 4);
+        put(Lamb, lights * 3);
+        put(Ldiff, lights * 3);
+        put(Lspec, lights * 3);
+    }
+
+    //図形の描画を記録する
+    //  shape: 図形の番号
+    //  f: 使ったシェーダの機能の組み合わせ
+    //  material: 材質の番号
+    //  modelview: モデルビュー変換行列
+    //  normalMatrix: 法線ベクトルの変換行列
+    void draw(GLuint shape, const ShaderFeature &f, GLuint material, const GLfloat *modelview,
+              const GLfloat *normalMatrix)
+    {
+        if(!*this) return;
+        put(Draw);
+        put(&shape);
+        putFeature(f);
+        put(&material);
+        put(modelview, 16);
+        put(normalMatrix, 9);
+    }
+
+    //パーティクルの描画を記録する
+    //  projection: 投影変換行列
+    //  modelview: モデルビュー変換行列
+    //  size: 点の大きさ
+    //  color: 色
+    void drawParticles(const GLfloat *projection, const GLfloat *modelview, GLfloat size, const GLfloat *color)
+    {
+        if(!*this) return;
+        put(DrawParticles);
+        put(projection, 16);
+        put(modelview, 16);
+        put(&size);
+        put(color, 3);
+    }
+
+    //フレームの記録を終えて書き出す
+    void endFrame()
+    {
+        if(!*this) return;
+        put(EndFrame);
+        flush();
+        ++frames;
+    }
+
+    //記録したフレームの数
+    unsigned long getFrames() const { return frames; }
+
+    //書き出した大きさ（バイト）
+    unsigned long getBytes() const { return bytes; }
+
+    //ログをファイルから読み込む
+    //  name: ファイル名
+    //  data: 読み込んだ内容の格納先
+    static bool load(const char *name, std::vector<unsigned char> &data)
+    {
+        std::ifstream file(name, std::ios::binary);
+        if(file.fail())
+        {
+            std::cerr << "Error: Can't open record file: " << name << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+private:
+
+    //シェーダの機能の組み合わせを記録する
+    void putFeature(const ShaderFeature &f)
+    {
+        const GLint lights(f.lights);
+        const unsigned char flags(static_cast<unsigned char>(f.key() & 15u));
+        put(&lights);
+        put(&flags);
+    }
+};
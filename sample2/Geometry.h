@@ -0,0 +1,119 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <GL/glew.h>
+
+//図形データ
+#include "Object.h"
+
+// 面ごとに法線を変えた六面体の頂点属性
+constexpr Object::Vertex solidCubeVertex[] =
+{
+    // 左
+    { -1.0f, -1.0f, -1.0f,  -1.0f, 0.0f, 0.0f }, 
+    { -1.0f, -1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
+    { -1.0f,  1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
+    { -1.0f, -1.0f, -1.0f,  -1.0f, 0.0f, 0.0f },
+    { -1.0f,  1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
+    { -1.0f,  1.0f, -1.0f,  -1.0f, 0.0f, 0.0f },
+    // 裏
+    {  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    { -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    { -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    {  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    { -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    {  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
+    // 下
+    { -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
+    {  1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
+    {  1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
+    { -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
+    {  1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
+    { -1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
+    // 右
+    { 1.0f, -1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
+    { 1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+    { 1.0f,  1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+    { 1.0f, -1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
+    { 1.0f,  1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+    { 1.0f,  1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
+    // 上
+    { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
+    { -1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
+    {  1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
+    { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
+    {  1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
+    {  1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
+    // 前
+    { -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+    {  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+    {  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+    { -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+    {  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
+    { -1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f }
+};
+
+// 六面体の面を塗りつぶす三角形の頂点のインデックス
+constexpr GLuint solidCubeIndex[] =
+{
+    0, 1, 2, 3, 4, 5, // 左
+    6, 7, 8, 9, 10, 11,//裏
+    12, 13, 14, 15, 16, 17, // 下
+    18, 19, 20, 21, 22, 23, // 右
+    24, 25, 26, 27, 28, 29, // 上
+    30, 31, 32, 33, 34, 35 //前
+};
+
+// 球の頂点属性とインデックスを作る
+//  slices: 経度方向の分割数
+//  stacks: 緯度方向の分割数
+//  solidSphereVertex: 頂点属性の格納先
+//  solidSphereIndex: インデックスの格納先
+inline void makeSolidSphere(int slices, int stacks,
+                            std::vector<Object::Vertex> &solidSphereVertex,
+                            std::vector<GLuint> &solidSphereIndex)
+{
+    //頂点属性を作る
+    for(int j = 0; j <= stacks ; j++)
+    {
+        const float t(static_cast<float>(j) / static_cast<float>(stacks));
+        const float y(cos(3.141693f * t)), r(sin(3.141693f * t));
+        
+        for(int i = 0; i <= slices; i++)
+        {
+            const float s(static_cast<float>(i) / static_cast<float>(slices));
+            const float z(r * cos(6.283185f * s)), x(r * sin(6.283185f * s));
+            
+            //頂点属性
+            const Object::Vertex v = { x, y, z, x, y, z};
+            
+            //頂点属性を追加する
+            solidSphereVertex.emplace_back(v);
+        }
+    }
+    
+    //インデックスを作る
+    for(int j = 0; j < stacks; j++)
+    {
+        const int k((slices + 1) * j);
+        
+        for(int i = 0; i < slices; i++)
+        {
+            //頂点のインデックス (左上、右上、左下、右下)
+            const GLuint k0(k + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k1 + slices);
+            const GLuint k3(k2 + 1);
+            
+            //左下の三角形
+            solidSphereIndex.emplace_back(k0);
+            solidSphereIndex.emplace_back(k2);
+            solidSphereIndex.emplace_back(k3);
+            
+            //右上の三角形
+            solidSphereIndex.emplace_back(k0);
+            solidSphereIndex.emplace_back(k3);
+            solidSphereIndex.emplace_back(k1);
+        }
+    }
+}
@@ -0,0 +1,1017 @@
+#pragma once
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <GL/glew.h>
+
+//GL の呼び出しを記録するか（Debug 構成か GL_TRACE=1 を定義したときだけ記録する層を組み込む）
+#if !defined(GL_TRACE)
+#  if defined(DEBUG)
+#    define GL_TRACE 1
+#  else
+#    define GL_TRACE 0
+#  endif
+#endif
+
+#if GL_TRACE
+// GL の呼び出しの記録
+//  このヘッダより後の gl〜 の呼び出しを GlTrace の同名の関数に置き換え、
+//  setEnabled(true) にしてから種類ごとの回数、状態を変えない（直前と同じ値を設定する）呼び出しの回数、
+//  ドライバの中で費やした CPU の時間をフレームごとに集計する
+//  置き換えは翻訳単位ごとなので、記録する .cpp で他のヘッダより先にこのヘッダを読み込む
+//  GL を呼び出すのは一つのスレッドだけとする
+class GlTrace
+{
+public:
+
+    //記録する呼び出しの種類
+    enum Call
+    {
+        //状態の設定（直前と同じ値なら無駄な呼び出しとして数える）
+        UseProgram,
+        BindVertexArray,
+        BindBuffer,
+        BindBufferRange,
+        ActiveTexture,
+        BindTexture,
+        BindFramebuffer,
+        BindRenderbuffer,
+        Viewport,
+        Enable,
+        Disable,
+        CullFace,
+        FrontFace,
+        DepthFunc,
+        ClearColor,
+        ClearDepth,
+        PixelStorei,
+        Uniform1i,
+        Uniform1f,
+        Uniform3fv,
+        Uniform4fv,
+        UniformMatrix3fv,
+        UniformMatrix4fv,
+
+        //頂点配列オブジェクトの設定
+        VertexAttribPointer,
+        EnableVertexAttribArray,
+        DisableVertexAttribArray,
+        VertexAttribDivisor,
+
+        //描画
+        Clear,
+        DrawArrays,
+        DrawArraysInstanced,
+        DrawElementsBaseVertex,
+        BlitFramebuffer,
+
+        //データの転送
+        BufferData,
+        BufferSubData,
+        MapBufferRange,
+        UnmapBuffer,
+        TexBuffer,
+        ReadPixels,
+
+        //同期と問い合わせ
+        FenceSync,
+        ClientWaitSync,
+        DeleteSync,
+        Flush,
+        Finish,
+        BeginQuery,
+        EndQuery,
+        GetQueryObjectiv,
+        GetQueryObjectui64v,
+        GetIntegerv,
+        GetUniformLocation,
+
+        //オブジェクトの作成と削除
+        GenBuffers,
+        GenVertexArrays,
+        LinkProgram,
+        DeleteBuffers,
+        DeleteVertexArrays,
+        DeleteTextures,
+        DeleteFramebuffers,
+        DeleteRenderbuffers,
+        DeleteProgram,
+
+        calls
+    };
+
+    //一つの種類の呼び出しの集計
+    struct Counter
+    {
+        //呼び出しの回数とそのうち状態を変えなかった回数
+        unsigned long count, redundant;
+
+        //ドライバの中で費やした時間（秒）
+        double time;
+    };
+
+    //GL の呼び出しを置き換えて組み込んでいるか
+    static constexpr bool available = GL_TRACE != 0;
+
+private:
+
+    //状態の記録のキー（呼び出しの種類と対象）
+    typedef std::tuple<Call, GLuint, GLuint> Key;
+
+    //状態の記録（記録にない状態は分からないものとして無駄とはしない）
+    typedef std::map<Key, std::vector<GLubyte>> State;
+
+    //コンテキストごとの状態
+    std::map<const void *, State> contexts;
+
+    //処理対象のコンテキストの状態
+    State *state;
+
+    //プログラムオブジェクトとロケーションごとの uniform 変数の値（コンテキストの間で共有する）
+    std::map<std::pair<GLuint, GLint>, std::vector<GLubyte>> uniforms;
+
+    //記録するか
+    bool enabled;
+
+    //このフレームの集計、直前のフレームの集計、全体の集計
+    Counter frame[calls], last[calls], total[calls];
+
+    //集計したフレームの数
+    unsigned long frames;
+
+    //フレームごとの集計の書き出し先（NULL なら書き出さない）
+    std::ostream *log;
+
+    //記録した値と同じなら true を返し、違えば記録して false を返す
+    static bool same(std::vector<GLubyte> &stored, const void *value, size_t size)
+    {
+        const GLubyte *const p(static_cast<const GLubyte *>(value));
+        if(stored.size() == size && std::equal(p, p + size, stored.begin())) return true;
+        stored.assign(p, p + size);
+        return false;
+    }
+
+    //状態を設定する呼び出しが直前と同じ値を設定するか調べて値を記録する
+    bool same(Call call, GLuint a, GLuint b, const void *value, size_t size)
+    {
+        return same((*state)[Key(call, a, b)], value, size);
+    }
+
+    //状態の記録を取り出す（記録になければ NULL）
+    const GLuint *find(Call call, GLuint a = 0, GLuint b = 0) const
+    {
+        const auto found(state -> find(Key(call, a, b)));
+        if(found == state -> end() || found -> second.size() < sizeof (GLuint)) return NULL;
+        return reinterpret_cast<const GLuint *>(found -> second.data());
+    }
+
+    //状態を比べずに記録する
+    void store(Call call, GLuint a, GLuint b, GLuint value)
+    {
+        same(call, a, b, &value, sizeof value);
+    }
+
+    //全てのコンテキストから一つの種類の状態の記録を取り除く（削除したオブジェクトが結合されていたかもしれないとき）
+    void forget(Call call)
+    {
+        for(auto &c : contexts)
+        {
+            State &s(c.second);
+            s.erase(s.lower_bound(Key(call, 0, 0)), s.upper_bound(Key(call, ~0u, ~0u)));
+        }
+    }
+
+    //プログラムオブジェクトの uniform 変数の値の記録を取り除く
+    void forgetUniforms(GLuint program)
+    {
+        uniforms.erase(uniforms.lower_bound(std::make_pair(program, -1)),
+                       uniforms.upper_bound(std::make_pair(program, 0x7fffffff)));
+    }
+
+    //uniform 変数の設定が使用中のプログラムオブジェクトの値を変えないか調べて値を記録する
+    bool sameUniform(GLint location, const void *value, size_t size)
+    {
+        //存在しない uniform 変数への設定は何もしない
+        if(location < 0) return true;
+        const GLuint *const program(find(UseProgram));
+        if(program == NULL) return false;
+        return same(uniforms[std::make_pair(*program, location)], value, size);
+    }
+
+    //結合されている頂点配列オブジェクト（分からなければ ~0）
+    GLuint vertexArray() const
+    {
+        const GLuint *const array(find(BindVertexArray));
+        return array != NULL ? *array : ~0u;
+    }
+
+    //呼び出しを数えて記録を始める（記録しないときは NULL を返す）
+    Counter *begin(Call call, bool redundant)
+    {
+        if(!enabled) return NULL;
+        Counter &c(frame[call]);
+        ++c.count;
+        if(redundant) ++c.redundant;
+        return &c;
+    }
+
+    //呼び出しの記録の範囲（ドライバの中の時間を計る）
+    class Scope
+    {
+        Counter *const counter;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+
+        //  call: 呼び出しの種類
+        //  redundant: 状態を変えない呼び出しか
+        Scope(Call call, bool redundant = false)
+        : counter(instance().begin(call, redundant))
+        {
+            if(counter != NULL) start = std::chrono::steady_clock::now();
+        }
+
+        ~Scope()
+        {
+            if(counter != NULL)
+                counter -> time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+public:
+
+    //コンストラクタ
+    GlTrace()
+    : state(&contexts[NULL])
+    , enabled(false)
+    , frame()
+    , last()
+    , total()
+    , frames(0)
+    , log(NULL)
+    {
+    }
+
+    //デストラクタ
+    virtual ~GlTrace()
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    GlTrace(const GlTrace &t);
+    //代入によるコピー禁止
+    GlTrace &operator = (const GlTrace &t);
+
+public:
+
+    //プログラム全体で使う記録
+    static GlTrace &instance()
+    {
+        static GlTrace trace;
+        return trace;
+    }
+
+    //記録を始める・止める（始めるときは状態の記録を捨てて分からないものとする）
+    //  on: 記録するなら true（GL_TRACE が 0 なら何もしない）
+    void setEnabled(bool on)
+    {
+        enabled = on && available;
+        for(auto &c : contexts) c.second.clear();
+        uniforms.clear();
+    }
+
+    //記録しているか
+    bool isEnabled() const { return enabled; }
+
+    //処理対象のコンテキストを切り替えたことを知らせる（Window から呼ぶ）
+    //  context: コンテキストを区別する値（GLFW のウィンドウのハンドル）
+    void setContext(const void *context)
+    {
+        state = &contexts[context];
+    }
+
+    //破棄するコンテキストの状態の記録を捨てる
+    //  context: 破棄するコンテキスト
+    void releaseContext(const void *context)
+    {
+        if(context == NULL) return;
+        if(state == &contexts[context]) state = &contexts[NULL];
+        contexts.erase(context);
+    }
+
+    //フレームごとの集計を CSV で書き出す
+    //  out: 書き出し先（NULL なら書き出さない）
+    void setLog(std::ostream *out)
+    {
+        log = out;
+        if(log == NULL) return;
+        *log << "frame,calls,redundant,driverMs";
+        for(int i = 0; i < calls; i++) *log << ',' << name(static_cast<Call>(i));
+        *log << std::endl;
+    }
+
+    //フレームの終わりに呼び出す（このフレームの集計を全体に足して書き出す）
+    void endFrame()
+    {
+        if(!enabled) return;
+        Counter sum = {};
+        for(int i = 0; i < calls; i++)
+        {
+            total[i].count += frame[i].count;
+            total[i].redundant += frame[i].redundant;
+            total[i].time += frame[i].time;
+            sum.count += frame[i].count;
+            sum.redundant += frame[i].redundant;
+            sum.time += frame[i].time;
+        }
+        if(log != NULL)
+        {
+            *log << frames << ',' << sum.count << ',' << sum.redundant << ',' << sum.time * 1000.0;
+            for(int i = 0; i < calls; i++) *log << ',' << frame[i].count;
+            *log << '\n';
+        }
+        std::copy(frame, frame + calls, last);
+        std::fill(frame, frame + calls, Counter());
+        ++frames;
+    }
+
+    //直前のフレームの集計
+    const Counter *getFrame() const { return last; }
+
+    //全体の集計
+    const Counter *getTotal() const { return total; }
+
+    //集計したフレームの数
+    unsigned long getFrames() const { return frames; }
+
+    //呼び出しの種類の名前
+    static const char *name(Call call)
+    {
+        static const char *const names[calls] =
+        {
+            "glUseProgram", "glBindVertexArray", "glBindBuffer", "glBindBufferRange", "glActiveTexture",
+            "glBindTexture", "glBindFramebuffer", "glBindRenderbuffer", "glViewport", "glEnable", "glDisable",
+            "glCullFace", "glFrontFace", "glDepthFunc", "glClearColor", "glClearDepth", "glPixelStorei",
+            "glUniform1i", "glUniform1f", "glUniform3fv", "glUniform4fv", "glUniformMatrix3fv", "glUniformMatrix4fv",
+            "glVertexAttribPointer", "glEnableVertexAttribArray", "glDisableVertexAttribArray",
+            "glVertexAttribDivisor", "glClear", "glDrawArrays", "glDrawArraysInstanced",
+            "glDrawElementsBaseVertex", "glBlitFramebuffer", "glBufferData", "glBufferSubData",
+            "glMapBufferRange", "glUnmapBuffer", "glTexBuffer", "glReadPixels", "glFenceSync",
+            "glClientWaitSync", "glDeleteSync", "glFlush", "glFinish", "glBeginQuery", "glEndQuery",
+            "glGetQueryObjectiv", "glGetQueryObjectui64v", "glGetIntegerv", "glGetUniformLocation",
+            "glGenBuffers", "glGenVertexArrays", "glLinkProgram", "glDeleteBuffers", "glDeleteVertexArrays",
+            "glDeleteTextures", "glDeleteFramebuffers", "glDeleteRenderbuffers", "glDeleteProgram"
+        };
+        return names[call];
+    }
+
+    //呼び出しの種類ごとのフレームあたりの平均を回数の多い順に表にして書き出す
+    //  out: 書き出し先
+    void dump(std::ostream &out) const
+    {
+        if(frames == 0) return;
+        const std::ios::fmtflags flags(out.flags());
+        const std::streamsize precision(out.precision());
+        std::vector<int> order;
+        for(int i = 0; i < calls; i++) if(total[i].count > 0) order.push_back(i);
+        std::sort(order.begin(), order.end(), [this](int a, int b){ return total[a].count > total[b].count; });
+
+        const auto row([&out, this](const char *name, const Counter &c)
+        {
+            out << "  " << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+                << std::setw(10) << static_cast<double>(c.count) / frames
+                << std::setw(12) << static_cast<double>(c.redundant) / frames
+                << std::setw(10) << (c.count > 0 ? 100.0 * c.redundant / c.count : 0.0)
+                << std::setprecision(3) << std::setw(12) << c.time * 1000.0 / frames << std::endl;
+        });
+
+        out << "GL calls per frame (" << frames << " frames):" << std::endl;
+        out << "  " << std::left << std::setw(28) << "call" << std::right << std::setw(10) << "calls"
+            << std::setw(12) << "redundant" << std::setw(10) << "%" << std::setw(12) << "driver ms" << std::endl;
+        Counter sum = {};
+        for(int i : order)
+        {
+            row(name(static_cast<Call>(i)), total[i]);
+            sum.count += total[i].count;
+            sum.redundant += total[i].redundant;
+            sum.time += total[i].time;
+        }
+        row("total", sum);
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    //置き換えた GL の関数（状態を記録して元の関数を呼び出す、元の関数はこの後で置き換える）
+
+    static void useProgram(GLuint program)
+    {
+        GlTrace &t(instance());
+        const Scope scope(UseProgram, t.enabled && t.same(UseProgram, 0, 0, &program, sizeof program));
+        glUseProgram(program);
+    }
+
+    static void bindVertexArray(GLuint array)
+    {
+        GlTrace &t(instance());
+        const Scope scope(BindVertexArray, t.enabled && t.same(BindVertexArray, 0, 0, &array, sizeof array));
+        glBindVertexArray(array);
+    }
+
+    static void bindBuffer(GLenum target, GLuint buffer)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            //インデックスの結合は頂点配列オブジェクトごとの状態
+            if(target != GL_ELEMENT_ARRAY_BUFFER) redundant = t.same(BindBuffer, target, 0, &buffer, sizeof buffer);
+            else if(t.vertexArray() != ~0u) redundant = t.same(BindBuffer, target, t.vertexArray(), &buffer, sizeof buffer);
+        }
+        const Scope scope(BindBuffer, redundant);
+        glBindBuffer(target, buffer);
+    }
+
+    static void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            const GLintptr range[] = { static_cast<GLintptr>(buffer), offset, static_cast<GLintptr>(size) };
+            redundant = t.same(BindBufferRange, target, index, range, sizeof range);
+
+            //汎用の結合ポイントにも結合される
+            t.store(BindBuffer, target, 0, buffer);
+        }
+        const Scope scope(BindBufferRange, redundant);
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    static void activeTexture(GLenum texture)
+    {
+        GlTrace &t(instance());
+        const Scope scope(ActiveTexture, t.enabled && t.same(ActiveTexture, 0, 0, &texture, sizeof texture));
+        glActiveTexture(texture);
+    }
+
+    static void bindTexture(GLenum target, GLuint texture)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            //テクスチャの結合はテクスチャユニットごとの状態
+            const GLuint *const unit(t.find(ActiveTexture));
+            if(unit != NULL) redundant = t.same(BindTexture, target, *unit, &texture, sizeof texture);
+        }
+        const Scope scope(BindTexture, redundant);
+        glBindTexture(target, texture);
+    }
+
+    static void bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            //GL_FRAMEBUFFER は描画と読み出しの両方に結合する
+            if(target == GL_FRAMEBUFFER)
+            {
+                const bool draw(t.same(BindFramebuffer, GL_DRAW_FRAMEBUFFER, 0, &framebuffer, sizeof framebuffer));
+                const bool read(t.same(BindFramebuffer, GL_READ_FRAMEBUFFER, 0, &framebuffer, sizeof framebuffer));
+                redundant = draw && read;
+            }
+            else redundant = t.same(BindFramebuffer, target, 0, &framebuffer, sizeof framebuffer);
+        }
+        const Scope scope(BindFramebuffer, redundant);
+        glBindFramebuffer(target, framebuffer);
+    }
+
+    static void bindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        GlTrace &t(instance());
+        const Scope scope(BindRenderbuffer,
+                          t.enabled && t.same(BindRenderbuffer, target, 0, &renderbuffer, sizeof renderbuffer));
+        glBindRenderbuffer(target, renderbuffer);
+    }
+
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        GlTrace &t(instance());
+        const GLint value[] = { x, y, width, height };
+        const Scope scope(Viewport, t.enabled && t.same(Viewport, 0, 0, value, sizeof value));
+        glViewport(x, y, width, height);
+    }
+
+    static void enable(GLenum cap)
+    {
+        GlTrace &t(instance());
+        const GLboolean on(GL_TRUE);
+        const Scope scope(Enable, t.enabled && t.same(Enable, cap, 0, &on, sizeof on));
+        glEnable(cap);
+    }
+
+    static void disable(GLenum cap)
+    {
+        GlTrace &t(instance());
+        const GLboolean on(GL_FALSE);
+        const Scope scope(Disable, t.enabled && t.same(Enable, cap, 0, &on, sizeof on));
+        glDisable(cap);
+    }
+
+    static void cullFace(GLenum mode)
+    {
+        GlTrace &t(instance());
+        const Scope scope(CullFace, t.enabled && t.same(CullFace, 0, 0, &mode, sizeof mode));
+        glCullFace(mode);
+    }
+
+    static void frontFace(GLenum mode)
+    {
+        GlTrace &t(instance());
+        const Scope scope(FrontFace, t.enabled && t.same(FrontFace, 0, 0, &mode, sizeof mode));
+        glFrontFace(mode);
+    }
+
+    static void depthFunc(GLenum func)
+    {
+        GlTrace &t(instance());
+        const Scope scope(DepthFunc, t.enabled && t.same(DepthFunc, 0, 0, &func, sizeof func));
+        glDepthFunc(func);
+    }
+
+    static void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+    {
+        GlTrace &t(instance());
+        const GLfloat value[] = { red, green, blue, alpha };
+        const Scope scope(ClearColor, t.enabled && t.same(ClearColor, 0, 0, value, sizeof value));
+        glClearColor(red, green, blue, alpha);
+    }
+
+    static void clearDepth(GLdouble depth)
+    {
+        GlTrace &t(instance());
+        const Scope scope(ClearDepth, t.enabled && t.same(ClearDepth, 0, 0, &depth, sizeof depth));
+        glClearDepth(depth);
+    }
+
+    static void pixelStorei(GLenum pname, GLint param)
+    {
+        GlTrace &t(instance());
+        const Scope scope(PixelStorei, t.enabled && t.same(PixelStorei, pname, 0, &param, sizeof param));
+        glPixelStorei(pname, param);
+    }
+
+    static void uniform1i(GLint location, GLint v0)
+    {
+        GlTrace &t(instance());
+        const Scope scope(Uniform1i, t.enabled && t.sameUniform(location, &v0, sizeof v0));
+        glUniform1i(location, v0);
+    }
+
+    static void uniform1f(GLint location, GLfloat v0)
+    {
+        GlTrace &t(instance());
+        const Scope scope(Uniform1f, t.enabled && t.sameUniform(location, &v0, sizeof v0));
+        glUniform1f(location, v0);
+    }
+
+    static void uniform3fv(GLint location, GLsizei count, const GLfloat *value)
+    {
+        GlTrace &t(instance());
+        const Scope scope(Uniform3fv, t.enabled && t.sameUniform(location, value, count * 3 * sizeof (GLfloat)));
+        glUniform3fv(location, count, value);
+    }
+
+    static void uniform4fv(GLint location, GLsizei count, const GLfloat *value)
+    {
+        GlTrace &t(instance());
+        const Scope scope(Uniform4fv, t.enabled && t.sameUniform(location, value, count * 4 * sizeof (GLfloat)));
+        glUniform4fv(location, count, value);
+    }
+
+    static void uniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            //転置した値と区別するために転置の指定を先頭に付けて比べる
+            std::vector<GLubyte> v(1, transpose);
+            v.insert(v.end(), reinterpret_cast<const GLubyte *>(value),
+                     reinterpret_cast<const GLubyte *>(value + count * 9));
+            redundant = t.sameUniform(location, v.data(), v.size());
+        }
+        const Scope scope(UniformMatrix3fv, redundant);
+        glUniformMatrix3fv(location, count, transpose, value);
+    }
+
+    static void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+    {
+        GlTrace &t(instance());
+        bool redundant(false);
+        if(t.enabled)
+        {
+            std::vector<GLubyte> v(1, transpose);
+            v.insert(v.end(), reinterpret_cast<const GLubyte *>(value),
+                     reinterpret_cast<const GLubyte *>(value + count * 16));
+            redundant = t.sameUniform(location, v.data(), v.size());
+        }
+        const Scope scope(UniformMatrix4fv, redundant);
+        glUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static void vertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                    GLsizei stride, const void *pointer)
+    {
+        const Scope scope(VertexAttribPointer);
+        glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    }
+
+    static void enableVertexAttribArray(GLuint index)
+    {
+        const Scope scope(EnableVertexAttribArray);
+        glEnableVertexAttribArray(index);
+    }
+
+    static void disableVertexAttribArray(GLuint index)
+    {
+        const Scope scope(DisableVertexAttribArray);
+        glDisableVertexAttribArray(index);
+    }
+
+    static void vertexAttribDivisor(GLuint index, GLuint divisor)
+    {
+        const Scope scope(VertexAttribDivisor);
+        glVertexAttribDivisor(index, divisor);
+    }
+
+    static void clear(GLbitfield mask)
+    {
+        const Scope scope(Clear);
+        glClear(mask);
+    }
+
+    static void drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        const Scope scope(DrawArrays);
+        glDrawArrays(mode, first, count);
+    }
+
+    static void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        const Scope scope(DrawArraysInstanced);
+        glDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    static void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex)
+    {
+        const Scope scope(DrawElementsBaseVertex);
+        glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+    }
+
+    static void blitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+                                GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+    {
+        const Scope scope(BlitFramebuffer);
+        glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    static void bufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+    {
+        const Scope scope(BufferData);
+        glBufferData(target, size, data, usage);
+    }
+
+    static void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+    {
+        const Scope scope(BufferSubData);
+        glBufferSubData(target, offset, size, data);
+    }
+
+    static void *mapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        const Scope scope(MapBufferRange);
+        return glMapBufferRange(target, offset, length, access);
+    }
+
+    static GLboolean unmapBuffer(GLenum target)
+    {
+        const Scope scope(UnmapBuffer);
+        return glUnmapBuffer(target);
+    }
+
+    static void texBuffer(GLenum target, GLenum internalformat, GLuint buffer)
+    {
+        const Scope scope(TexBuffer);
+        glTexBuffer(target, internalformat, buffer);
+    }
+
+    static void readPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+    {
+        const Scope scope(ReadPixels);
+        glReadPixels(x, y, width, height, format, type, pixels);
+    }
+
+    static GLsync fenceSync(GLenum condition, GLbitfield flags)
+    {
+        const Scope scope(FenceSync);
+        return glFenceSync(condition, flags);
+    }
+
+    static GLenum clientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+    {
+        const Scope scope(ClientWaitSync);
+        return glClientWaitSync(sync, flags, timeout);
+    }
+
+    static void deleteSync(GLsync sync)
+    {
+        const Scope scope(DeleteSync);
+        glDeleteSync(sync);
+    }
+
+    static void flush()
+    {
+        const Scope scope(Flush);
+        glFlush();
+    }
+
+    static void finish()
+    {
+        const Scope scope(Finish);
+        glFinish();
+    }
+
+    static void beginQuery(GLenum target, GLuint id)
+    {
+        const Scope scope(BeginQuery);
+        glBeginQuery(target, id);
+    }
+
+    static void endQuery(GLenum target)
+    {
+        const Scope scope(EndQuery);
+        glEndQuery(target);
+    }
+
+    static void getQueryObjectiv(GLuint id, GLenum pname, GLint *params)
+    {
+        const Scope scope(GetQueryObjectiv);
+        glGetQueryObjectiv(id, pname, params);
+    }
+
+    static void getQueryObjectui64v(GLuint id, GLenum pname, GLuint64 *params)
+    {
+        const Scope scope(GetQueryObjectui64v);
+        glGetQueryObjectui64v(id, pname, params);
+    }
+
+    static void getIntegerv(GLenum pname, GLint *data)
+    {
+        const Scope scope(GetIntegerv);
+        glGetIntegerv(pname, data);
+    }
+
+    static GLint getUniformLocation(GLuint program, const GLchar *name)
+    {
+        const Scope scope(GetUniformLocation);
+        return glGetUniformLocation(program, name);
+    }
+
+    static void genBuffers(GLsizei n, GLuint *buffers)
+    {
+        const Scope scope(GenBuffers);
+        glGenBuffers(n, buffers);
+    }
+
+    static void genVertexArrays(GLsizei n, GLuint *arrays)
+    {
+        const Scope scope(GenVertexArrays);
+        glGenVertexArrays(n, arrays);
+    }
+
+    static void linkProgram(GLuint program)
+    {
+        //リンクすると uniform 変数は初期値に戻る
+        GlTrace &t(instance());
+        if(t.enabled) t.forgetUniforms(program);
+        const Scope scope(LinkProgram);
+        glLinkProgram(program);
+    }
+
+    //削除したオブジェクトが結合されていた結合ポイントは 0 に戻り、名前は使い回されるので状態の記録を捨てる
+
+    static void deleteBuffers(GLsizei n, const GLuint *buffers)
+    {
+        GlTrace &t(instance());
+        if(t.enabled)
+        {
+            t.forget(BindBuffer);
+            t.forget(BindBufferRange);
+        }
+        const Scope scope(DeleteBuffers);
+        glDeleteBuffers(n, buffers);
+    }
+
+    static void deleteVertexArrays(GLsizei n, const GLuint *arrays)
+    {
+        GlTrace &t(instance());
+        if(t.enabled)
+        {
+            t.forget(BindVertexArray);
+            t.forget(BindBuffer);
+        }
+        const Scope scope(DeleteVertexArrays);
+        glDeleteVertexArrays(n, arrays);
+    }
+
+    static void deleteTextures(GLsizei n, const GLuint *textures)
+    {
+        GlTrace &t(instance());
+        if(t.enabled) t.forget(BindTexture);
+        const Scope scope(DeleteTextures);
+        glDeleteTextures(n, textures);
+    }
+
+    static void deleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+    {
+        GlTrace &t(instance());
+        if(t.enabled) t.forget(BindFramebuffer);
+        const Scope scope(DeleteFramebuffers);
+        glDeleteFramebuffers(n, framebuffers);
+    }
+
+    static void deleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+    {
+        GlTrace &t(instance());
+        if(t.enabled) t.forget(BindRenderbuffer);
+        const Scope scope(DeleteRenderbuffers);
+        glDeleteRenderbuffers(n, renderbuffers);
+    }
+
+    static void deleteProgram(GLuint program)
+    {
+        GlTrace &t(instance());
+        if(t.enabled)
+        {
+            t.forget(UseProgram);
+            t.forgetUniforms(program);
+        }
+        const Scope scope(DeleteProgram);
+        glDeleteProgram(program);
+    }
+};
+#else
+// GL の呼び出しを記録しないときの空の GlTrace
+//  GL の呼び出しは置き換えず、メンバ関数は何もしないのでインライン展開されて何も残らない
+class GlTrace
+{
+public:
+
+    //GL の呼び出しを置き換えて組み込んでいるか
+    static constexpr bool available = false;
+
+    //プログラム全体で使う記録
+    static GlTrace &instance()
+    {
+        static GlTrace trace;
+        return trace;
+    }
+
+    void setEnabled(bool) {}
+    bool isEnabled() const { return false; }
+    void setContext(const void *) {}
+    void releaseContext(const void *) {}
+    void setLog(std::ostream *) {}
+    void endFrame() {}
+    unsigned long getFrames() const { return 0; }
+    void dump(std::ostream &) const {}
+};
+#endif
+
+#if GL_TRACE
+//このヘッダより後の GL の呼び出しを GlTrace の関数に置き換える（GLEW のマクロも置き換える）
+#undef glUseProgram
+#define glUseProgram GlTrace::useProgram
+#undef glBindVertexArray
+#define glBindVertexArray GlTrace::bindVertexArray
+#undef glBindBuffer
+#define glBindBuffer GlTrace::bindBuffer
+#undef glBindBufferRange
+#define glBindBufferRange GlTrace::bindBufferRange
+#undef glActiveTexture
+#define glActiveTexture GlTrace::activeTexture
+#undef glBindTexture
+#define glBindTexture GlTrace::bindTexture
+#undef glBindFramebuffer
+#define glBindFramebuffer GlTrace::bindFramebuffer
+#undef glBindRenderbuffer
+#define glBindRenderbuffer GlTrace::bindRenderbuffer
+#undef glViewport
+#define glViewport GlTrace::viewport
+#undef glEnable
+#define glEnable GlTrace::enable
+#undef glDisable
+#define glDisable GlTrace::disable
+#undef glCullFace
+#define glCullFace GlTrace::cullFace
+#undef glFrontFace
+#define glFrontFace GlTrace::frontFace
+#undef glDepthFunc
+#define glDepthFunc GlTrace::depthFunc
+#undef glClearColor
+#define glClearColor GlTrace::clearColor
+#undef glClearDepth
+#define glClearDepth GlTrace::clearDepth
+#undef glPixelStorei
+#define glPixelStorei GlTrace::pixelStorei
+#undef glUniform1i
+#define glUniform1i GlTrace::uniform1i
+#undef glUniform1f
+#define glUniform1f GlTrace::uniform1f
+#undef glUniform3fv
+#define glUniform3fv GlTrace::uniform3fv
+#undef glUniform4fv
+#define glUniform4fv GlTrace::uniform4fv
+#undef glUniformMatrix3fv
+#define glUniformMatrix3fv GlTrace::uniformMatrix3fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv GlTrace::uniformMatrix4fv
+#undef glVertexAttribPointer
+#define glVertexAttribPointer GlTrace::vertexAttribPointer
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray GlTrace::enableVertexAttribArray
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray GlTrace::disableVertexAttribArray
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor GlTrace::vertexAttribDivisor
+#undef glClear
+#define glClear GlTrace::clear
+#undef glDrawArrays
+#define glDrawArrays GlTrace::drawArrays
+#undef glDrawArraysInstanced
+#define glDrawArraysInstanced GlTrace::drawArraysInstanced
+#undef glDrawElementsBaseVertex
+#define glDrawElementsBaseVertex GlTrace::drawElementsBaseVertex
+#undef glBlitFramebuffer
+#define glBlitFramebuffer GlTrace::blitFramebuffer
+#undef glBufferData
+#define glBufferData GlTrace::bufferData
+#undef glBufferSubData
+#define glBufferSubData GlTrace::bufferSubData
+#undef glMapBufferRange
+#define glMapBufferRange GlTrace::mapBufferRange
+#undef glUnmapBuffer
+#define glUnmapBuffer GlTrace::unmapBuffer
+#undef glTexBuffer
+#define glTexBuffer GlTrace::texBuffer
+#undef glReadPixels
+#define glReadPixels GlTrace::readPixels
+#undef glFenceSync
+#define glFenceSync GlTrace::fenceSync
+#undef glClientWaitSync
+#define glClientWaitSync GlTrace::clientWaitSync
+#undef glDeleteSync
+#define glDeleteSync GlTrace::deleteSync
+#undef glFlush
+#define glFlush GlTrace::flush
+#undef glFinish
+#define glFinish GlTrace::finish
+#undef glBeginQuery
+#define glBeginQuery GlTrace::beginQuery
+#undef glEndQuery
+#define glEndQuery GlTrace::endQuery
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv GlTrace::getQueryObjectiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v GlTrace::getQueryObjectui64v
+#undef glGetIntegerv
+#define glGetIntegerv GlTrace::getIntegerv
+#undef glGetUniformLocation
+#define glGetUniformLocation GlTrace::getUniformLocation
+#undef glGenBuffers
+#define glGenBuffers GlTrace::genBuffers
+#undef glGenVertexArrays
+#define glGenVertexArrays GlTrace::genVertexArrays
+#undef glLinkProgram
+#define glLinkProgram GlTrace::linkProgram
+#undef glDeleteBuffers
+#define glDeleteBuffers GlTrace::deleteBuffers
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays GlTrace::deleteVertexArrays
+#undef glDeleteTextures
+#define glDeleteTextures GlTrace::deleteTextures
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers GlTrace::deleteFramebuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers GlTrace::deleteRenderbuffers
+#undef glDeleteProgram
+#define glDeleteProgram GlTrace::deleteProgram
+#endif
@@ -0,0 +1,237 @@
+#pragma once
+#include <map>
+#include <string>
+#include <tuple>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <GL/glew.h>
+
+// GPU メモリの使用量の記録
+//  バッファオブジェクト、頂点配列オブジェクト、プログラムオブジェクト、レンダーバッファを作ったところで
+//  確保した大きさ、実際にデータを置く大きさ、使い方、持ち主を記録し、
+//  持ち主ごとと全体の使用量、詰め物（確保した大きさのうちデータを置かない部分）、最大の使用量を集計する
+//  大きさはドライバが実際に確保する量ではなく GL に要求した量（頂点配列オブジェクトは数だけ数える）
+class GpuMemory
+{
+public:
+
+    //記録する資源の種類
+    enum Type
+    {
+        Buffer,
+        VertexArray,
+        Program,
+        Renderbuffer,
+        types
+    };
+
+    //使用量（バイト）
+    struct Usage
+    {
+        //資源の数
+        unsigned long count;
+
+        //確保した大きさとデータを置く大きさ（差が詰め物）
+        GLsizeiptr bytes, payload;
+
+        //確保した大きさの最大
+        GLsizeiptr peak;
+    };
+
+    //全体の使用量
+    struct Totals
+    {
+        //全ての資源の使用量
+        Usage all;
+
+        //種類ごとの資源の数
+        unsigned long count[types];
+
+        //記録した確保と解放の回数
+        unsigned long allocations, releases;
+    };
+
+private:
+
+    //一つの資源の記録
+    struct Record
+    {
+        std::string owner;
+        GLsizeiptr bytes, payload;
+        GLenum usage;
+    };
+
+    //資源の種類、名前、作ったコンテキスト（頂点配列オブジェクトのみ、ほかは NULL）ごとの記録
+    typedef std::tuple<Type, GLuint, const void *> Key;
+    std::map<Key, Record> records;
+
+    //持ち主ごとの使用量
+    std::map<std::string, Usage> owners;
+
+    //全体の使用量
+    Totals totals;
+
+    //フレームの番号
+    unsigned long frame;
+
+    //フレームごとの使用量の書き出し先（NULL なら書き出さない）
+    std::ostream *log;
+
+    //記録を集計に足し引きする
+    void count(Type type, const Record &r, int sign)
+    {
+        Usage &o(owners[r.owner]);
+        o.count += sign;
+        o.bytes += sign * r.bytes;
+        o.payload += sign * r.payload;
+        o.peak = std::max(o.peak, o.bytes);
+
+        totals.count[type] += sign;
+        totals.all.count += sign;
+        totals.all.bytes += sign * r.bytes;
+        totals.all.payload += sign * r.payload;
+        totals.all.peak = std::max(totals.all.peak, totals.all.bytes);
+    }
+
+public:
+
+    //コンストラクタ
+    GpuMemory()
+    : totals()
+    , frame(0)
+    , log(NULL)
+    {
+    }
+
+    //デストラクタ
+    virtual ~GpuMemory()
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    GpuMemory(const GpuMemory &m);
+    //代入によるコピー禁止
+    GpuMemory &operator = (const GpuMemory &m);
+
+public:
+
+    //プログラム全体で使う記録
+    static GpuMemory &instance()
+    {
+        static GpuMemory memory;
+        return memory;
+    }
+
+    //資源を確保したこと（記録済みなら持ち主や大きさが変わったこと）を記録する
+    //  type: 資源の種類
+    //  name: オブジェクト名
+    //  bytes: 確保した大きさ
+    //  payload: そのうちデータを置く大きさ
+    //  usage: 使い方（GL_STATIC_DRAW など、なければ 0）
+    //  owner: 持ち主（NULL なら "unknown"）
+    //  context: 作ったコンテキスト（コンテキストの間で共有しない資源のみ）
+    void allocate(Type type, GLuint name, GLsizeiptr bytes, GLsizeiptr payload, GLenum usage,
+                  const char *owner, const void *context = NULL)
+    {
+        if(name == 0) return;
+        const Key key(type, name, context);
+        const auto found(records.find(key));
+        if(found != records.end()) count(type, found -> second, -1);
+        else ++totals.allocations;
+
+        Record &r(records[key]);
+        r.owner = owner != NULL ? owner : "unknown";
+        r.bytes = bytes;
+        r.payload = std::min(payload, bytes);
+        r.usage = usage;
+        count(type, r, 1);
+    }
+
+    //資源を削除したことを記録する
+    //  type: 資源の種類
+    //  name: オブジェクト名
+    //  context: 作ったコンテキスト（コンテキストの間で共有しない資源のみ）
+    void release(Type type, GLuint name, const void *context = NULL)
+    {
+        const auto found(records.find(Key(type, name, context)));
+        if(found == records.end()) return;
+        count(type, found -> second, -1);
+        records.erase(found);
+        ++totals.releases;
+    }
+
+    //破棄するコンテキストで作った資源の記録を全て削除する
+    //  context: 破棄するコンテキスト
+    void releaseContext(const void *context)
+    {
+        for(auto i = records.begin(); i != records.end(); )
+        {
+            if(std::get<2>(i -> first) != context || context == NULL)
+            {
+                ++i;
+                continue;
+            }
+            count(std::get<0>(i -> first), i -> second, -1);
+            i = records.erase(i);
+            ++totals.releases;
+        }
+    }
+
+    //全体の使用量
+    const Totals &getTotals() const { return totals; }
+
+    //持ち主ごとの使用量
+    const std::map<std::string, Usage> &getOwners() const { return owners; }
+
+    //フレームごとに全体の使用量を CSV で書き出す
+    //  out: 書き出し先（NULL なら書き出さない）
+    void setLog(std::ostream *out)
+    {
+        log = out;
+        if(log != NULL)
+            *log << "frame,bytes,payload,padding,peak,buffers,vertexArrays,programs,renderbuffers" << std::endl;
+    }
+
+    //フレームの終わりに呼び出す（書き出し先があればこのフレームの使用量を書き出す）
+    void endFrame()
+    {
+        if(log != NULL)
+        {
+            *log << frame << ',' << totals.all.bytes << ',' << totals.all.payload << ','
+                 << totals.all.bytes - totals.all.payload << ',' << totals.all.peak << ','
+                 << totals.count[Buffer] << ',' << totals.count[VertexArray] << ','
+                 << totals.count[Program] << ',' << totals.count[Renderbuffer] << '\n';
+        }
+        ++frame;
+    }
+
+    //持ち主ごとと全体の使用量を表にして書き出す
+    //  out: 書き出し先
+    void dump(std::ostream &out) const
+    {
+        const auto row([&out](const std::string &name, const Usage &u)
+        {
+            out << "  " << std::left << std::setw(28) << name << std::right
+                << std::setw(6) << u.count << std::setw(14) << u.bytes << std::setw(14) << u.payload
+                << std::setw(12) << u.bytes - u.payload << std::setw(14) << u.peak << std::endl;
+        });
+
+        out << "GPU memory (bytes):" << std::endl;
+        out << "  " << std::left << std::setw(28) << "owner" << std::right
+            << std::setw(6) << "count" << std::setw(14) << "allocated" << std::setw(14) << "payload"
+            << std::setw(12) << "padding" << std::setw(14) << "peak" << std::endl;
+        for(const auto &o : owners) if(o.second.count > 0 || o.second.peak > 0) row(o.first, o.second);
+        row("total", totals.all);
+    }
+
+    //プログラムオブジェクトの大きさの目安（プログラムバイナリの大きさ、取り出せなければ 0）
+    //  program: リンクの終わったプログラムオブジェクト
+    static GLsizeiptr programSize(GLuint program)
+    {
+        GLint length(0);
+        if(program != 0 && GLEW_ARB_get_program_binary) glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        return length;
+    }
+};
@@ -0,0 +1,461 @@
+#pragma once
+#include <map>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <GL/glew.h>
+
+//GPU メモリの使用量の記録
+#include "GpuMemory.h"
+
+// GPU 資源（バッファオブジェクトと頂点配列オブジェクト）の管理
+//  バッファオブジェクトは大きさを段階（サイズクラス）に切り上げて確保し、
+//  手放されたものはそのフレームの描画が終わったことを同期オブジェクトで確かめてから
+//  同じサイズクラスと使い方の要求に使い回す（ドライバに作成と削除を往復させない）
+//  資源は移動だけができるハンドルで持ち、ハンドルが破棄されたときに返却される
+//  バッファオブジェクトは共有したコンテキストの全てで使えるが、
+//  頂点配列オブジェクトは作ったコンテキストでしか使えないのでコンテキストごとに分けて管理する
+class GpuResources
+{
+public:
+
+    //資源の種類
+    enum Kind
+    {
+        BufferObject,
+        VertexArrayObject
+    };
+
+    //資源のハンドル（コピーはできず、移動で所有権を渡す）
+    template <Kind kind>
+    class Handle
+    {
+        friend class GpuResources;
+
+        //返却先
+        GpuResources *owner;
+
+        //オブジェクト名
+        GLuint name;
+
+        //確保している大きさ（バッファオブジェクトのみ）
+        GLsizeiptr capacity;
+
+        //確保したときの使い方（バッファオブジェクトのみ）
+        GLenum usage;
+
+        //作ったコンテキスト（頂点配列オブジェクトのみ）
+        const void *context;
+
+        Handle(GpuResources *owner, GLuint name, GLsizeiptr capacity, GLenum usage, const void *context)
+        : owner(owner), name(name), capacity(capacity), usage(usage), context(context)
+        {
+        }
+
+    public:
+
+        //空のハンドル
+        Handle()
+        : owner(NULL), name(0), capacity(0), usage(0), context(NULL)
+        {
+        }
+
+        //ムーブコンストラクタ
+        Handle(Handle &&h) noexcept
+        : owner(h.owner), name(h.name), capacity(h.capacity), usage(h.usage), context(h.context)
+        {
+            h.owner = NULL;
+            h.name = 0;
+        }
+
+        //ムーブ代入（持っていた資源は返却する）
+        Handle &operator = (Handle &&h) noexcept
+        {
+            if(this != &h)
+            {
+                reset();
+                owner = h.owner; name = h.name; capacity = h.capacity; usage = h.usage; context = h.context;
+                h.owner = NULL;
+                h.name = 0;
+            }
+            return *this;
+        }
+
+        //デストラクタ
+        ~Handle()
+        {
+            reset();
+        }
+
+    private:
+        //コピーコンストラクタによるコピー禁止
+        Handle(const Handle &h);
+        //代入によるコピー禁止
+        Handle &operator = (const Handle &h);
+
+    public:
+
+        //資源を返却して空にする（実際に使い回されるのは描画が終わってから）
+        void reset()
+        {
+            if(owner != NULL) owner -> retire(kind, name, capacity, usage, context);
+            owner = NULL;
+            name = 0;
+        }
+
+        //オブジェクト名
+        GLuint get() const { return name; }
+
+        //確保している大きさ
+        GLsizeiptr size() const { return capacity; }
+
+        //資源を持っているか
+        explicit operator bool() const { return name != 0; }
+    };
+
+    typedef Handle<BufferObject> Buffer;
+    typedef Handle<VertexArrayObject> VertexArray;
+
+    //コンテキストごとに作る頂点配列オブジェクト
+    //  同じバッファオブジェクトを別のコンテキストで描画するときはそのコンテキスト用に作って設定する
+    class VertexArraySet
+    {
+        //コンテキストとそこで作った頂点配列オブジェクト（普通は一つか二つ）
+        std::vector<std::pair<const void *, VertexArray>> arrays;
+
+        //使用量の記録に使う持ち主
+        const char *owner;
+
+    public:
+
+        //コンストラクタ
+        //  owner: 使用量の記録に使う持ち主
+        explicit VertexArraySet(const char *owner = NULL)
+        : owner(owner)
+        {
+        }
+
+        //現在のコンテキストの頂点配列オブジェクトを結合する
+        //  setup: 初めて使うコンテキストで作った頂点配列オブジェクトに頂点属性を設定する処理
+        template <typename Setup>
+        void bind(Setup setup)
+        {
+            GpuResources &resources(instance());
+            for(const auto &a : arrays)
+            {
+                if(a.first == resources.getContext())
+                {
+                    glBindVertexArray(a.second.get());
+                    return;
+                }
+            }
+
+            //結合された状態で渡されるのでそのまま設定する
+            arrays.emplace_back(resources.getContext(), resources.acquireVertexArray(owner));
+            setup();
+        }
+    };
+
+    //作成・使い回し・削除の回数
+    struct Stats
+    {
+        unsigned long created, reused, deleted;
+    };
+
+private:
+
+    //返却された資源
+    struct Entry
+    {
+        Kind kind;
+        GLuint name;
+        GLsizeiptr capacity;
+        GLenum usage;
+        const void *context;
+    };
+
+    //同じフレームに返却された資源とそのフレームの描画の完了を待つ同期オブジェクト
+    struct Batch
+    {
+        GLsync fence;
+        std::vector<Entry> entries;
+    };
+
+    //このフレームに返却された資源
+    std::vector<Entry> retired;
+
+    //描画の完了を待っている資源（古いものから並ぶ）
+    std::deque<Batch> inflight;
+
+    //使い回せるバッファオブジェクト（サイズクラスと使い方ごと）
+    std::map<std::pair<GLsizeiptr, GLenum>, std::vector<GLuint>> buffers;
+
+    //使い回せる頂点配列オブジェクト（コンテキストごと）
+    std::map<const void *, std::vector<GLuint>> arrays;
+
+    //現在のコンテキストと資源を作ったことのあるコンテキスト
+    const void *current;
+    std::vector<const void *> contexts;
+
+    //一つのサイズクラスに取っておく数の上限（超えた分は削除する）
+    const std::size_t keep;
+
+    //作成・使い回し・削除の回数
+    Stats stats;
+
+    //資源を返却する（ここでは GL の関数を呼ばない）
+    void retire(Kind kind, GLuint name, GLsizeiptr capacity, GLenum usage, const void *context)
+    {
+        //破棄したコンテキストの頂点配列オブジェクトはもう存在しない
+        if(kind == VertexArrayObject
+           && std::find(contexts.begin(), contexts.end(), context) == contexts.end()) return;
+
+        const Entry e = { kind, name, capacity, usage, context };
+        retired.push_back(e);
+
+        //使い回すまでは管理者が持っているものとして記録する
+        GpuMemory::instance().allocate(type(kind), name, capacity, 0, usage, "GpuResources (pooled)",
+                                       kind == VertexArrayObject ? context : NULL);
+    }
+
+    //使用量の記録での資源の種類
+    static GpuMemory::Type type(Kind kind)
+    {
+        return kind == BufferObject ? GpuMemory::Buffer : GpuMemory::VertexArray;
+    }
+
+    //描画が終わった資源を使い回せるようにする
+    void recycle(const Entry &e)
+    {
+        std::vector<GLuint> &spare(e.kind == BufferObject
+            ? buffers[std::make_pair(e.capacity, e.usage)] : arrays[e.context]);
+
+        //別のコンテキストの頂点配列オブジェクトはここでは削除できないので取っておく
+        if(spare.size() < keep || (e.kind == VertexArrayObject && e.context != current))
+        {
+            spare.push_back(e.name);
+            return;
+        }
+
+        //取っておく数を超えていれば削除する
+        if(e.kind == BufferObject) glDeleteBuffers(1, &e.name);
+        else glDeleteVertexArrays(1, &e.name);
+        GpuMemory::instance().release(type(e.kind), e.name, e.kind == VertexArrayObject ? e.context : NULL);
+        ++stats.deleted;
+    }
+
+public:
+
+    //コンストラクタ
+    //  keep: 一つのサイズクラスに取っておく数の上限
+    explicit GpuResources(std::size_t keep = 8)
+    : current(NULL)
+    , keep(keep)
+    {
+        stats.created = stats.reused = stats.deleted = 0;
+    }
+
+    //デストラクタ（GL のコンテキストがないかもしれないので何もしない、clear() で解放する）
+    virtual ~GpuResources()
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    GpuResources(const GpuResources &r);
+    //代入によるコピー禁止
+    GpuResources &operator = (const GpuResources &r);
+
+public:
+
+    //プログラム全体で使う管理者
+    static GpuResources &instance()
+    {
+        static GpuResources resources;
+        return resources;
+    }
+
+    //処理対象のコンテキストを切り替えたことを知らせる（Window から呼ぶ）
+    //  context: コンテキストを区別する値（GLFW のウィンドウのハンドル）
+    void setContext(const void *context)
+    {
+        current = context;
+        if(std::find(contexts.begin(), contexts.end(), context) == contexts.end())
+            contexts.push_back(context);
+    }
+
+    //現在のコンテキスト
+    const void *getContext() const { return current; }
+
+    //確保する大きさを求める（256 バイトから 1MB までは 2 のべき乗、それ以上は 1MB 単位）
+    static GLsizeiptr sizeClass(GLsizeiptr size)
+    {
+        const GLsizeiptr large(1 << 20);
+        if(size > large) return (size + large - 1) / large * large;
+        GLsizeiptr c(256);
+        while(c < size) c <<= 1;
+        return c;
+    }
+
+    //バッファオブジェクトを取り出す
+    //  size: 必要な大きさ（サイズクラスに切り上げて確保する）
+    //  usage: 使い方（GL_STATIC_DRAW など）
+    //  data: 先頭に書き込むデータ（NULL なら書き込まない）
+    //  owner: 使用量の記録に使う持ち主
+    //  payload: 実際にデータを置く大きさ（負なら size、size との差は持ち主の詰め物として記録する）
+    Buffer acquireBuffer(GLsizeiptr size, GLenum usage, const GLvoid *data = NULL,
+                         const char *owner = NULL, GLsizeiptr payload = -1)
+    {
+        const GLsizeiptr capacity(sizeClass(size));
+        std::vector<GLuint> &spare(buffers[std::make_pair(capacity, usage)]);
+        GLuint name;
+
+        //どの頂点配列オブジェクトにも記録されない結合ポイントを使う
+        if(spare.empty())
+        {
+            glGenBuffers(1, &name);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, usage);
+            ++stats.created;
+        }
+        else
+        {
+            name = spare.back();
+            spare.pop_back();
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+            ++stats.reused;
+        }
+
+        //使い回したものも描画は終わっているので待たずに書き込める
+        if(data != NULL && size > 0) glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        //サイズクラスへの切り上げも詰め物として記録する
+        GpuMemory::instance().allocate(GpuMemory::Buffer, name, capacity, payload < 0 ? size : payload, usage, owner);
+
+        return Buffer(this, name, capacity, usage, NULL);
+    }
+
+    //頂点配列オブジェクトを取り出す（結合して返す）
+    //  owner: 使用量の記録に使う持ち主
+    VertexArray acquireVertexArray(const char *owner = NULL)
+    {
+        std::vector<GLuint> &spare(arrays[current]);
+        GLuint name;
+
+        if(spare.empty())
+        {
+            glGenVertexArrays(1, &name);
+            glBindVertexArray(name);
+            ++stats.created;
+        }
+        else
+        {
+            name = spare.back();
+            spare.pop_back();
+            glBindVertexArray(name);
+
+            //前の持ち主が設定した頂点属性とインデックスの結合を外す
+            GLint attributes;
+            glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &attributes);
+            for(GLint i = 0; i < attributes; i++)
+            {
+                glDisableVertexAttribArray(i);
+                glVertexAttribDivisor(i, 0);
+            }
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            ++stats.reused;
+        }
+        GpuMemory::instance().allocate(GpuMemory::VertexArray, name, 0, 0, 0, owner, current);
+
+        return VertexArray(this, name, 0, 0, current);
+    }
+
+    //フレームの終わりに呼び出す
+    //  このフレームに返却された資源にこのフレームの描画の完了を待つ同期オブジェクトを付け、
+    //  描画が終わった資源を使い回せるようにする
+    void endFrame()
+    {
+        if(!retired.empty())
+        {
+            Batch b;
+            b.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            b.entries.swap(retired);
+            inflight.push_back(std::move(b));
+        }
+
+        //終わっていないものがあればそれより新しいものも終わっていない
+        while(!inflight.empty())
+        {
+            const GLenum status(glClientWaitSync(inflight.front().fence, 0, 0));
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+            glDeleteSync(inflight.front().fence);
+            for(const Entry &e : inflight.front().entries) recycle(e);
+            inflight.pop_front();
+        }
+    }
+
+    //現在のコンテキストの資源を削除する（コンテキストを破棄する前に呼び出す）
+    //  頂点配列オブジェクトはこのコンテキストのものだけを削除し、
+    //  バッファオブジェクトは共有している最後のコンテキストのときに削除する
+    void clear()
+    {
+        //GL は使用中のオブジェクトの削除を描画が終わるまで遅らせるので待たなくてよい
+        GpuMemory &memory(GpuMemory::instance());
+        const auto own([this](const Entry &e){ return e.kind == VertexArrayObject && e.context == current; });
+        const auto drop([this, &own, &memory](std::vector<Entry> &entries)
+        {
+            for(const Entry &e : entries)
+            {
+                if(!own(e)) continue;
+                glDeleteVertexArrays(1, &e.name);
+                memory.release(GpuMemory::VertexArray, e.name, current);
+                ++stats.deleted;
+            }
+            entries.erase(std::remove_if(entries.begin(), entries.end(), own), entries.end());
+        });
+        drop(retired);
+        for(Batch &b : inflight) drop(b.entries);
+
+        const std::vector<GLuint> &spare(arrays[current]);
+        if(!spare.empty()) glDeleteVertexArrays(static_cast<GLsizei>(spare.size()), spare.data());
+        for(GLuint name : spare) memory.release(GpuMemory::VertexArray, name, current);
+        stats.deleted += spare.size();
+        arrays.erase(current);
+        memory.releaseContext(current);
+        contexts.erase(std::remove(contexts.begin(), contexts.end(), current), contexts.end());
+
+        //ほかのコンテキストが残っていればバッファオブジェクトはそちらで使い続ける
+        if(!contexts.empty()) return;
+
+        for(Batch &b : inflight)
+        {
+            glDeleteSync(b.fence);
+            retired.insert(retired.end(), b.entries.begin(), b.entries.end());
+        }
+        inflight.clear();
+
+        for(const Entry &e : retired)
+        {
+            if(e.kind != BufferObject) continue;
+            glDeleteBuffers(1, &e.name);
+            memory.release(GpuMemory::Buffer, e.name);
+            ++stats.deleted;
+        }
+        retired.clear();
+
+        for(auto &b : buffers)
+        {
+            if(!b.second.empty()) glDeleteBuffers(static_cast<GLsizei>(b.second.size()), b.second.data());
+            for(GLuint name : b.second) memory.release(GpuMemory::Buffer, name);
+            stats.deleted += b.second.size();
+        }
+        buffers.clear();
+        arrays.clear();
+    }
+
+    //作成・使い回し・削除の回数
+    const Stats &getStats() const { return stats; }
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 入力イベント
+struct InputEvent
+{
+    //イベントの種類
+    enum Type
+    {
+        Key,            //キーの操作（code: キー, action: GLFW_PRESS など）
+        MouseButton,    //マウスのボタンの操作（code: ボタン, action: GLFW_PRESS など, x, y: 位置）
+        CursorPos,      //マウスカーソルの移動（x, y: 位置）
+        Scroll,         //マウスホイールの操作（x, y: 移動量）
+        Resize          //ウィンドウのサイズ変更（x, y: 幅と高さ）
+    };
+
+    //イベントの種類
+    Type type;
+
+    //キーまたはボタン
+    int code;
+
+    //押したか離したか
+    int action;
+
+    //同時に押されていた修飾キー
+    int mods;
+
+    //位置や移動量
+    double x, y;
+
+    //イベントを受け取った時刻（glfwGetTime() の値）
+    double time;
+};
+
+// 入力イベントのロックフリーのリングバッファ
+//  書き込むのは GLFW のコールバックを呼ぶスレッド一つだけで、
+//  読み出す側はスレッドごとに Reader を作ってそれぞれ全てのイベントを受け取る
+template <unsigned int capacity = 1024>
+class InputRing
+{
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    //リングバッファの要素
+    struct Slot
+    {
+        //書き込みが終わったイベントの通し番号 + 1（書き込み中は0）
+        std::atomic<std::uint64_t> sequence;
+
+        //イベント
+        InputEvent event;
+    };
+
+    //リングバッファ
+    Slot ring[capacity];
+
+    //次に書き込むイベントの通し番号
+    alignas(64) std::atomic<std::uint64_t> head;
+
+public:
+
+    //コンストラクタ
+    InputRing()
+    : head(0)
+    {
+        for(Slot &s : ring) s.sequence.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    InputRing(const InputRing &r);
+    //代入によるコピー禁止
+    InputRing &operator = (const InputRing &r);
+
+public:
+
+    //イベントを追加する（書き込み側のスレッドから呼ぶ）
+    //  e: 追加するイベント
+    void push(const InputEvent &e)
+    {
+        const std::uint64_t n(head.load(std::memory_order_relaxed));
+        Slot &s(ring[n & (capacity - 1)]);
+
+        //書き込み中であることを示してからイベントを書き込む
+        s.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.event = e;
+        s.sequence.store(n + 1, std::memory_order_release);
+        head.store(n + 1, std::memory_order_release);
+    }
+
+    // イベントの読み出し側（スレッドごとに一つ作る）
+    class Reader
+    {
+        //読み出すリングバッファ
+        const InputRing &queue;
+
+        //次に読み出すイベントの通し番号
+        std::uint64_t tail;
+
+        //追い越されて失ったイベントの数
+        std::uint64_t lost;
+
+    public:
+
+        //コンストラクタ（リングバッファに残っている一番古いイベントから読み出す）
+        //  queue: 読み出すリングバッファ
+        Reader(const InputRing &queue)
+        : queue(queue), tail(0), lost(0)
+        {
+            const std::uint64_t head(queue.head.load(std::memory_order_acquire));
+            if(head > capacity) tail = head - capacity;
+        }
+
+        //次のイベントを取り出す
+        //  e: 取り出したイベントの格納先
+        //  戻り値: 取り出せたら true
+        bool next(InputEvent &e)
+        {
+            for(;;)
+            {
+                const std::uint64_t head(queue.head.load(std::memory_order_acquire));
+                if(tail == head) return false;
+
+                //一周以上遅れていたら残っている一番古いイベントまで飛ばす
+                if(head - tail > capacity)
+                {
+                    lost += head - capacity - tail;
+                    tail = head - capacity;
+                }
+
+                //イベントを写し、写している間に上書きされていないか確かめる
+                const Slot &s(queue.ring[tail & (capacity - 1)]);
+                const std::uint64_t before(s.sequence.load(std::memory_order_acquire));
+                e = s.event;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const std::uint64_t after(s.sequence.load(std::memory_order_relaxed));
+
+                if(before == tail + 1 && after == before)
+                {
+                    ++tail;
+                    return true;
+                }
+
+                //上書きされていたら読み直す
+                if(before > tail + 1 || after > tail + 1) continue;
+
+                //まだ書き込み中なら次の機会に読む
+                return false;
+            }
+        }
+
+        //溜まっているイベントを全て取り出して処理する
+        //  f: イベントを受け取る関数
+        template <typename F>
+        void drain(F f)
+        {
+            InputEvent e;
+            while(next(e)) f(e);
+        }
+
+        //追い越されて失ったイベントの数
+        std::uint64_t dropped() const { return lost; }
+    };
+};
+
+// ウィンドウの入力イベントのキュー
+using InputQueue = InputRing<>;
@@ -17,3 +17,10 @@ struct Material
     //輝き係数
     alignas(4) GLfloat shininess;
 };
+
+//材質の比較（詰め物の部分は比べない）
+inline bool operator==(const Material &a, const Material &b)
+{
+    return a.ambient == b.ambient && a.diffuse == b.diffuse
+        && a.specular == b.specular && a.shininess == b.shininess;
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <GL/glew.h>
+
+//GPU メモリの使用量の記録
+#include "GpuMemory.h"
+
+//材質データ
+#include "Material.h"
+
+// 全ての材質を一つのテクスチャバッファオブジェクトに詰めて管理する
+//  Material は std140 の配列と同じ 48 バイト（vec4 三つ分）なので
+//  隙間なく並べたものを GL_RGBA32F のテクセル三つずつとして読み出せる
+//  テクセル0: Kamb.rgb, テクセル1: Kdiff.rgb, テクセル2: Kspec.rgb + Kshi
+class MaterialRegistry
+{
+    //一つの材質は std140 の配列の要素一つ分（vec4 三つ）に収まる
+    static_assert(sizeof (Material) == 48, "Material must match the std140 array stride");
+
+    //材質のハッシュ値を求める
+    struct Hash
+    {
+        size_t operator()(const Material &m) const
+        {
+            const std::hash<GLfloat> h;
+            size_t seed(h(m.shininess));
+            for(int i = 0; i < 3; i++)
+            {
+                seed = seed * 31 + h(m.ambient[i]);
+                seed = seed * 31 + h(m.diffuse[i]);
+                seed = seed * 31 + h(m.specular[i]);
+            }
+            return seed;
+        }
+    };
+
+    //登録済みの材質（この並びのまま GPU に送る）
+    std::vector<Material> materials;
+
+    //材質から登録番号を引く表（同じ値の材質を一つにまとめる）
+    std::unordered_map<Material, GLuint, Hash> lookup;
+
+    //バッファオブジェクト名
+    GLuint buffer;
+
+    //バッファテクスチャ名
+    GLuint texture;
+
+    //確保済みのバッファオブジェクトに入る材質の数
+    GLsizei capacity;
+
+    //GPU に送っていない材質があるか
+    bool dirty;
+
+public:
+
+    //コンストラクタ
+    //  data: 最初に登録する材質
+    //  count: 最初に登録する材質の数
+    MaterialRegistry(const Material *data = NULL, unsigned int count = 0)
+    : capacity(0), dirty(true)
+    {
+        //バッファオブジェクトを作成する
+        glGenBuffers(1, &buffer);
+
+        //バッファオブジェクトをテクスチャとして参照できるようにする
+        glGenTextures(1, &texture);
+
+        //最初の材質を登録する
+        for(unsigned int i = 0; i < count; i++) add(data[i]);
+    }
+
+    //デストラクタ
+    virtual ~MaterialRegistry()
+    {
+        //バッファテクスチャを削除する
+        glDeleteTextures(1, &texture);
+
+        //バッファオブジェクトを削除する
+        GpuMemory::instance().release(GpuMemory::Buffer, buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    MaterialRegistry(const MaterialRegistry &r);
+    //代入によるコピー禁止
+    MaterialRegistry &operator = (const MaterialRegistry &r);
+
+public:
+
+    //材質を登録して番号を返す（同じ値の材質が登録済みならその番号を返す）
+    //  m: 登録する材質
+    GLuint add(const Material &m)
+    {
+        const auto found(lookup.find(m));
+        if(found != lookup.end()) return found -> second;
+
+        const GLuint index(static_cast<GLuint>(materials.size()));
+        materials.emplace_back(m);
+        lookup.emplace(m, index);
+        dirty = true;
+
+        return index;
+    }
+
+    //登録済みの材質を書き換える
+    //  index: 書き換える材質の番号
+    //  m: 新しい材質
+    void set(GLuint index, const Material &m)
+    {
+        //書き換える前の値で引けないようにする
+        const auto found(lookup.find(materials[index]));
+        if(found != lookup.end() && found -> second == index) lookup.erase(found);
+
+        materials[index] = m;
+        lookup.emplace(m, index);
+        dirty = true;
+    }
+
+    //登録済みの材質の数
+    GLsizei size() const
+    {
+        return static_cast<GLsizei>(materials.size());
+    }
+
+    //変更された材質を GPU に送る（フレームの始めに一度だけ呼ぶ）
+    void update()
+    {
+        if(!dirty) return;
+
+        const GLsizei count(size());
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+
+        if(count > capacity)
+        {
+            //足りなければ倍々に確保し直す
+            capacity = std::max(count, capacity * 2);
+            glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof (Material), NULL, GL_DYNAMIC_DRAW);
+
+            //確保し直したバッファオブジェクトをテクスチャに結びつける
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        }
+
+        //詰めて並べた材質をまとめて転送する
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, count * sizeof (Material), materials.data());
+        dirty = false;
+
+        //倍々に確保した残りは詰め物として記録する
+        GpuMemory::instance().allocate(GpuMemory::Buffer, buffer, capacity * sizeof (Material),
+                                       count * sizeof (Material), GL_DYNAMIC_DRAW, "MaterialRegistry");
+    }
+
+    //材質のバッファテクスチャを使用する（フレームごとに一度だけ呼ぶ）
+    //  unit: 結合するテクスチャユニットの番号
+    void select(GLuint unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+};
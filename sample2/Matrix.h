@@ -3,6 +3,23 @@
 #include <algorithm>
 #include <GL/glew.h>
 
+// 三つの列ベクトルからなる 3x3 行列の余因子行列を求める（逆行列の転置の行列式倍）
+//  c0, c1, c2: 列ベクトル
+//  m: 余因子行列の格納先（列優先）
+constexpr void cofactor(const GLfloat *c0, const GLfloat *c1, const GLfloat *c2, GLfloat *m)
+{
+    // 1列目 = c1 × c2, 2列目 = c2 × c0, 3列目 = c0 × c1
+    m[0] = c1[1] * c2[2] - c1[2] * c2[1];
+    m[1] = c1[2] * c2[0] - c1[0] * c2[2];
+    m[2] = c1[0] * c2[1] - c1[1] * c2[0];
+    m[3] = c2[1] * c0[2] - c2[2] * c0[1];
+    m[4] = c2[2] * c0[0] - c2[0] * c0[2];
+    m[5] = c2[0] * c0[1] - c2[1] * c0[0];
+    m[6] = c0[1] * c1[2] - c0[2] * c1[1];
+    m[7] = c0[2] * c1[0] - c0[0] * c1[2];
+    m[8] = c0[0] * c1[1] - c0[1] * c1[0];
+}
+
 // 変換行列
 class Matrix
 {
@@ -13,6 +30,10 @@ public:
     // コンストラクタ
     Matrix() {}
     
+    // 要素を0で初期化するコンストラクタ（定数式の中で使う）
+    struct Zero {};
+    constexpr explicit Matrix(Zero) : matrix{} {}
+    
     // 配列の内容で初期化するコンストラクタ
     // a: GLfloat型の 16 要素の行列
     Matrix(const GLfloat *a)
@@ -26,18 +47,15 @@ public:
         return matrix;
     }
     
+    //変換行列の要素を返す（定数式の中でも使える）
+    constexpr GLfloat operator[](int i) const { return matrix[i]; }
+    constexpr GLfloat &operator[](int i) { return matrix[i]; }
+    
     //法線ベクトルの変換行列を求める
     void getNormalMatrix(GLfloat *m) const
     {
-        m[0] = matrix[ 5] * matrix[10] - matrix[ 6] * matrix[ 9];
-        m[1] = matrix[ 6] * matrix[ 8] - matrix[ 4] * matrix[10];
-        m[2] = matrix[ 4] * matrix[ 9] - matrix[ 5] * matrix[ 8];
-        m[3] = matrix[ 9] * matrix[ 2] - matrix[10] * matrix[ 1];
-        m[4] = matrix[10] * matrix[ 0] - matrix[ 8] * matrix[ 2];
-        m[5] = matrix[ 8] * matrix[ 1] - matrix[ 9] * matrix[ 0];
-        m[6] = matrix[ 1] * matrix[ 6] - matrix[ 2] * matrix[ 5];
-        m[7] = matrix[ 2] * matrix[ 4] - matrix[ 0] * matrix[ 6];
-        m[8] = matrix[ 0] * matrix[ 5] - matrix[ 1] * matrix[ 4];
+        //左上 3x3 の余因子行列（法線は後で正規化するので行列式で割らない）
+        cofactor(matrix, matrix + 4, matrix + 8, m);
     }
     
     
@@ -128,6 +146,51 @@ public:
         return t;
     }
     
+    //逆行列を求める（行列式が0なら単位行列を返す）
+    Matrix inverse() const
+    {
+        //転置の逆行列は逆行列の転置なので、配列を行優先とみなして求めても同じ
+        const GLfloat *const a(matrix);
+        
+        // 上の2行と下の2行の2x2の小行列式
+        const GLfloat s0(a[0] * a[5] - a[4] * a[1]);
+        const GLfloat s1(a[0] * a[6] - a[4] * a[2]);
+        const GLfloat s2(a[0] * a[7] - a[4] * a[3]);
+        const GLfloat s3(a[1] * a[6] - a[5] * a[2]);
+        const GLfloat s4(a[1] * a[7] - a[5] * a[3]);
+        const GLfloat s5(a[2] * a[7] - a[6] * a[3]);
+        const GLfloat c5(a[10] * a[15] - a[14] * a[11]);
+        const GLfloat c4(a[ 9] * a[15] - a[13] * a[11]);
+        const GLfloat c3(a[ 9] * a[14] - a[13] * a[10]);
+        const GLfloat c2(a[ 8] * a[15] - a[12] * a[11]);
+        const GLfloat c1(a[ 8] * a[14] - a[12] * a[10]);
+        const GLfloat c0(a[ 8] * a[13] - a[12] * a[ 9]);
+        
+        const GLfloat det(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+        if(det == 0.0f) return identity();
+        const GLfloat r(1.0f / det);
+        
+        Matrix t;
+        t.matrix[ 0] = ( a[ 5] * c5 - a[ 6] * c4 + a[ 7] * c3) * r;
+        t.matrix[ 1] = (-a[ 1] * c5 + a[ 2] * c4 - a[ 3] * c3) * r;
+        t.matrix[ 2] = ( a[13] * s5 - a[14] * s4 + a[15] * s3) * r;
+        t.matrix[ 3] = (-a[ 9] * s5 + a[10] * s4 - a[11] * s3) * r;
+        t.matrix[ 4] = (-a[ 4] * c5 + a[ 6] * c2 - a[ 7] * c1) * r;
+        t.matrix[ 5] = ( a[ 0] * c5 - a[ 2] * c2 + a[ 3] * c1) * r;
+        t.matrix[ 6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * r;
+        t.matrix[ 7] = ( a[ 8] * s5 - a[10] * s2 + a[11] * s1) * r;
+        t.matrix[ 8] = ( a[ 4] * c4 - a[ 5] * c2 + a[ 7] * c0) * r;
+        t.matrix[ 9] = (-a[ 0] * c4 + a[ 1] * c2 - a[ 3] * c0) * r;
+        t.matrix[10] = ( a[12] * s4 - a[13] * s2 + a[15] * s0) * r;
+        t.matrix[11] = (-a[ 8] * s4 + a[ 9] * s2 - a[11] * s0) * r;
+        t.matrix[12] = (-a[ 4] * c3 + a[ 5] * c1 - a[ 6] * c0) * r;
+        t.matrix[13] = ( a[ 0] * c3 - a[ 1] * c1 + a[ 2] * c0) * r;
+        t.matrix[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * r;
+        t.matrix[15] = ( a[ 8] * s3 - a[ 9] * s1 + a[10] * s0) * r;
+        
+        return t;
+    }
+    
     //ビュー変換行列を作成する
     static Matrix lookat(
     GLfloat ex, GLfloat ey, GLfloat ez,   //視点の位置
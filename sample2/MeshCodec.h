@@ -0,0 +1,762 @@
+#pragma once
+#include <cmath>
+#include <queue>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <GL/glew.h>
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+//図形データ
+#include "Object.h"
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+// 図形データの圧縮
+//  頂点の位置は図形の境界ボックスに対して 16 ビットに量子化し、法線は八面体に写して 8 ビット二つに量子化する
+//  成分ごとに前の頂点との差を取って符号を下位ビットに移し、バイトごとの面（下位バイトの列、上位バイトの列…）に
+//  分けてそれぞれハフマン符号で圧縮する（インデックスも前のインデックスとの差を同じように圧縮する）
+//  ハフマン符号は四つの列に交互に振り分け、復号のときは四つを並べて読んで待ち時間を重ねる
+//  差の累積、量子化の復元、法線の展開は SSE2 でまとめて行って Object::Vertex の並びに直接書き込むので、
+//  Shape::fill() でマップしたバッファオブジェクトに復号すれば写し直さずに転送できる
+//  （数値はリトルエンディアンで格納する）
+class MeshCodec
+{
+    //圧縮したデータの先頭の識別子
+    static constexpr std::uint32_t magic = 0x3148534d; // "MSH1"
+
+    //バイトの面の数（位置 3 成分 × 2 バイト、法線 2 成分 × 1 バイト、インデックス 4 バイト）
+    static constexpr int positionPlanes = 6, normalPlanes = 2, indexPlanes = 4;
+    static constexpr int planes = positionPlanes + normalPlanes + indexPlanes;
+
+    //ハフマン符号の最長の符号長（復号の表の大きさが 2 のこの乗になる）
+    static constexpr int maxLength = 12;
+
+    //ハフマン符号の面を分ける列の数
+    static constexpr int streams = 4;
+
+    //ハフマン符号の列を読み出す
+    struct Reader
+    {
+        //次に読むバイトと列の終わり
+        const unsigned char *q, *last;
+
+        //読み出したビットとその数
+        std::uint64_t bits;
+        int filled;
+
+        //ビットを 56 個以上に補う（列の終わりでは残りのバイトだけ）
+        void refill()
+        {
+            if(last - q >= 8)
+            {
+                std::uint64_t word;
+                memcpy(&word, q, sizeof word);
+                bits |= word << filled;
+                q += (63 - filled) >> 3;
+                filled |= 56;
+            }
+            else
+            {
+                while(filled <= 56 && q < last)
+                {
+                    bits |= static_cast<std::uint64_t>(*q++) << filled;
+                    filled += 8;
+                }
+            }
+        }
+
+        //一記号読む（符号が足りなければ filled が負になる）
+        unsigned char read(const std::uint16_t *lookup)
+        {
+            const std::uint16_t e(lookup[bits & ((1u << maxLength) - 1)]);
+            bits >>= e >> 8;
+            filled -= e >> 8;
+            return static_cast<unsigned char>(e);
+        }
+    };
+
+    //バイトの面の格納方法
+    enum Mode
+    {
+        Raw,        //そのまま
+        Constant,   //全て同じ値
+        Huffman     //ハフマン符号
+    };
+
+    //ハフマン符号の面の符号の列より前の部分（符号長の表と最後の列以外の大きさ）の大きさ
+    static constexpr std::size_t huffmanHeader = 128 + (streams - 1) * sizeof(std::uint32_t);
+
+    //圧縮したデータの先頭
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t vertexcount, indexcount;
+
+        //量子化した位置の原点と一段階の大きさ
+        GLfloat origin[3], step[3];
+    };
+
+    //数値を書き込む
+    template <typename T>
+    static void put(std::vector<unsigned char> &out, const T &value)
+    {
+        const unsigned char *const p(reinterpret_cast<const unsigned char *>(&value));
+        out.insert(out.end(), p, p + sizeof value);
+    }
+
+    //数値を読み出す（足りなければ false）
+    template <typename T>
+    static bool get(const unsigned char *&p, const unsigned char *end, T &value)
+    {
+        if(static_cast<std::size_t>(end - p) < sizeof value) return false;
+        memcpy(&value, p, sizeof value);
+        p += sizeof value;
+        return true;
+    }
+
+    //符号を下位ビットに移す（0, -1, 1, -2, … を 0, 1, 2, 3, … にする）
+    static std::uint32_t zigzag(std::int32_t v)
+    {
+        return (static_cast<std::uint32_t>(v) << 1) ^ static_cast<std::uint32_t>(v >> 31);
+    }
+
+    //zigzag() の逆
+    static std::uint32_t unzigzag(std::uint32_t z)
+    {
+        return (z >> 1) ^ (0u - (z & 1u));
+    }
+
+    //記号の出現回数から最長の符号長を超えないハフマン符号の符号長を求める
+    static void buildLengths(const std::uint32_t *count, unsigned char *length)
+    {
+        std::uint32_t freq[256];
+        std::copy(count, count + 256, freq);
+        for(;;)
+        {
+            std::fill(length, length + 256, 0);
+
+            //出現回数の少ない二つをまとめることを繰り返して木を作る
+            typedef std::pair<std::uint64_t, int> Node;
+            std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+            std::vector<int> parent;
+            for(int s = 0; s < 256; s++)
+            {
+                if(freq[s] == 0) continue;
+                queue.push(Node(freq[s], static_cast<int>(parent.size())));
+                parent.push_back(-(s + 1));
+            }
+            if(parent.empty()) return;
+            if(parent.size() == 1)
+            {
+                length[-parent[0] - 1] = 1;
+                return;
+            }
+
+            //葉の番号は記号、節の番号は parent の位置
+            std::vector<int> up(parent.size(), -1);
+            while(queue.size() > 1)
+            {
+                const Node a(queue.top()); queue.pop();
+                const Node b(queue.top()); queue.pop();
+                const int n(static_cast<int>(up.size()));
+                up.push_back(-1);
+                up[a.second] = up[b.second] = n;
+                queue.push(Node(a.first + b.first, n));
+            }
+
+            //葉の深さが符号長
+            int longest(0);
+            for(std::size_t i = 0; i < parent.size(); i++)
+            {
+                int depth(0);
+                for(int n = static_cast<int>(i); up[n] >= 0; n = up[n]) ++depth;
+                length[-parent[i] - 1] = static_cast<unsigned char>(depth);
+                longest = std::max(longest, depth);
+            }
+            if(longest <= maxLength) return;
+
+            //長すぎれば出現回数の差を縮めて作り直す
+            for(std::uint32_t &f : freq) if(f > 0) f = (f >> 1) | 1u;
+        }
+    }
+
+    //符号長から下位ビットから読む順に並べた標準ハフマン符号を求める
+    static void buildCodes(const unsigned char *length, std::uint32_t *code)
+    {
+        std::uint32_t next(0);
+        for(int l = 1; l <= maxLength; l++)
+        {
+            for(int s = 0; s < 256; s++)
+            {
+                if(length[s] != l) continue;
+
+                //ビットの順を逆にする
+                std::uint32_t r(0);
+                for(int b = 0; b < l; b++) r |= ((next >> b) & 1u) << (l - 1 - b);
+                code[s] = r;
+                ++next;
+            }
+            next <<= 1;
+        }
+    }
+
+    //バイトの列を一つの面として書き込む
+    static void encodePlane(std::vector<unsigned char> &out, const std::vector<unsigned char> &plane)
+    {
+        std::uint32_t count[256] = {};
+        for(unsigned char c : plane) ++count[c];
+
+        //全て同じ値なら一つだけ書く
+        if(plane.empty() || count[plane[0]] == plane.size())
+        {
+            out.push_back(Constant);
+            put(out, static_cast<std::uint32_t>(1));
+            out.push_back(plane.empty() ? 0 : plane[0]);
+            return;
+        }
+
+        unsigned char length[256];
+        std::uint32_t code[256];
+        buildLengths(count, length);
+        buildCodes(length, code);
+
+        //記号を順に四つの列に振り分け、それぞれ下位ビットから詰めた符号にする
+        std::vector<unsigned char> stream[streams];
+        std::uint64_t bits[streams] = {};
+        int filled[streams] = {};
+        for(std::size_t i = 0; i < plane.size(); i++)
+        {
+            const int k(i % streams);
+            const unsigned char c(plane[i]);
+            bits[k] |= static_cast<std::uint64_t>(code[c]) << filled[k];
+            filled[k] += length[c];
+            while(filled[k] >= 8)
+            {
+                stream[k].push_back(static_cast<unsigned char>(bits[k]));
+                bits[k] >>= 8;
+                filled[k] -= 8;
+            }
+        }
+
+        //符号長の表（四ビットずつ）、最後の列以外の大きさ、四つの列の順に書く
+        std::vector<unsigned char> payload(128);
+        for(int s = 0; s < 256; s += 2)
+            payload[s / 2] = static_cast<unsigned char>(length[s] | (length[s + 1] << 4));
+        for(int k = 0; k < streams; k++)
+        {
+            if(filled[k] > 0) stream[k].push_back(static_cast<unsigned char>(bits[k]));
+            if(k < streams - 1) put(payload, static_cast<std::uint32_t>(stream[k].size()));
+        }
+        for(const std::vector<unsigned char> &b : stream) payload.insert(payload.end(), b.begin(), b.end());
+
+        //縮まなければそのまま書く
+        const bool raw(payload.size() >= plane.size());
+        out.push_back(raw ? Raw : Huffman);
+        put(out, static_cast<std::uint32_t>(raw ? plane.size() : payload.size()));
+        if(raw) out.insert(out.end(), plane.begin(), plane.end());
+        else out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    //一つの面を読み飛ばす（足りないか n バイトに戻せる大きさでなければ false）
+    //  n: 戻したときのバイト数（ヘッダの頂点かインデックスの数）
+    static bool skipPlane(const unsigned char *&p, const unsigned char *end, std::size_t n)
+    {
+        unsigned char mode;
+        std::uint32_t size;
+        if(!get(p, end, mode) || !get(p, end, size) || static_cast<std::size_t>(end - p) < size) return false;
+        p += size;
+
+        //ヘッダの数が壊れていても戻す領域を確保する前に分かるようにする
+        switch(mode)
+        {
+            case Constant:
+                return size == 1;
+
+            case Raw:
+                return size == n;
+
+            case Huffman:
+                //一つの記号は少なくとも 1 ビットなので n ビットより短い符号の列はない
+                return size >= huffmanHeader && (static_cast<std::uint64_t>(size) - huffmanHeader) * 8 >= n;
+
+            default:
+                return false;
+        }
+    }
+
+    //一つの面を n バイトに戻す（skipPlane() で大きさを確かめた面を渡す）
+    static bool decodePlane(const unsigned char *p, std::size_t n, unsigned char *plane)
+    {
+        unsigned char mode;
+        std::uint32_t size;
+        memcpy(&mode, p, sizeof mode);
+        memcpy(&size, p + sizeof mode, sizeof size);
+        const unsigned char *const data(p + sizeof mode + sizeof size);
+
+        //空の面は書き込み先がないかもしれない
+        if(n == 0) return true;
+
+        switch(mode)
+        {
+            case Constant:
+                memset(plane, data[0], n);
+                return true;
+
+            case Raw:
+                memcpy(plane, data, n);
+                return true;
+
+            default:
+                break;
+        }
+
+        //符号の下位 maxLength ビットから記号と符号長を引く表を作る
+        unsigned char length[256];
+        for(int s = 0; s < 256; s += 2)
+        {
+            length[s] = data[s / 2] & 15;
+            length[s + 1] = data[s / 2] >> 4;
+        }
+
+        //表の全ての位置が埋まる符号でなければ壊れている
+        std::uint32_t kraft(0);
+        for(int s = 0; s < 256; s++)
+        {
+            if(length[s] > maxLength) return false;
+            if(length[s] > 0) kraft += 1u << (maxLength - length[s]);
+        }
+        if(kraft != 1u << maxLength) return false;
+
+        std::uint32_t code[256];
+        buildCodes(length, code);
+        std::vector<std::uint16_t> table(1 << maxLength);
+        for(int s = 0; s < 256; s++)
+        {
+            if(length[s] == 0) continue;
+            for(std::uint32_t j = code[s]; j < table.size(); j += 1u << length[s])
+                table[j] = static_cast<std::uint16_t>(s | (length[s] << 8));
+        }
+
+        //四つの列の始まりと終わり（最後の列は残り全部）
+        const unsigned char *q(data + 128), *const last(data + size);
+        std::uint32_t bytes[streams];
+        for(int k = 0; k < streams - 1; k++) if(!get(q, last, bytes[k])) return false;
+        Reader reader[streams];
+        for(int k = 0; k < streams; k++)
+        {
+            if(k == streams - 1) bytes[k] = static_cast<std::uint32_t>(last - q);
+            else if(bytes[k] > static_cast<std::size_t>(last - q)) return false;
+            const Reader r = { q, q + bytes[k], 0, 0 };
+            reader[k] = r;
+            q += bytes[k];
+        }
+
+        //四つの列を交互に読んで符号を読む処理の待ち時間を重ねる
+        const std::uint16_t *const lookup(table.data());
+        std::size_t i(0);
+        for(; i + streams * 4 <= n; i += streams * 4)
+        {
+            for(Reader &r : reader) r.refill();
+            for(int j = 0; j < 4; j++)
+            {
+                for(int k = 0; k < streams; k++) plane[i + j * streams + k] = reader[k].read(lookup);
+            }
+
+            //足りなくなった列があれば壊れている
+            if((reader[0].filled | reader[1].filled | reader[2].filled | reader[3].filled) < 0) return false;
+        }
+        for(; i < n; i++)
+        {
+            Reader &r(reader[i % streams]);
+            r.refill();
+            plane[i] = r.read(lookup);
+            if(r.filled < 0) return false;
+        }
+        return true;
+    }
+
+    //下位と上位のバイトの面から 16 ビットの差を戻して累積する
+    static void accumulate16(const unsigned char *lo, const unsigned char *hi, std::size_t n, std::uint16_t *out)
+    {
+        std::size_t i(0);
+        std::uint16_t previous(0);
+
+#if defined(__SSE2__)
+        const __m128i zero(_mm_setzero_si128()), one(_mm_set1_epi16(1));
+        __m128i carry(zero);
+        for(; i + 8 <= n; i += 8)
+        {
+            const __m128i z(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(lo + i)),
+                                              _mm_loadl_epi64(reinterpret_cast<const __m128i *>(hi + i))));
+            __m128i x(_mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(zero, _mm_and_si128(z, one))));
+
+            //八つの差の累積（前の塊の最後の値から続ける）
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi16(x, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+            carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(x, 0xff), 0xff);
+        }
+        if(i > 0) previous = out[i - 1];
+#endif
+
+        for(; i < n; i++)
+            out[i] = previous = static_cast<std::uint16_t>(previous + unzigzag(lo[i] | (hi[i] << 8)));
+    }
+
+    //バイトの面から 8 ビットの差を戻して累積する
+    static void accumulate8(const unsigned char *z8, std::size_t n, std::int8_t *out)
+    {
+        std::size_t i(0);
+        std::uint8_t previous(0);
+
+#if defined(__SSE2__)
+        const __m128i zero(_mm_setzero_si128()), one(_mm_set1_epi8(1)), low7(_mm_set1_epi8(0x7f));
+        __m128i carry(zero);
+        for(; i + 16 <= n; i += 16)
+        {
+            const __m128i z(_mm_loadu_si128(reinterpret_cast<const __m128i *>(z8 + i)));
+            __m128i x(_mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), low7),
+                                    _mm_sub_epi8(zero, _mm_and_si128(z, one))));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi8(x, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+            carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_unpackhi_epi8(x, x), 0xff), 0xff);
+        }
+        if(i > 0) previous = static_cast<std::uint8_t>(out[i - 1]);
+#endif
+
+        for(; i < n; i++)
+        {
+            previous = static_cast<std::uint8_t>(previous + ((z8[i] >> 1) ^ (0u - (z8[i] & 1u))));
+            out[i] = static_cast<std::int8_t>(previous);
+        }
+    }
+
+    //四つのバイトの面から 32 ビットの差を戻して累積する
+    static void accumulate32(const unsigned char *const *b, std::size_t n, GLuint *out)
+    {
+        std::size_t i(0);
+        std::uint32_t previous(0);
+
+#if defined(__SSE2__)
+        const __m128i zero(_mm_setzero_si128()), one(_mm_set1_epi32(1));
+        __m128i carry(zero);
+        for(; i + 8 <= n; i += 8)
+        {
+            //四つの面のバイトを 32 ビットに並べ直す
+            const __m128i l(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b[0] + i)),
+                                              _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b[1] + i))));
+            const __m128i h(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b[2] + i)),
+                                              _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b[3] + i))));
+            const __m128i z[] = { _mm_unpacklo_epi16(l, h), _mm_unpackhi_epi16(l, h) };
+            for(int k = 0; k < 2; k++)
+            {
+                __m128i x(_mm_xor_si128(_mm_srli_epi32(z[k], 1), _mm_sub_epi32(zero, _mm_and_si128(z[k], one))));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+                x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+                x = _mm_add_epi32(x, carry);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + k * 4), x);
+                carry = _mm_shuffle_epi32(x, 0xff);
+            }
+        }
+        if(i > 0) previous = out[i - 1];
+#endif
+
+        for(; i < n; i++)
+            out[i] = previous += unzigzag(b[0][i] | (b[1][i] << 8) | (b[2][i] << 16)
+                                          | (static_cast<std::uint32_t>(b[3][i]) << 24));
+    }
+
+    //量子化した位置と八面体に写した法線から頂点属性を求める
+    static void expand(const Header &h, const std::uint16_t *const *q, const std::int8_t *const *o,
+                       std::size_t n, Object::Vertex *vertex)
+    {
+        if(n == 0) return;
+        std::size_t i(0);
+        static constexpr GLfloat unit(1.0f / 127.0f);
+
+#if defined(__SSE2__)
+        const __m128i zero(_mm_setzero_si128());
+        const __m128 origin[] = { _mm_set1_ps(h.origin[0]), _mm_set1_ps(h.origin[1]), _mm_set1_ps(h.origin[2]) };
+        const __m128 step[] = { _mm_set1_ps(h.step[0]), _mm_set1_ps(h.step[1]), _mm_set1_ps(h.step[2]) };
+        const __m128 sign(_mm_set1_ps(-0.0f)), one(_mm_set1_ps(1.0f)), scale(_mm_set1_ps(unit));
+        GLfloat *dst(vertex[0].position);
+        for(; i + 4 <= n; i += 4, dst += 24)
+        {
+            //位置 = 原点 + 量子化した値 × 一段階の大きさ
+            __m128 p[3];
+            for(int c = 0; c < 3; c++)
+            {
+                const __m128i v(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(q[c] + i)), zero));
+                p[c] = _mm_add_ps(origin[c], _mm_mul_ps(_mm_cvtepi32_ps(v), step[c]));
+            }
+
+            //八面体の座標を符号付きで 32 ビットに広げる
+            __m128 e[2];
+            for(int c = 0; c < 2; c++)
+            {
+                int packed;
+                memcpy(&packed, o[c] + i, sizeof packed);
+                __m128i v(_mm_cvtsi32_si128(packed));
+                v = _mm_unpacklo_epi8(v, v);
+                v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+                e[c] = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+            }
+
+            //八面体から球面に戻す（z が負の側は折り返されている）
+            const __m128 z(_mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign, e[0])), _mm_andnot_ps(sign, e[1])));
+            const __m128 t(_mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps()));
+            const __m128 x(_mm_sub_ps(e[0], _mm_or_ps(t, _mm_and_ps(e[0], sign))));
+            const __m128 y(_mm_sub_ps(e[1], _mm_or_ps(t, _mm_and_ps(e[1], sign))));
+            const __m128 r(_mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)))));
+
+            //(px, py, pz, nx) を頂点ごとに並べ替え、(ny, nz) を続けて書く
+            __m128 r0(p[0]), r1(p[1]), r2(p[2]), r3(_mm_mul_ps(x, r));
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            const __m128 ny(_mm_mul_ps(y, r)), nz(_mm_mul_ps(z, r));
+            const __m128 a(_mm_unpacklo_ps(ny, nz)), b(_mm_unpackhi_ps(ny, nz));
+            _mm_storeu_ps(dst, r0);
+            _mm_storel_pi(reinterpret_cast<__m64 *>(dst + 4), a);
+            _mm_storeu_ps(dst + 6, r1);
+            _mm_storeh_pi(reinterpret_cast<__m64 *>(dst + 10), a);
+            _mm_storeu_ps(dst + 12, r2);
+            _mm_storel_pi(reinterpret_cast<__m64 *>(dst + 16), b);
+            _mm_storeu_ps(dst + 18, r3);
+            _mm_storeh_pi(reinterpret_cast<__m64 *>(dst + 22), b);
+        }
+#endif
+
+        for(; i < n; i++)
+        {
+            Object::Vertex &v(vertex[i]);
+            for(int c = 0; c < 3; c++) v.position[c] = h.origin[c] + static_cast<GLfloat>(q[c][i]) * h.step[c];
+
+            GLfloat x(o[0][i] * unit), y(o[1][i] * unit);
+            const GLfloat z(1.0f - fabsf(x) - fabsf(y));
+            const GLfloat t(std::max(-z, 0.0f));
+            x -= x >= 0.0f ? t : -t;
+            y -= y >= 0.0f ? t : -t;
+            const GLfloat r(1.0f / sqrtf(x * x + y * y + z * z));
+            v.normal[0] = x * r;
+            v.normal[1] = y * r;
+            v.normal[2] = z * r;
+        }
+    }
+
+public:
+
+    //圧縮する
+    //  vertex: 頂点属性を格納した配列
+    //  vertexcount: 頂点の数
+    //  index: 頂点のインデックスを格納した配列
+    //  indexcount: 頂点のインデックスの要素数
+    //  戻り値: 圧縮したデータ
+    static std::vector<unsigned char> encode(const Object::Vertex *vertex, GLsizei vertexcount,
+                                             const GLuint *index = NULL, GLsizei indexcount = 0)
+    {
+        const std::size_t vc(std::max(vertexcount, 0)), ic(index != NULL ? std::max(indexcount, 0) : 0);
+
+        //境界ボックスを 65535 段階に分ける
+        Header h = { magic, static_cast<std::uint32_t>(vc), static_cast<std::uint32_t>(ic), {}, {} };
+        for(int c = 0; c < 3; c++)
+        {
+            GLfloat lo(0.0f), hi(0.0f);
+            if(vc > 0) lo = hi = vertex[0].position[c];
+            for(std::size_t i = 1; i < vc; i++)
+            {
+                lo = std::min(lo, vertex[i].position[c]);
+                hi = std::max(hi, vertex[i].position[c]);
+            }
+            h.origin[c] = lo;
+            h.step[c] = (hi - lo) / 65535.0f;
+        }
+
+        std::vector<std::vector<unsigned char>> plane(planes);
+        for(int k = 0; k < positionPlanes + normalPlanes; k++) plane[k].resize(vc);
+        for(int k = positionPlanes + normalPlanes; k < planes; k++) plane[k].resize(ic);
+
+        //位置は量子化した値の差を下位と上位のバイトに分ける
+        for(int c = 0; c < 3; c++)
+        {
+            std::uint16_t previous(0);
+            for(std::size_t i = 0; i < vc; i++)
+            {
+                const GLfloat u(h.step[c] > 0.0f ? (vertex[i].position[c] - h.origin[c]) / h.step[c] : 0.0f);
+                const std::uint16_t v(static_cast<std::uint16_t>(std::min(std::max(u + 0.5f, 0.0f), 65535.0f)));
+                const std::uint32_t z(zigzag(static_cast<std::int16_t>(static_cast<std::uint16_t>(v - previous))));
+                plane[c * 2][i] = static_cast<unsigned char>(z);
+                plane[c * 2 + 1][i] = static_cast<unsigned char>(z >> 8);
+                previous = v;
+            }
+        }
+
+        //法線は八面体に写して量子化した値の差を書く
+        std::int8_t previous[2] = {};
+        for(std::size_t i = 0; i < vc; i++)
+        {
+            const GLfloat *const n(vertex[i].normal);
+            const GLfloat l1(fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]));
+            GLfloat x(l1 > 0.0f ? n[0] / l1 : 0.0f), y(l1 > 0.0f ? n[1] / l1 : 0.0f);
+            if(n[2] < 0.0f)
+            {
+                const GLfloat fx((1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f));
+                const GLfloat fy((1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f));
+                x = fx;
+                y = fy;
+            }
+            const GLfloat e[] = { x, y };
+            for(int c = 0; c < 2; c++)
+            {
+                const std::int8_t v(static_cast<std::int8_t>(lrintf(e[c] * 127.0f)));
+                const std::uint32_t z(zigzag(static_cast<std::int8_t>(static_cast<std::uint8_t>(v - previous[c]))));
+                plane[positionPlanes + c][i] = static_cast<unsigned char>(z);
+                previous[c] = v;
+            }
+        }
+
+        //インデックスは前のインデックスとの差を四つのバイトに分ける
+        GLuint last(0);
+        for(std::size_t i = 0; i < ic; i++)
+        {
+            const std::uint32_t z(zigzag(static_cast<std::int32_t>(index[i] - last)));
+            for(int b = 0; b < indexPlanes; b++)
+                plane[positionPlanes + normalPlanes + b][i] = static_cast<unsigned char>(z >> (b * 8));
+            last = index[i];
+        }
+
+        std::vector<unsigned char> out;
+        put(out, h);
+        for(const std::vector<unsigned char> &p : plane) encodePlane(out, p);
+        return out;
+    }
+
+    //圧縮したデータの頂点とインデックスの数を調べる
+    static bool info(const unsigned char *data, std::size_t size, GLsizei &vertexcount, GLsizei &indexcount)
+    {
+        Header h;
+        if(size < sizeof h) return false;
+        memcpy(&h, data, sizeof h);
+        if(h.magic != magic) return false;
+        vertexcount = static_cast<GLsizei>(h.vertexcount);
+        indexcount = static_cast<GLsizei>(h.indexcount);
+        return true;
+    }
+
+    //復号する
+    //  data, size: 圧縮したデータ
+    //  vertex: 頂点属性の書き込み先（info() で調べた数だけ書き込める領域、マップしたバッファでもよい）
+    //  index: インデックスの書き込み先（NULL なら書き込まない）
+    //  pool: 面ごとの復号と頂点属性の展開を並列に処理するワーカースレッド（NULL ならこのスレッドで処理する）
+    //  戻り値: データが壊れていれば false
+    static bool decode(const unsigned char *data, std::size_t size, Object::Vertex *vertex, GLuint *index = NULL,
+                       ThreadPool *pool = NULL)
+    {
+        const unsigned char *p(data), *const end(data + size);
+        Header h;
+        if(!get(p, end, h) || h.magic != magic) return false;
+        const std::size_t vc(h.vertexcount), ic(h.indexcount);
+
+        //info() が GLsizei で返せない数は壊れている
+        if(vc > 0x7fffffff || ic > 0x7fffffff) return false;
+
+        //ワーカースレッドがあれば分けて処理する
+        const auto each([pool](std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &f)
+        {
+            if(pool != NULL) pool->parallelFor(count, grain, f);
+            else f(0, count);
+        });
+
+        //面の位置を調べ、ヘッダの数がそれぞれの面の大きさと合うか確かめる
+        const unsigned char *record[planes];
+        for(int k = 0; k < planes; k++)
+        {
+            record[k] = p;
+            if(!skipPlane(p, end, k < positionPlanes + normalPlanes ? vc : ic)) return false;
+        }
+
+        //空のデータは書き込むものがない（書き込み先は NULL かもしれない）
+        if(vc == 0 && ic == 0) return true;
+
+        //全ての面をバイトの列に戻す
+        std::vector<unsigned char> bytes(vc * (positionPlanes + normalPlanes) + ic * indexPlanes);
+        unsigned char *plane[planes];
+        std::size_t length[planes];
+        unsigned char *q(bytes.data());
+        for(int k = 0; k < planes; k++)
+        {
+            length[k] = k < positionPlanes + normalPlanes ? vc : ic;
+            plane[k] = q;
+            q += length[k];
+        }
+        std::atomic<bool> valid(true);
+        each(planes, 1, [&](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t k = begin; k < end; k++)
+                if(!decodePlane(record[k], length[k], plane[k])) valid = false;
+        });
+        if(!valid) return false;
+
+        //差を累積して量子化した値に戻す（成分ごとに並列に処理できる）
+        std::vector<std::uint16_t> quantized(vc * 3);
+        std::vector<std::int8_t> octahedron(vc * 2);
+        each(index != NULL ? 6 : 5, 1, [&](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t c = begin; c < end; c++)
+            {
+                if(c < 3) accumulate16(plane[c * 2], plane[c * 2 + 1], vc, quantized.data() + vc * c);
+                else if(c < 5) accumulate8(plane[positionPlanes + c - 3], vc, octahedron.data() + vc * (c - 3));
+                else accumulate32(plane + positionPlanes + normalPlanes, ic, index);
+            }
+        });
+
+        //頂点属性に直す
+        each(vc, 16384, [&](std::size_t begin, std::size_t end)
+        {
+            const std::uint16_t *const qp[] =
+                { quantized.data() + begin, quantized.data() + vc + begin, quantized.data() + vc * 2 + begin };
+            const std::int8_t *const op[] = { octahedron.data() + begin, octahedron.data() + vc + begin };
+            expand(h, qp, op, end - begin, vertex + begin);
+        });
+        return true;
+    }
+
+    //圧縮したデータをファイルに書き込む
+    static bool save(const char *name, const std::vector<unsigned char> &data)
+    {
+        std::ofstream file(name, std::ios::binary);
+        if(file.fail())
+        {
+            std::cerr << "Error: Can't open mesh file: " << name << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        return !file.fail();
+    }
+
+    //圧縮したデータをファイルから読み込む
+    static bool load(const char *name, std::vector<unsigned char> &data)
+    {
+        std::ifstream file(name, std::ios::binary);
+        if(file.fail())
+        {
+            std::cerr << "Error: Can't open mesh file: " << name << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+};
@@ -1,17 +1,14 @@
 #pragma once
+#include<cstring>
+#include<vector>
+#include<algorithm>
 #include<GL/glew.h>
 
+//GPU 資源の管理
+#include "GpuResources.h"
+
 //図形データ
 class Object{
-    // 頂点配列オブジェクト名
-    GLuint vao;
-    
-    // 頂点バッファオブジェクト名
-    GLuint vbo;
-    
-    // インデックスの頂点バッファオブジェクトc
-    GLuint ibo;
-    
 public:
     
     //頂点属性
@@ -23,48 +20,116 @@ public:
         GLfloat normal[3];
     };
     
+    //バッファオブジェクトの使い方
+    enum Usage{
+        Static,     //作成後はほとんど変更しない
+        Dynamic,    //時々変更する（全体の更新はバッファを作り直して待たずに転送する）
+        Stream      //毎フレーム変更する（複数の領域を順に使い、同期を取らずにマップして書き込む）
+    };
+    
+    //Stream のときに順に使う頂点バッファの領域の数（描画中のフレームの数の上限）
+    static constexpr int regions = 3;
+    
+private:
+    // 頂点配列オブジェクト（コンテキストごとに作る）
+    GpuResources::VertexArraySet vao;
+    
+    //頂点の位置の次元
+    const GLint size;
+    
+    // 頂点バッファオブジェクト
+    GpuResources::Buffer vbo;
+    
+    // インデックスの頂点バッファオブジェクト（インデックスがなければ持たない）
+    GpuResources::Buffer ibo;
+    
+    //バッファオブジェクトの使い方
+    const Usage usage;
+    
+    //頂点の数とインデックスの要素数
+    const GLsizei vertexcount, indexcount;
+    
+    //Stream のときに描画に使っている領域
+    int region;
+    
+    //Stream のときに各領域を最後に使った描画の完了を待つ同期オブジェクト
+    GLsync fence[regions];
+    
+    //Stream のときに各領域がまだ反映していない頂点の範囲 [first, last)
+    GLsizei dirtyFirst[regions], dirtyLast[regions];
+    
+    //Stream のときに次の領域に書き込む頂点属性の写し
+    std::vector<Vertex> shadow;
+    
+    //Stream のときに update() されてまだ領域に書き込んでいないか
+    bool pending;
+    
+public:
+    
     //コンストラクタ
     // size:頂点の位置の次元
     // vertexcount:頂点の数
     // vertex:頂点属性を格納した配列
     // indexcount: 頂点のインデックスの要素数
     // index: 頂点のインデックスを格納した配列
+    // usage: バッファオブジェクトの使い方
     Object(GLint size,GLsizei vertexcount,const Vertex *vertex,
-           GLsizei indexcount = 0, const GLuint *index = NULL)
+           GLsizei indexcount = 0, const GLuint *index = NULL, Usage usage = Static)
+    : vao("Object")
+    , size(size)
+    , usage(usage)
+    , vertexcount(vertexcount)
+    , indexcount(indexcount)
+    , region(0)
+    , pending(false)
     {
-        //頂点配列オブジェクト
-        glGenVertexArrays(1,&vao);
-        glBindVertexArray(vao);
+        GpuResources &resources(GpuResources::instance());
         
         //頂点バッファオブジェクト
-        glGenBuffers(1,&vbo);
-        glBindBuffer(GL_ARRAY_BUFFER,vbo);
-        glBufferData(GL_ARRAY_BUFFER,vertexcount * sizeof(Vertex),vertex,GL_STATIC_DRAW);
-        
-        //結合されている頂点バッファオブジェクトをin変数から参照できる様にする
-        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, sizeof(Vertex), static_cast<Vertex *>(0) -> position);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-            static_cast<Vertex *>(0) -> normal);
-        glEnableVertexAttribArray(1);
+        if(usage == Stream)
+        {
+            //領域の数だけ確保して全ての領域に同じ内容を入れておく
+            vbo = resources.acquireBuffer(regions * vertexcount * sizeof(Vertex), GL_STREAM_DRAW, NULL, "Object (vertex)");
+            glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+            if(vertex != NULL) shadow.assign(vertex, vertex + vertexcount);
+            else shadow.resize(vertexcount);
+            for(int i = 0; i < regions; i++)
+            {
+                glBufferSubData(GL_ARRAY_BUFFER, i * vertexcount * sizeof(Vertex),
+                                vertexcount * sizeof(Vertex), shadow.data());
+                fence[i] = 0;
+                dirtyFirst[i] = vertexcount;
+                dirtyLast[i] = 0;
+            }
+        }
+        else
+        {
+            vbo = resources.acquireBuffer(vertexcount * sizeof(Vertex),
+                                          usage == Dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW, vertex, "Object (vertex)");
+        }
         
         // インデックスの頂点バッファオブジェクト
-        glGenBuffers(1, &ibo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     indexcount * sizeof(GLuint), index, GL_STATIC_DRAW);
+        if(indexcount > 0)
+        {
+            ibo = resources.acquireBuffer(indexcount * sizeof(GLuint),
+                                          usage == Static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, index, "Object (index)");
+        }
+        
+        //このコンテキストの頂点配列オブジェクトを作っておく
+        vao.bind([this]{ setup(); });
     }
     
     //デストラクタ
     virtual ~Object(){
-        //頂点配列オブジェクトを削除する
-        glDeleteBuffers(1,&vao);
+        //同期オブジェクトを削除する
+        if(usage == Stream)
+        {
+            for(int i = 0; i < regions; i++)
+                if(fence[i] != 0) glDeleteSync(fence[i]);
+        }
         
-        //頂点バッファオブジェクトを削除する
-        glDeleteBuffers(1,&vbo);
-        
-        // インデックスの頂点バッファオブジェクトを削除する
-        glDeleteBuffers(1, &ibo);
+        //頂点配列オブジェクトとバッファオブジェクトはハンドルが破棄されるときに返却され、
+        //このフレームの描画が終わってから使い回される
     }
     
 private:
@@ -73,10 +138,160 @@ private:
     //代入によるコピー禁止
     Object &operator = (const Object &o);
     
+    //結合されている頂点配列オブジェクトにバッファオブジェクトを結び付ける
+    void setup(){
+        //結合されている頂点バッファオブジェクトをin変数から参照できる様にする
+        glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, sizeof(Vertex), static_cast<Vertex *>(0) -> position);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            static_cast<Vertex *>(0) -> normal);
+        glEnableVertexAttribArray(1);
+        
+        // インデックスの頂点バッファオブジェクト
+        if(ibo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo.get());
+    }
+    
+    //Stream のときに次の領域に切り替えて変更された頂点を書き込む
+    void commit(){
+        //今の領域はここまでの描画が終われば書き換えられる
+        if(fence[region] != 0) glDeleteSync(fence[region]);
+        fence[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        //次の領域を使う描画が終わるのを待つ（普通は数フレーム前に終わっている）
+        region = (region + 1) % regions;
+        if(fence[region] != 0)
+        {
+            while(glClientWaitSync(fence[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(fence[region]);
+            fence[region] = 0;
+        }
+        
+        //この領域がまだ反映していない範囲だけを同期を取らずにマップして書き込む
+        const GLsizei first(dirtyFirst[region]), last(dirtyLast[region]);
+        if(first < last)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+            void *const p(glMapBufferRange(GL_ARRAY_BUFFER,
+                (region * vertexcount + first) * sizeof(Vertex), (last - first) * sizeof(Vertex),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+            if(p != NULL)
+            {
+                memcpy(p, shadow.data() + first, (last - first) * sizeof(Vertex));
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            dirtyFirst[region] = vertexcount;
+            dirtyLast[region] = 0;
+        }
+        pending = false;
+    }
+    
 public:
+    //頂点属性の一部を更新する
+    // first: 更新する最初の頂点の番号
+    // count: 更新する頂点の数
+    // vertex: 頂点属性を格納した配列
+    void update(GLint first, GLsizei count, const Vertex *vertex){
+        //範囲外なら何もしない
+        if(first < 0 || count <= 0 || first + count > vertexcount) return;
+        
+        switch(usage)
+        {
+            case Stream:
+                //写しを更新して次に描画するときに空いている領域に書き込む
+                std::copy(vertex, vertex + count, shadow.begin() + first);
+                for(int i = 0; i < regions; i++)
+                {
+                    dirtyFirst[i] = std::min(dirtyFirst[i], static_cast<GLsizei>(first));
+                    dirtyLast[i] = std::max(dirtyLast[i], first + count);
+                }
+                pending = true;
+                break;
+            
+            case Dynamic:
+                glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+                
+                //全体を更新するときは新しい記憶領域に切り替えて描画中のデータを待たない
+                if(first == 0 && count == vertexcount)
+                    glBufferData(GL_ARRAY_BUFFER, vbo.size(), NULL, GL_DYNAMIC_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), vertex);
+                break;
+            
+            default:
+                glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+                glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), vertex);
+                break;
+        }
+    }
+    
+    //インデックスの一部を更新する
+    // first: 更新する最初のインデックスの番号
+    // count: 更新するインデックスの数
+    // index: インデックスを格納した配列
+    void updateIndex(GLint first, GLsizei count, const GLuint *index){
+        //範囲外なら何もしない
+        if(first < 0 || count <= 0 || first + count > indexcount) return;
+        
+        //頂点配列オブジェクトの記録を変えないように頂点配列オブジェクトが参照しない結合ポイントを使う
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ibo.get());
+        
+        //全体を更新するときは新しい記憶領域に切り替えて描画中のデータを待たない
+        if(usage != Static && first == 0 && count == indexcount)
+            glBufferData(GL_COPY_WRITE_BUFFER, ibo.size(), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, first * sizeof(GLuint), count * sizeof(GLuint), index);
+    }
+    
+    //頂点属性とインデックスの全体をバッファオブジェクトに直接書き込む
+    // f: 書き込み先の頂点属性の配列とインデックスの配列（なければ NULL）を受け取って書き込む関数 f(Vertex *, GLuint *)
+    //    書き込めなかったときは false を返す
+    template<typename F>
+    bool fill(F f){
+        //頂点配列オブジェクトの記録を変えないように頂点配列オブジェクトが参照しない結合ポイントを使う
+        GLuint *index(NULL);
+        if(indexcount > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, ibo.get());
+            index = static_cast<GLuint *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, indexcount * sizeof(GLuint),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+            if(index == NULL) return false;
+        }
+        
+        bool written;
+        if(usage == Stream)
+        {
+            //Stream のときは写しに書き込んで全ての領域に反映する
+            written = f(shadow.data(), index);
+            for(int i = 0; i < regions; i++)
+            {
+                dirtyFirst[i] = 0;
+                dirtyLast[i] = vertexcount;
+            }
+            pending = true;
+        }
+        else
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo.get());
+            Vertex *const vertex(static_cast<Vertex *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+                vertexcount * sizeof(Vertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT)));
+            written = vertex != NULL && f(vertex, index);
+            if(vertex != NULL && glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_FALSE) written = false;
+        }
+        
+        if(index != NULL && glUnmapBuffer(GL_COPY_READ_BUFFER) == GL_FALSE) written = false;
+        return written;
+    }
+    
     //頂点オブジェクトの統合
-    void bind() const{
-        //描画する頂点配列オブジェクトを指定する
-        glBindVertexArray(vao);
+    void bind(){
+        //更新された頂点を次の領域に書き込む
+        if(pending) commit();
+        
+        //描画する頂点配列オブジェクトを指定する（初めて描画するコンテキストでは作って設定する）
+        vao.bind([this]{ setup(); });
+    }
+    
+    //描画に使う最初の頂点の番号（Stream のときは使っている領域の先頭）
+    GLint base() const{
+        return usage == Stream ? region * vertexcount : 0;
     }
 };
@@ -0,0 +1,323 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+
+//シェーダの読み込み
+#include "Program.h"
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+//GPU 資源の管理
+#include "GpuResources.h"
+
+/*
+ パーティクルシステム
+
+ パーティクルの位置・速度・残り寿命を要素ごとの配列 (SoA) で持ち、
+ 更新は SSE で四つずつ、配列を塊に分けてワーカースレッドで並列に行う
+ 寿命が尽きたものは最後のものと入れ替えて詰めるので配列を確保し直すことはない
+ 生きているものだけを毎フレーム作り直したバッファに書き込み、
+ インスタンシングでビルボードとして一度に描画する
+*/
+class ParticleSystem
+{
+    //確保しているパーティクルの数
+    const GLsizei capacity;
+
+    //生きているパーティクルの数
+    GLsizei count;
+
+    //位置、速度、残り寿命（秒）
+    std::vector<GLfloat> px, py, pz, vx, vy, vz, life;
+
+    //パーティクルの寿命（秒）
+    const GLfloat lifetime;
+
+    //放出の乱数の状態
+    unsigned int seed;
+
+    //並列に処理するワーカースレッド
+    ThreadPool &pool;
+
+    //一つのスレッドが一度に処理するパーティクルの数
+    static constexpr std::size_t grain = 16384;
+
+    //ビルボードの頂点配列オブジェクト、四隅の頂点バッファ、パーティクルのバッファ
+    GpuResources::VertexArraySet vao;
+    GpuResources::Buffer corner, instance;
+
+    //ビルボードを描くプログラムオブジェクトと uniform 変数の場所
+    const GLuint program;
+    const GLint modelviewLoc, projectionLoc, sizeLoc, lifetimeLoc, colorLoc;
+
+    //パーティクルごとの位置と残り寿命の attribute 変数の場所
+    const GLint particleLoc;
+
+    // 0〜1 の乱数
+    GLfloat nextRandom()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<GLfloat>(seed >> 8) / static_cast<GLfloat>(1u << 24);
+    }
+
+    //結合されている頂点配列オブジェクトにバッファオブジェクトを結び付ける
+    void setup()
+    {
+        //ビルボードの四隅（position は loadProgram() で 0 番に結合されている）
+        glBindBuffer(GL_ARRAY_BUFFER, corner.get());
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+
+        //パーティクルごとの位置と残り寿命（インスタンスごとに一つ進める）
+        glBindBuffer(GL_ARRAY_BUFFER, instance.get());
+        if(particleLoc >= 0)
+        {
+            glVertexAttribPointer(particleLoc, 4, GL_FLOAT, GL_FALSE, 0, 0);
+            glEnableVertexAttribArray(particleLoc);
+            glVertexAttribDivisor(particleLoc, 1);
+        }
+    }
+
+    //[begin, end) のパーティクルを dt 秒進める
+    void advance(std::size_t begin, std::size_t end, GLfloat dt, const GLfloat *gravity)
+    {
+        std::size_t i(begin);
+
+#if defined(__SSE__)
+        const __m128 t(_mm_set1_ps(dt));
+        const __m128 gx(_mm_set1_ps(gravity[0] * dt));
+        const __m128 gy(_mm_set1_ps(gravity[1] * dt));
+        const __m128 gz(_mm_set1_ps(gravity[2] * dt));
+
+        for(; i + 4 <= end; i += 4)
+        {
+            // v += g dt, p += v dt, life -= dt
+            const __m128 x(_mm_add_ps(_mm_loadu_ps(&vx[i]), gx));
+            const __m128 y(_mm_add_ps(_mm_loadu_ps(&vy[i]), gy));
+            const __m128 z(_mm_add_ps(_mm_loadu_ps(&vz[i]), gz));
+            _mm_storeu_ps(&vx[i], x);
+            _mm_storeu_ps(&vy[i], y);
+            _mm_storeu_ps(&vz[i], z);
+            _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(x, t)));
+            _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(y, t)));
+            _mm_storeu_ps(&pz[i], _mm_add_ps(_mm_loadu_ps(&pz[i]), _mm_mul_ps(z, t)));
+            _mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), t));
+        }
+#endif
+
+        //残り（SSE が使えないときは全て）は一つずつ進める
+        for(; i < end; i++)
+        {
+            vx[i] += gravity[0] * dt;
+            vy[i] += gravity[1] * dt;
+            vz[i] += gravity[2] * dt;
+            px[i] += vx[i] * dt;
+            py[i] += vy[i] * dt;
+            pz[i] += vz[i] * dt;
+            life[i] -= dt;
+        }
+    }
+
+    //[begin, end) のパーティクルを (x, y, z, 残り寿命) の並びで書き込む
+    void pack(std::size_t begin, std::size_t end, GLfloat *buffer) const
+    {
+        std::size_t i(begin);
+
+#if defined(__SSE__)
+        for(; i + 4 <= end; i += 4)
+        {
+            //要素ごとの並びを四つのパーティクルの並びに並べ替える
+            __m128 x(_mm_loadu_ps(&px[i])), y(_mm_loadu_ps(&py[i]));
+            __m128 z(_mm_loadu_ps(&pz[i])), w(_mm_loadu_ps(&life[i]));
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(buffer + i * 4, x);
+            _mm_storeu_ps(buffer + i * 4 + 4, y);
+            _mm_storeu_ps(buffer + i * 4 + 8, z);
+            _mm_storeu_ps(buffer + i * 4 + 12, w);
+        }
+#endif
+
+        for(; i < end; i++)
+        {
+            buffer[i * 4] = px[i];
+            buffer[i * 4 + 1] = py[i];
+            buffer[i * 4 + 2] = pz[i];
+            buffer[i * 4 + 3] = life[i];
+        }
+    }
+
+    //i 番目のパーティクルに j 番目のパーティクルを写す
+    void move(GLsizei i, GLsizei j)
+    {
+        px[i] = px[j]; py[i] = py[j]; pz[i] = pz[j];
+        vx[i] = vx[j]; vy[i] = vy[j]; vz[i] = vz[j];
+        life[i] = life[j];
+    }
+
+    //寿命が尽きたパーティクルを最後のパーティクルと入れ替えて詰める
+    void compact()
+    {
+        GLsizei i(0);
+
+        while(i < count)
+        {
+#if defined(__SSE__)
+            //四つとも生きていれば飛ばす
+            if(i + 4 <= count
+               && _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&life[i]), _mm_setzero_ps())) == 0)
+            {
+                i += 4;
+                continue;
+            }
+#endif
+            if(life[i] > 0.0f) ++i;
+            else move(i, --count);
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  capacity: パーティクルの最大数
+    //  lifetime: パーティクルの寿命（秒）
+    //  pool: 更新を並列に処理するワーカースレッド
+    //  vsrc, fsrc: 読み込んでおいたシェーダのソース（NULL なら particle.vert と particle.frag を読み込む）
+    ParticleSystem(GLsizei capacity, GLfloat lifetime, ThreadPool &pool,
+                   const GLchar *vsrc = NULL, const GLchar *fsrc = NULL)
+    : capacity(capacity), count(0)
+    , px(capacity), py(capacity), pz(capacity)
+    , vx(capacity), vy(capacity), vz(capacity)
+    , life(capacity)
+    , lifetime(lifetime)
+    , seed(1u)
+    , pool(pool)
+    , vao("ParticleSystem")
+    , program(vsrc != NULL && fsrc != NULL ? createProgram(vsrc, fsrc) : loadProgram("particle.vert", "particle.frag"))
+    , modelviewLoc(glGetUniformLocation(program, "modelview"))
+    , projectionLoc(glGetUniformLocation(program, "projection"))
+    , sizeLoc(glGetUniformLocation(program, "size"))
+    , lifetimeLoc(glGetUniformLocation(program, "lifetime"))
+    , colorLoc(glGetUniformLocation(program, "color"))
+    , particleLoc(glGetAttribLocation(program, "particle"))
+    {
+        GpuResources &resources(GpuResources::instance());
+
+        //ビルボードの四隅
+        static const GLfloat quad[] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+        corner = resources.acquireBuffer(sizeof quad, GL_STATIC_DRAW, quad, "ParticleSystem");
+
+        //パーティクルごとの位置と残り寿命
+        instance = resources.acquireBuffer(capacity * 4 * sizeof (GLfloat), GL_STREAM_DRAW, NULL, "ParticleSystem");
+
+        //このコンテキストの頂点配列オブジェクトを作っておく
+        vao.bind([this]{ setup(); });
+    }
+
+    //デストラクタ
+    virtual ~ParticleSystem()
+    {
+        GpuMemory::instance().release(GpuMemory::Program, program);
+        glDeleteProgram(program);
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    ParticleSystem(const ParticleSystem &p);
+    //代入によるコピー禁止
+    ParticleSystem &operator = (const ParticleSystem &p);
+
+public:
+
+    //生きているパーティクルの数
+    GLsizei size() const { return count; }
+
+    //全てのパーティクルを消して乱数の種を作ったときに戻す（同じ放出で同じパーティクルを作り直す）
+    void reset()
+    {
+        count = 0;
+        seed = 1u;
+    }
+
+    //パーティクルを放出する（空きがなければ放出しない）
+    //  n: 放出する数
+    //  origin: 放出する位置
+    //  speed: 初速の大きさ
+    //  spread: 上向きからの広がり（0 なら真上、1 なら水平まで）
+    void emit(GLsizei n, const GLfloat *origin, GLfloat speed, GLfloat spread)
+    {
+        n = std::min(n, capacity - count);
+        for(GLsizei i = count; i < count + n; i++)
+        {
+            const GLfloat a(6.283185f * nextRandom());
+            const GLfloat r(spread * nextRandom());
+            const GLfloat s(speed * (0.8f + 0.4f * nextRandom()));
+            px[i] = origin[0];
+            py[i] = origin[1];
+            pz[i] = origin[2];
+            vx[i] = s * r * cosf(a);
+            vy[i] = s * sqrtf(std::max(1.0f - r * r, 0.0f));
+            vz[i] = s * r * sinf(a);
+            life[i] = lifetime * (0.5f + 0.5f * nextRandom());
+        }
+        count += n;
+    }
+
+    //全てのパーティクルを dt 秒進めて寿命が尽きたものを取り除く
+    //  dt: 進める時間（秒）
+    //  gravity: 重力加速度
+    void update(GLfloat dt, const GLfloat *gravity)
+    {
+        pool.parallelFor(count, grain, [this, dt, gravity](std::size_t begin, std::size_t end)
+        {
+            advance(begin, end, dt, gravity);
+        });
+        compact();
+    }
+
+    //生きているパーティクルをバッファに転送する
+    void upload()
+    {
+        if(count == 0) return;
+        glBindBuffer(GL_ARRAY_BUFFER, instance.get());
+
+        //新しい記憶領域に切り替え、描画中のデータを待たずに同期を取らずにマップする
+        glBufferData(GL_ARRAY_BUFFER, instance.size(), NULL, GL_STREAM_DRAW);
+        GLfloat *const buffer(static_cast<GLfloat *>(glMapBufferRange(GL_ARRAY_BUFFER, 0,
+            count * 4 * sizeof (GLfloat),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT)));
+        if(buffer == NULL) return;
+
+        //マップした領域にワーカースレッドで直接書き込む
+        pool.parallelFor(count, grain, [this, buffer](std::size_t begin, std::size_t end)
+        {
+            pack(begin, end, buffer);
+        });
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    //生きているパーティクルを一度に描画する
+    //  projection: 投影変換行列
+    //  modelview: モデルビュー変換行列
+    //  size: ビルボードの半径
+    //  color: パーティクルの色
+    void draw(const GLfloat *projection, const GLfloat *modelview, GLfloat size, const GLfloat *color)
+    {
+        if(count == 0) return;
+
+        glUseProgram(program);
+        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
+        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, modelview);
+        glUniform1f(sizeLoc, size);
+        glUniform1f(lifetimeLoc, lifetime);
+        glUniform3fv(colorLoc, 1, color);
+
+        vao.bind([this]{ setup(); });
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+    }
+};
@@ -0,0 +1,586 @@
+#pragma once
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+
+//変換行列
+#include "Matrix.h"
+
+//アフィン変換行列
+#include "Transform.h"
+
+//図形データ
+#include "Object.h"
+
+/*
+ 光線による図形の選択
+
+ マウスカーソルの位置を (投影変換行列 × ビュー変換行列) の逆行列で光線に戻し、
+ 図形の境界ボックスの BVH をたどって候補の図形を絞り込んでから、
+ 図形ごとの三角形の BVH（最初に選択したときに作る）をたどって
+ 葉にある四つの三角形と光線の交差を SSE で同時に調べる
+*/
+
+// 光線
+struct Ray
+{
+    //始点
+    GLfloat origin[3];
+
+    //方向
+    GLfloat direction[3];
+};
+
+// マウスカーソルの位置を光線に戻す
+//  projection: 投影変換行列
+//  view: ビュー変換行列
+//  x, y: 正規化デバイス座標系上のマウスカーソルの位置
+//  戻り値: 前方面から後方面に向かうワールド座標系の光線（方向は単位ベクトル）
+inline Ray unproject(const Matrix &projection, const Matrix &view, GLfloat x, GLfloat y)
+{
+    const Matrix inverse((projection * view).inverse());
+    const Vector n(inverse * Vector{ x, y, -1.0f, 1.0f });
+    const Vector f(inverse * Vector{ x, y, 1.0f, 1.0f });
+
+    Ray ray;
+    GLfloat d(0.0f);
+    for(int i = 0; i < 3; i++)
+    {
+        ray.origin[i] = n[i] / n[3];
+        ray.direction[i] = f[i] / f[3] - ray.origin[i];
+        d += ray.direction[i] * ray.direction[i];
+    }
+    d = d > 0.0f ? 1.0f / sqrt(d) : 0.0f;
+    for(int i = 0; i < 3; i++) ray.direction[i] *= d;
+
+    return ray;
+}
+
+// 軸に平行な境界ボックス
+struct Bounds
+{
+    //最小の座標と最大の座標
+    GLfloat lo[3], hi[3];
+
+    //コンストラクタ（空のボックス）
+    Bounds()
+    : lo{  std::numeric_limits<GLfloat>::max(),  std::numeric_limits<GLfloat>::max(),  std::numeric_limits<GLfloat>::max() }
+    , hi{ -std::numeric_limits<GLfloat>::max(), -std::numeric_limits<GLfloat>::max(), -std::numeric_limits<GLfloat>::max() }
+    {
+    }
+
+    //点を含むように広げる
+    void extend(const GLfloat *p)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            lo[i] = std::min(lo[i], p[i]);
+            hi[i] = std::max(hi[i], p[i]);
+        }
+    }
+
+    //ボックスを含むように広げる
+    void extend(const Bounds &b)
+    {
+        extend(b.lo);
+        extend(b.hi);
+    }
+
+    //中心の座標
+    GLfloat center(int axis) const { return (lo[axis] + hi[axis]) * 0.5f; }
+
+    //アフィン変換したボックスを含むボックス
+    Bounds transform(const Transform &m) const
+    {
+        Bounds b;
+        for(int c = 0; c < 8; c++)
+        {
+            const Vector p(m * Vector{ c & 1 ? hi[0] : lo[0], c & 2 ? hi[1] : lo[1], c & 4 ? hi[2] : lo[2], 1.0f });
+            b.extend(p.data());
+        }
+        return b;
+    }
+
+    //光線と交差するか調べる
+    //  origin: 光線の始点
+    //  inverse: 光線の方向の逆数
+    //  tmax: これより遠い交差は調べない
+    //  tnear: 光線がボックスに入る位置の格納先
+    bool intersect(const GLfloat *origin, const GLfloat *inverse, GLfloat tmax, GLfloat &tnear) const
+    {
+        GLfloat t0(0.0f), t1(tmax);
+        for(int i = 0; i < 3; i++)
+        {
+            GLfloat a((lo[i] - origin[i]) * inverse[i]);
+            GLfloat b((hi[i] - origin[i]) * inverse[i]);
+            if(a > b) std::swap(a, b);
+            t0 = std::max(t0, a);
+            t1 = std::min(t1, b);
+            if(t0 > t1) return false;
+        }
+        tnear = t0;
+        return true;
+    }
+};
+
+// 境界ボックスの木 (bounding volume hierarchy)
+class BoundingVolumeHierarchy
+{
+public:
+
+    //木の節
+    struct Node
+    {
+        //この節以下の要素を含むボックス
+        Bounds bounds;
+
+        //葉なら order の最初の位置、内部の節なら子の節の番号（二つ続けて置く）
+        GLuint first;
+
+        //葉の要素の数（内部の節なら0）
+        GLuint count;
+    };
+
+    //節（0 番が根）
+    std::vector<Node> nodes;
+
+    //葉の順に並べた要素の番号
+    std::vector<GLuint> order;
+
+    //木を作る
+    //  items: 要素の境界ボックス
+    //  leafSize: 葉に入れる要素の数の上限
+    void build(const std::vector<Bounds> &items, GLuint leafSize)
+    {
+        nodes.clear();
+        order.resize(items.size());
+        for(GLuint i = 0; i < order.size(); i++) order[i] = i;
+        if(items.empty()) return;
+
+        //節と受け持つ範囲の組を積んで順に分割する
+        struct Range { GLuint node, begin, end; };
+        std::vector<Range> stack;
+        nodes.push_back(Node());
+        stack.push_back(Range{ 0, 0, static_cast<GLuint>(items.size()) });
+
+        while(!stack.empty())
+        {
+            const Range r(stack.back());
+            stack.pop_back();
+
+            //範囲の要素を含むボックスと中心を含むボックス
+            Bounds bounds, centers;
+            for(GLuint i = r.begin; i < r.end; i++)
+            {
+                const Bounds &b(items[order[i]]);
+                const GLfloat c[] = { b.center(0), b.center(1), b.center(2) };
+                bounds.extend(b);
+                centers.extend(c);
+            }
+            nodes[r.node].bounds = bounds;
+
+            //少なければ葉にする
+            if(r.end - r.begin <= leafSize)
+            {
+                nodes[r.node].first = r.begin;
+                nodes[r.node].count = r.end - r.begin;
+                continue;
+            }
+
+            //中心の広がりが一番大きい軸で要素の数が半分になるように分ける
+            int axis(0);
+            for(int i = 1; i < 3; i++)
+                if(centers.hi[i] - centers.lo[i] > centers.hi[axis] - centers.lo[axis]) axis = i;
+            const GLuint middle((r.begin + r.end) / 2);
+            std::nth_element(order.begin() + r.begin, order.begin() + middle, order.begin() + r.end,
+                [&items, axis](GLuint a, GLuint b){ return items[a].center(axis) < items[b].center(axis); });
+
+            const GLuint child(static_cast<GLuint>(nodes.size()));
+            nodes[r.node].first = child;
+            nodes[r.node].count = 0;
+            nodes.push_back(Node());
+            nodes.push_back(Node());
+            stack.push_back(Range{ child, r.begin, middle });
+            stack.push_back(Range{ child + 1, middle, r.end });
+        }
+    }
+
+    //光線が通る葉を近い順にたどる
+    //  ray: 光線
+    //  tmax: これより遠い交差は調べない（leaf が近い交差を見つけたら縮める）
+    //  leaf: 葉の節を調べる関数 leaf(node, tmax)
+    template <typename F>
+    void traverse(const Ray &ray, GLfloat &tmax, F leaf) const
+    {
+        if(nodes.empty()) return;
+
+        const GLfloat inverse[] = { 1.0f / ray.direction[0], 1.0f / ray.direction[1], 1.0f / ray.direction[2] };
+        GLfloat t;
+        if(!nodes[0].bounds.intersect(ray.origin, inverse, tmax, t)) return;
+
+        GLuint stack[64];
+        int top(0);
+        stack[top++] = 0;
+
+        while(top > 0)
+        {
+            const Node &n(nodes[stack[--top]]);
+
+            if(n.count > 0)
+            {
+                leaf(n, tmax);
+                continue;
+            }
+
+            //子のボックスと交差するものを近いほうが先に取り出されるように積む
+            GLfloat ta, tb;
+            const bool a(nodes[n.first].bounds.intersect(ray.origin, inverse, tmax, ta));
+            const bool b(nodes[n.first + 1].bounds.intersect(ray.origin, inverse, tmax, tb));
+            if(a && b)
+            {
+                if(ta < tb)
+                {
+                    stack[top++] = n.first + 1;
+                    stack[top++] = n.first;
+                }
+                else
+                {
+                    stack[top++] = n.first;
+                    stack[top++] = n.first + 1;
+                }
+            }
+            else if(a) stack[top++] = n.first;
+            else if(b) stack[top++] = n.first + 1;
+        }
+    }
+};
+
+// 選択に使う図形の形状
+class PickMesh
+{
+    //葉の四つの三角形（頂点と二辺を要素ごとに並べる）
+    struct alignas(16) Block
+    {
+        //一つ目の頂点、一つ目の頂点からの二辺
+        GLfloat v0[3][4], e1[3][4], e2[3][4];
+
+        //三角形の番号
+        GLuint triangle[4];
+    };
+
+    //頂点の位置
+    std::vector<GLfloat> position;
+
+    //三角形の頂点のインデックス
+    std::vector<GLuint> index;
+
+    //形状を含むボックス
+    Bounds bounds;
+
+    //三角形の BVH と葉ごとの三角形（最初に選択したときに作る）
+    BoundingVolumeHierarchy bvh;
+    std::vector<Block> blocks;
+    bool built;
+
+    //三角形の BVH を作る
+    void build()
+    {
+        //三角形ごとの境界ボックス
+        const GLuint triangles(static_cast<GLuint>(index.size() / 3));
+        std::vector<Bounds> items(triangles);
+        for(GLuint i = 0; i < triangles; i++)
+            for(int k = 0; k < 3; k++) items[i].extend(&position[index[i * 3 + k] * 3]);
+        bvh.build(items, 4);
+
+        //葉ごとに四つの三角形を一つのブロックにまとめ、葉の first をブロックの番号に置き換える
+        blocks.clear();
+        for(BoundingVolumeHierarchy::Node &n : bvh.nodes)
+        {
+            if(n.count == 0) continue;
+
+            Block b = {};
+            for(GLuint lane = 0; lane < 4; lane++)
+            {
+                //足りない分は面積 0 の三角形にして交差しないようにする
+                if(lane >= n.count)
+                {
+                    b.triangle[lane] = ~0u;
+                    continue;
+                }
+                const GLuint t(bvh.order[n.first + lane]);
+                const GLfloat *const p0(&position[index[t * 3] * 3]);
+                const GLfloat *const p1(&position[index[t * 3 + 1] * 3]);
+                const GLfloat *const p2(&position[index[t * 3 + 2] * 3]);
+                for(int i = 0; i < 3; i++)
+                {
+                    b.v0[i][lane] = p0[i];
+                    b.e1[i][lane] = p1[i] - p0[i];
+                    b.e2[i][lane] = p2[i] - p0[i];
+                }
+                b.triangle[lane] = t;
+            }
+            n.first = static_cast<GLuint>(blocks.size());
+            blocks.push_back(b);
+        }
+        built = true;
+    }
+
+    //光線と四つの三角形の交差を調べる (Möller-Trumbore)
+    //  ray: 光線
+    //  b: 四つの三角形
+    //  tmax: これより近い交差があれば縮める
+    //  triangle: 一番近い交差した三角形の番号の格納先
+    static void intersect(const Ray &ray, const Block &b, GLfloat &tmax, GLuint &triangle)
+    {
+#if defined(__SSE__)
+        const __m128 dx(_mm_set1_ps(ray.direction[0])), dy(_mm_set1_ps(ray.direction[1])), dz(_mm_set1_ps(ray.direction[2]));
+        const __m128 e1x(_mm_load_ps(b.e1[0])), e1y(_mm_load_ps(b.e1[1])), e1z(_mm_load_ps(b.e1[2]));
+        const __m128 e2x(_mm_load_ps(b.e2[0])), e2y(_mm_load_ps(b.e2[1])), e2z(_mm_load_ps(b.e2[2]));
+
+        // p = d × e2, det = e1・p
+        const __m128 px(_mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y)));
+        const __m128 py(_mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z)));
+        const __m128 pz(_mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x)));
+        const __m128 det(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz)));
+        const __m128 r(_mm_div_ps(_mm_set1_ps(1.0f), det));
+
+        // s = o - v0, u = (s・p) / det
+        const __m128 sx(_mm_sub_ps(_mm_set1_ps(ray.origin[0]), _mm_load_ps(b.v0[0])));
+        const __m128 sy(_mm_sub_ps(_mm_set1_ps(ray.origin[1]), _mm_load_ps(b.v0[1])));
+        const __m128 sz(_mm_sub_ps(_mm_set1_ps(ray.origin[2]), _mm_load_ps(b.v0[2])));
+        const __m128 u(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), r));
+
+        // q = s × e1, v = (d・q) / det, t = (e2・q) / det
+        const __m128 qx(_mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y)));
+        const __m128 qy(_mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z)));
+        const __m128 qz(_mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x)));
+        const __m128 v(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), r));
+        const __m128 t(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), r));
+
+        //三角形の内側で tmax より近いものだけを残す（det が 0 なら u, v, t は比較に失敗する）
+        const __m128 zero(_mm_setzero_ps());
+        __m128 hit(_mm_cmpneq_ps(det, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, zero));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(tmax)));
+
+        const int mask(_mm_movemask_ps(hit));
+        if(mask == 0) return;
+
+        alignas(16) GLfloat distance[4];
+        _mm_store_ps(distance, t);
+        for(int lane = 0; lane < 4; lane++)
+        {
+            if((mask & (1 << lane)) && distance[lane] < tmax)
+            {
+                tmax = distance[lane];
+                triangle = b.triangle[lane];
+            }
+        }
+#else
+        for(int lane = 0; lane < 4; lane++)
+        {
+            const GLfloat *const d(ray.direction);
+            const GLfloat p[] =
+            {
+                d[1] * b.e2[2][lane] - d[2] * b.e2[1][lane],
+                d[2] * b.e2[0][lane] - d[0] * b.e2[2][lane],
+                d[0] * b.e2[1][lane] - d[1] * b.e2[0][lane]
+            };
+            const GLfloat det(b.e1[0][lane] * p[0] + b.e1[1][lane] * p[1] + b.e1[2][lane] * p[2]);
+            if(det == 0.0f) continue;
+            const GLfloat r(1.0f / det);
+            const GLfloat s[] =
+            {
+                ray.origin[0] - b.v0[0][lane], ray.origin[1] - b.v0[1][lane], ray.origin[2] - b.v0[2][lane]
+            };
+            const GLfloat u((s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * r);
+            if(u < 0.0f || u > 1.0f) continue;
+            const GLfloat q[] =
+            {
+                s[1] * b.e1[2][lane] - s[2] * b.e1[1][lane],
+                s[2] * b.e1[0][lane] - s[0] * b.e1[2][lane],
+                s[0] * b.e1[1][lane] - s[1] * b.e1[0][lane]
+            };
+            const GLfloat v((d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * r);
+            if(v < 0.0f || u + v > 1.0f) continue;
+            const GLfloat t((b.e2[0][lane] * q[0] + b.e2[1][lane] * q[1] + b.e2[2][lane] * q[2]) * r);
+            if(t > 0.0f && t < tmax)
+            {
+                tmax = t;
+                triangle = b.triangle[lane];
+            }
+        }
+#endif
+    }
+
+public:
+
+    //コンストラクタ
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 頂点のインデックスの要素数（0 なら頂点を三つずつ三角形にする）
+    //  index: 頂点のインデックスを格納した配列
+    PickMesh(GLsizei vertexcount, const Object::Vertex *vertex,
+             GLsizei indexcount = 0, const GLuint *index = NULL)
+    : built(false)
+    {
+        position.reserve(vertexcount * 3);
+        for(GLsizei i = 0; i < vertexcount; i++)
+        {
+            position.insert(position.end(), vertex[i].position, vertex[i].position + 3);
+            bounds.extend(vertex[i].position);
+        }
+
+        if(indexcount > 0) this->index.assign(index, index + indexcount - indexcount % 3);
+        else for(GLsizei i = 0; i < vertexcount; i++) this->index.push_back(i);
+        this->index.resize(this->index.size() - this->index.size() % 3);
+    }
+
+    //形状を含むボックス
+    const Bounds &getBounds() const { return bounds; }
+
+    //三角形の数
+    GLsizei size() const { return static_cast<GLsizei>(index.size() / 3); }
+
+    //光線と交差する一番近い三角形を求める
+    //  ray: 図形の座標系の光線
+    //  tmax: これより遠い交差は調べない（交差が見つかればその位置に縮める）
+    //  triangle: 交差した三角形の番号の格納先
+    //  戻り値: tmax より近い交差が見つかれば true
+    bool intersect(const Ray &ray, GLfloat &tmax, GLuint &triangle)
+    {
+        if(!built) build();
+
+        const GLfloat start(tmax);
+        bvh.traverse(ray, tmax, [this, &ray, &triangle](const BoundingVolumeHierarchy::Node &n, GLfloat &t)
+        {
+            intersect(ray, blocks[n.first], t, triangle);
+        });
+        return tmax < start;
+    }
+};
+
+// 図形の選択
+class Picker
+{
+    //配置した図形
+    struct Instance
+    {
+        //形状
+        std::shared_ptr<PickMesh> mesh;
+
+        //モデル変換行列とその逆行列
+        Transform model, inverse;
+
+        //ワールド座標系での境界ボックス
+        Bounds bounds;
+    };
+
+    //配置した図形
+    std::vector<Instance> instances;
+
+    //図形の境界ボックスの BVH
+    BoundingVolumeHierarchy bvh;
+
+    //図形を追加したり動かしたりして BVH を作り直す必要があるか
+    bool dirty;
+
+public:
+
+    //選択の結果
+    struct Hit
+    {
+        //図形の番号
+        int object;
+
+        //三角形の番号
+        GLuint triangle;
+
+        //光線の始点からの距離
+        GLfloat distance;
+
+        //交差した位置（ワールド座標系）
+        GLfloat position[3];
+    };
+
+    //コンストラクタ
+    Picker()
+    : dirty(false)
+    {
+    }
+
+    //図形を追加する
+    //  mesh: 形状（同じ形状を複数の図形で共有できる）
+    //  model: モデル変換行列
+    //  戻り値: 図形の番号
+    int add(const std::shared_ptr<PickMesh> &mesh, const Transform &model = Transform())
+    {
+        instances.push_back(Instance{ mesh, Transform(), Transform(), Bounds() });
+        const int id(static_cast<int>(instances.size()) - 1);
+        setTransform(id, model);
+        return id;
+    }
+
+    //図形のモデル変換行列を変更する
+    //  id: 図形の番号
+    //  model: モデル変換行列
+    void setTransform(int id, const Transform &model)
+    {
+        Instance &i(instances[id]);
+        i.model = model;
+        i.inverse = model.inverse();
+        i.bounds = i.mesh->getBounds().transform(model);
+        dirty = true;
+    }
+
+    //光線と交差する一番近い図形を求める
+    //  ray: ワールド座標系の光線
+    //  hit: 選択の結果の格納先
+    //  戻り値: 交差する図形があれば true
+    bool pick(const Ray &ray, Hit &hit)
+    {
+        //図形の配置が変わっていたら BVH を作り直す
+        if(dirty)
+        {
+            std::vector<Bounds> items;
+            for(const Instance &i : instances) items.push_back(i.bounds);
+            bvh.build(items, 1);
+            dirty = false;
+        }
+
+        GLfloat tmax(std::numeric_limits<GLfloat>::max());
+        int object(-1);
+        GLuint triangle(0);
+
+        bvh.traverse(ray, tmax, [this, &ray, &object, &triangle](const BoundingVolumeHierarchy::Node &n, GLfloat &t)
+        {
+            for(GLuint k = n.first; k < n.first + n.count; k++)
+            {
+                //光線を図形の座標系に移す（方向は正規化しないので距離はそのまま比べられる）
+                Instance &i(instances[bvh.order[k]]);
+                const Vector o(i.inverse * Vector{ ray.origin[0], ray.origin[1], ray.origin[2], 1.0f });
+                const Vector d(i.inverse * Vector{ ray.direction[0], ray.direction[1], ray.direction[2], 0.0f });
+                const Ray local = { { o[0], o[1], o[2] }, { d[0], d[1], d[2] } };
+
+                if(i.mesh->intersect(local, t, triangle)) object = static_cast<int>(bvh.order[k]);
+            }
+        });
+
+        if(object < 0) return false;
+
+        hit.object = object;
+        hit.triangle = triangle;
+        hit.distance = tmax;
+        for(int i = 0; i < 3; i++) hit.position[i] = ray.origin[i] + ray.direction[i] * tmax;
+        return true;
+    }
+};
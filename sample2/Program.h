@@ -0,0 +1,167 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <GL/glew.h>
+
+//GPU メモリの使用量の記録
+#include "GpuMemory.h"
+
+// シェーダオブジェクトのコンパイル結果を表示する
+// shader: シェーダオブジェクト名
+// str:    コンパイルエラーが発生した場所を示す文字列
+
+inline GLboolean printShaderInfoLog(GLuint shader,const char *str){
+    //コンパイル結果を取得する
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status == GL_FALSE) std :: cerr << "Compile Error in " << str << std::endl;
+    
+    //シェーダのコンパイル時のログの長さを取得する
+    GLsizei bufSize;
+    glGetShaderiv(shader,GL_INFO_LOG_LENGTH,&bufSize);
+    
+    if(bufSize > 1){
+        //シェーダのコンパイル時のログの内容を取得する
+        std::vector<GLchar> infoLog(bufSize);
+        GLsizei length;
+        glGetShaderInfoLog(shader,bufSize,&length,&infoLog[0]);
+        std::cerr << &infoLog[0] << std::endl;
+    }
+    
+    return static_cast<GLboolean>(status);
+}
+
+//プログラムオブジェクトのリンク結果をg表示する
+// program:プログラムオブジェクト名
+
+inline GLboolean printProgramInfoLog(GLuint program){
+    //リンク結果を取得する
+    GLint status;
+    glGetProgramiv(program,GL_LINK_STATUS,&status);
+    if(status == GL_FALSE) std::cerr << "Link Error." << std::endl;
+    
+    //シェーダのリンク時のログの長さを取得する
+    GLsizei bufsize;
+    glGetProgramiv(program,GL_INFO_LOG_LENGTH,&bufsize);
+    
+    if(bufsize > 1){
+        //シェーダのリンク時のログの内容を取得する
+        std::vector<GLchar> infoLog(bufsize);
+        GLsizei length;
+        glGetProgramInfoLog(program,bufsize,&length,&infoLog[0]);
+        std::cerr << &infoLog[0] << std::endl;
+    }
+    
+    return static_cast<GLboolean>(status);
+}
+
+
+//   プログラムオブジェクトを作成する
+//   vsrc: バーテックスシェーダのソースプログラムの表示
+//   fsrc: フラグメントシェーダのソースプログラムの文字列
+
+inline GLuint createProgram(const char *vsrc, const char *fsrc){
+    //空のプログラムオブジェクトを作成する
+    const GLuint program(glCreateProgram());
+    
+    //バーテックスシェーダのソースがあった時
+    if(vsrc != NULL){
+        //バーテックスシェーダのシェーダオブジェクトを作成する
+        const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+        glShaderSource(vobj,1,&vsrc,NULL);
+        glCompileShader(vobj);
+        
+        if(printShaderInfoLog(vobj,"vertex shader"))
+            glAttachShader(program,vobj);
+        glDeleteShader(vobj);
+        
+        
+    }
+    
+    
+    if(fsrc != NULL){
+        //フラグメントシェーダのシェーダオブジェクトを作成する
+        const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
+        glShaderSource(fobj,1,&fsrc,NULL);
+        glCompileShader(fobj);
+        
+        //フラグメントシェーダのシェーダオブジェクトをプログラムオブジェクトに組み込む
+        if(printShaderInfoLog(fobj,"fragment shader"))
+            glAttachShader(program,fobj);
+        glDeleteShader(fobj);
+    }
+    
+    //プログラムオブジェクトをリンクする
+    glBindAttribLocation(program,0,"position");
+    glBindAttribLocation(program, 1, "normal");
+    glBindFragDataLocation(program,0,"fragment");
+    glLinkProgram(program);
+    
+    //作成したプログラムオブジェクトを返す
+    if(printProgramInfoLog(program)){
+        const GLsizeiptr size(GpuMemory::programSize(program));
+        GpuMemory::instance().allocate(GpuMemory::Program, program, size, size, 0, "createProgram");
+        return program;
+    }
+    
+    //プログラムオブジェクトが作成できなければ0を返す
+    glDeleteProgram(program);
+    return 0;
+}
+
+
+
+//シェーダのソースファイルを読み込んだメモリを返す
+//name: シェーダのソースファイル名
+//buffer: 読み込んだソースファイルのテキスト
+inline bool readShaderSource(const char *name,std::vector<GLchar> &buffer){
+    //ファイル名がNULL
+    if(name == NULL) return false;
+    
+    //ソースファイルを開く
+    std::ifstream file(name,std::ios::binary);
+    if(file.fail()){
+        //開けなかった場合
+        std::cerr << "Error: Can't open source file: " << name << std::endl;
+        return false;
+    }
+    
+    //ファイルの末尾に移動し現在位置（＝ファイルサイズ）を得る
+    file.seekg(0L,std::ios::end);
+    GLsizei length = static_cast<GLsizei>(file.tellg());
+    
+    //ファイルサイズのメモリを確保
+    buffer.resize(length + 4);
+    
+    //ファイルを先頭から読み込む
+    file.seekg(0L,std::ios::beg);
+    file.read(buffer.data(),length);
+    buffer[length] = '\n';
+    
+    if(file.fail()){
+        //上手く読み込めなかった
+        std::cerr << "Error: Could not read source file" << name << std::endl;
+        file.close();
+        return false;
+    }
+    
+    //読み込み成功
+    file.close();
+    return true;
+}
+
+
+//シェーダのソースファイルを読み込んでプログラムオブジェクトを作成する
+//  vert:バーテックスシェーダのソースファイル名
+//  frag:フラグメントシェーダのソースファイル名
+inline GLuint loadProgram(const char *vert,const char *frag){
+    //シェーダのソースファイルを読み込む
+    std::vector<GLchar> vsrc;
+    const bool vstat(readShaderSource(vert, vsrc));
+    std::vector<GLchar> fsrc;
+    const bool fstat(readShaderSource(frag, fsrc));
+    
+    //プログラムオブジェクトを作成する
+    return vstat && fstat ? createProgram(vsrc.data(), fsrc.data()) : 0;
+}
@@ -0,0 +1,379 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <GL/glew.h>
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+
+//アフィン変換行列
+#include "Transform.h"
+
+/*
+ 四元数と双対四元数
+
+ 回転は四元数 (x, y, z, w) で持てば合成は 16 回の乗算で済み、補間もできる
+ 平行移動を含む剛体変換は双対四元数で持つ
+ 変換行列にするのは uniform 変数に送るときだけで、
+ Transform の式に混ぜればそのまま view * translate * q のように合成できる
+*/
+
+// 四元数（回転）
+class Quaternion
+: public AffineExpr<Quaternion>
+{
+public:
+
+    //ベクトル部と実部
+    GLfloat x, y, z, w;
+
+    //コンストラクタ（回転しない）
+    constexpr Quaternion()
+    : x(0.0f), y(0.0f), z(0.0f), w(1.0f)
+    {
+    }
+
+    //要素を指定するコンストラクタ
+    constexpr Quaternion(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+    : x(x), y(y), z(z), w(w)
+    {
+    }
+
+    //(x,y,z)を軸にa回転する四元数を作成する
+    static Quaternion rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
+    {
+        const GLfloat d(sqrt(x * x + y * y + z * z));
+        if(d == 0.0f) return Quaternion();
+
+        const GLfloat s(sin(a * 0.5f) / d);
+        return Quaternion(x * s, y * s, z * s, cos(a * 0.5f));
+    }
+
+    //回転行列から四元数を求める（拡大縮小を含まない Transform の回転部分）
+    static Quaternion fromTransform(const Transform &m)
+    {
+        //列優先なので m[列 * 3 + 行]
+        const GLfloat trace(m[0] + m[4] + m[8]);
+
+        if(trace > 0.0f)
+        {
+            const GLfloat s(sqrt(trace + 1.0f) * 2.0f);
+            return Quaternion((m[5] - m[7]) / s, (m[6] - m[2]) / s, (m[1] - m[3]) / s, 0.25f * s);
+        }
+        if(m[0] > m[4] && m[0] > m[8])
+        {
+            const GLfloat s(sqrt(1.0f + m[0] - m[4] - m[8]) * 2.0f);
+            return Quaternion(0.25f * s, (m[3] + m[1]) / s, (m[6] + m[2]) / s, (m[5] - m[7]) / s);
+        }
+        if(m[4] > m[8])
+        {
+            const GLfloat s(sqrt(1.0f + m[4] - m[0] - m[8]) * 2.0f);
+            return Quaternion((m[3] + m[1]) / s, 0.25f * s, (m[7] + m[5]) / s, (m[6] - m[2]) / s);
+        }
+        const GLfloat s(sqrt(1.0f + m[8] - m[0] - m[4]) * 2.0f);
+        return Quaternion((m[6] + m[2]) / s, (m[7] + m[5]) / s, 0.25f * s, (m[1] - m[3]) / s);
+    }
+
+    //共役（単位四元数なら逆回転）
+    constexpr Quaternion conjugate() const
+    {
+        return Quaternion(-x, -y, -z, w);
+    }
+
+    //内積
+    constexpr GLfloat dot(const Quaternion &q) const
+    {
+        return x * q.x + y * q.y + z * q.z + w * q.w;
+    }
+
+    //正規化する（長さが 0 なら回転しない四元数にする）
+    Quaternion normalize() const
+    {
+        const GLfloat d(dot(*this));
+        if(d == 0.0f) return Quaternion();
+
+        const GLfloat r(1.0f / sqrt(d));
+        return Quaternion(x * r, y * r, z * r, w * r);
+    }
+
+    //ベクトルを回転する
+    //  v: 回転するベクトル（w 要素はそのまま）
+    Vector apply(const Vector &v) const
+    {
+        // t = 2 (q.xyz × v), v' = v + w t + q.xyz × t
+        const GLfloat tx(2.0f * (y * v[2] - z * v[1]));
+        const GLfloat ty(2.0f * (z * v[0] - x * v[2]));
+        const GLfloat tz(2.0f * (x * v[1] - y * v[0]));
+        const Vector r =
+        {
+            v[0] + w * tx + y * tz - z * ty,
+            v[1] + w * ty + z * tx - x * tz,
+            v[2] + w * tz + x * ty - y * tx,
+            v[3]
+        };
+        return r;
+    }
+
+    //3x3 の回転行列を求める（単位四元数であること）
+    //  m: 列優先の 9 要素の行列の格納先
+    constexpr void getMatrix(GLfloat *m) const
+    {
+        const GLfloat xx(x * x), yy(y * y), zz(z * z);
+        const GLfloat xy(x * y), yz(y * z), zx(z * x);
+        const GLfloat wx(w * x), wy(w * y), wz(w * z);
+
+        m[0] = 1.0f - 2.0f * (yy + zz);
+        m[1] = 2.0f * (xy + wz);
+        m[2] = 2.0f * (zx - wy);
+        m[3] = 2.0f * (xy - wz);
+        m[4] = 1.0f - 2.0f * (zz + xx);
+        m[5] = 2.0f * (yz + wx);
+        m[6] = 2.0f * (zx + wy);
+        m[7] = 2.0f * (yz - wx);
+        m[8] = 1.0f - 2.0f * (xx + yy);
+    }
+
+    //回転の変換に変換する（Transform の式の中で使う）
+    constexpr Rotation toRotation() const
+    {
+        GLfloat m[9] = {};
+        getMatrix(m);
+        return Rotation(m);
+    }
+
+    //4x4 の変換行列に変換する（uniform 変数に送るとき）
+    constexpr Matrix toMatrix() const
+    {
+        return Transform(toRotation()).toMatrix();
+    }
+
+    //t にこの回転を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        toRotation().assignTo(t);
+    }
+
+    //t に右からこの回転をかける
+    constexpr void multiply(Transform &t) const
+    {
+        toRotation().multiply(t);
+    }
+};
+
+static_assert(sizeof (Quaternion) == 4 * sizeof (GLfloat), "Quaternion must be four packed floats");
+
+// 四元数の積（右の回転の後に左の回転）
+constexpr Quaternion operator*(const Quaternion &a, const Quaternion &b)
+{
+    return Quaternion(
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+        a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+// 四元数の実数倍
+constexpr Quaternion operator*(const Quaternion &q, GLfloat s)
+{
+    return Quaternion(q.x * s, q.y * s, q.z * s, q.w * s);
+}
+
+// 四元数の和
+constexpr Quaternion operator+(const Quaternion &a, const Quaternion &b)
+{
+    return Quaternion(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+
+// 四元数の線形補間を正規化したもの（角速度は一定でないが速い）
+//  a, b: 補間する回転
+//  t: 補間の割合
+inline Quaternion nlerp(const Quaternion &a, const Quaternion &b, GLfloat t)
+{
+    //遠回りしないように向きを揃える
+    const GLfloat s(a.dot(b) < 0.0f ? -t : t);
+    return (a * (1.0f - t) + b * s).normalize();
+}
+
+// 四元数の球面線形補間（角速度が一定）
+//  a, b: 補間する回転
+//  t: 補間の割合
+inline Quaternion slerp(const Quaternion &a, const Quaternion &b, GLfloat t)
+{
+    //遠回りしないように向きを揃える
+    GLfloat d(a.dot(b));
+    const Quaternion c(d < 0.0f ? b * -1.0f : b);
+    if(d < 0.0f) d = -d;
+
+    //ほとんど同じ向きなら nlerp で十分
+    if(d > 0.9995f) return nlerp(a, c, t);
+
+    const GLfloat theta(acos(d));
+    const GLfloat r(1.0f / sin(theta));
+    return a * (sin((1.0f - t) * theta) * r) + c * (sin(t * theta) * r);
+}
+
+// 双対四元数（回転と平行移動からなる剛体変換）
+//  real が回転、dual が平行移動 t について t * real / 2
+class DualQuaternion
+: public AffineExpr<DualQuaternion>
+{
+public:
+
+    //実部と双対部
+    Quaternion real, dual;
+
+    //コンストラクタ（変換しない）
+    constexpr DualQuaternion()
+    : real(), dual(0.0f, 0.0f, 0.0f, 0.0f)
+    {
+    }
+
+    //実部と双対部を指定するコンストラクタ
+    constexpr DualQuaternion(const Quaternion &real, const Quaternion &dual)
+    : real(real), dual(dual)
+    {
+    }
+
+    //回転 q の後に (x,y,z) だけ平行移動する双対四元数を作るコンストラクタ
+    constexpr DualQuaternion(const Quaternion &q, GLfloat x, GLfloat y, GLfloat z)
+    : real(q), dual(Quaternion(x, y, z, 0.0f) * q * 0.5f)
+    {
+    }
+
+    //剛体変換の Transform から作るコンストラクタ（拡大縮小を含まないこと）
+    explicit DualQuaternion(const Transform &t)
+    : DualQuaternion(Quaternion::fromTransform(t), t[9], t[10], t[11])
+    {
+    }
+
+    //(x,y,z)だけ平行移動する双対四元数を作成する
+    static constexpr DualQuaternion translate(GLfloat x, GLfloat y, GLfloat z)
+    {
+        return DualQuaternion(Quaternion(), x, y, z);
+    }
+
+    //正規化する（実部を単位四元数にする）
+    DualQuaternion normalize() const
+    {
+        const GLfloat d(real.dot(real));
+        if(d == 0.0f) return DualQuaternion();
+
+        const GLfloat r(1.0f / sqrt(d));
+        return DualQuaternion(real * r, dual * r);
+    }
+
+    //平行移動量を求める
+    //  t: 3 要素の格納先
+    constexpr void getTranslation(GLfloat *t) const
+    {
+        // 2 dual * conjugate(real) のベクトル部
+        t[0] = 2.0f * (real.w * dual.x - dual.w * real.x + real.y * dual.z - real.z * dual.y);
+        t[1] = 2.0f * (real.w * dual.y - dual.w * real.y + real.z * dual.x - real.x * dual.z);
+        t[2] = 2.0f * (real.w * dual.z - dual.w * real.z + real.x * dual.y - real.y * dual.x);
+    }
+
+    //アフィン変換行列に変換する
+    constexpr Transform toTransform() const
+    {
+        Transform t(real.toRotation());
+        GLfloat p[3] = {};
+        getTranslation(p);
+        for(int i = 0; i < 3; i++) t[9 + i] = p[i];
+        return t;
+    }
+
+    //4x4 の変換行列に変換する（uniform 変数に送るとき）
+    constexpr Matrix toMatrix() const
+    {
+        return toTransform().toMatrix();
+    }
+
+    //t にこの変換を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        t = toTransform();
+    }
+
+    //t に右からこの変換をかける
+    constexpr void multiply(Transform &t) const
+    {
+        toTransform().multiply(t);
+    }
+};
+
+// 双対四元数の積（右の変換の後に左の変換）
+constexpr DualQuaternion operator*(const DualQuaternion &a, const DualQuaternion &b)
+{
+    return DualQuaternion(a.real * b.real, a.real * b.dual + a.dual * b.real);
+}
+
+// 双対四元数の線形補間を正規化したもの（dual quaternion linear blending）
+//  a, b: 補間する変換
+//  t: 補間の割合
+inline DualQuaternion nlerp(const DualQuaternion &a, const DualQuaternion &b, GLfloat t)
+{
+    //遠回りしないように向きを揃える
+    const GLfloat s(a.real.dot(b.real) < 0.0f ? -t : t);
+    return DualQuaternion(a.real * (1.0f - t) + b.real * s, a.dual * (1.0f - t) + b.dual * s).normalize();
+}
+
+// 多数の双対四元数をまとめて 4x4 の変換行列に変換する
+//  SSE が使えるときは四つずつ要素ごとに並べ替えて同時に求める
+//  q: 単位双対四元数の配列
+//  count: 変換する数
+//  m: 変換行列の格納先
+inline void toMatrices(const DualQuaternion *q, std::size_t count, Matrix *m)
+{
+    std::size_t i(0);
+
+#if defined(__SSE__)
+    const __m128 one(_mm_set1_ps(1.0f)), two(_mm_set1_ps(2.0f));
+
+    for(; i + 4 <= count; i += 4)
+    {
+        //四つの実部と双対部を x, y, z, w ごとに並べ替える
+        __m128 rx(_mm_loadu_ps(&q[i].real.x)), ry(_mm_loadu_ps(&q[i + 1].real.x));
+        __m128 rz(_mm_loadu_ps(&q[i + 2].real.x)), rw(_mm_loadu_ps(&q[i + 3].real.x));
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+        __m128 dx(_mm_loadu_ps(&q[i].dual.x)), dy(_mm_loadu_ps(&q[i + 1].dual.x));
+        __m128 dz(_mm_loadu_ps(&q[i + 2].dual.x)), dw(_mm_loadu_ps(&q[i + 3].dual.x));
+        _MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+
+        //回転行列
+        const __m128 xx(_mm_mul_ps(rx, rx)), yy(_mm_mul_ps(ry, ry)), zz(_mm_mul_ps(rz, rz));
+        const __m128 xy(_mm_mul_ps(rx, ry)), yz(_mm_mul_ps(ry, rz)), zx(_mm_mul_ps(rz, rx));
+        const __m128 wx(_mm_mul_ps(rw, rx)), wy(_mm_mul_ps(rw, ry)), wz(_mm_mul_ps(rw, rz));
+
+        __m128 c[4][4];
+        c[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        c[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+        c[0][2] = _mm_mul_ps(two, _mm_sub_ps(zx, wy));
+        c[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+        c[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(zz, xx)));
+        c[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+        c[2][0] = _mm_mul_ps(two, _mm_add_ps(zx, wy));
+        c[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+        c[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+        c[0][3] = c[1][3] = c[2][3] = _mm_setzero_ps();
+
+        //平行移動 = 2 dual * conjugate(real) のベクトル部
+        c[3][0] = _mm_mul_ps(two, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, dx), _mm_mul_ps(ry, dz)),
+                                             _mm_add_ps(_mm_mul_ps(dw, rx), _mm_mul_ps(rz, dy))));
+        c[3][1] = _mm_mul_ps(two, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, dy), _mm_mul_ps(rz, dx)),
+                                             _mm_add_ps(_mm_mul_ps(dw, ry), _mm_mul_ps(rx, dz))));
+        c[3][2] = _mm_mul_ps(two, _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, dz), _mm_mul_ps(rx, dy)),
+                                             _mm_add_ps(_mm_mul_ps(dw, rz), _mm_mul_ps(ry, dx))));
+        c[3][3] = one;
+
+        //列ごとに四つの行列の並びに戻して書き込む
+        for(int j = 0; j < 4; j++)
+        {
+            _MM_TRANSPOSE4_PS(c[j][0], c[j][1], c[j][2], c[j][3]);
+            for(int k = 0; k < 4; k++) _mm_storeu_ps(&m[i + k][j * 4], c[j][k]);
+        }
+    }
+#endif
+
+    //残り（SSE が使えないときは全て）は一つずつ変換する
+    for(; i < count; i++) m[i] = q[i].toMatrix();
+}
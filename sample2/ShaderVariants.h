@@ -0,0 +1,292 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <GL/glew.h>
+
+//シェーダのソースの読み込みとログの表示
+#include "Program.h"
+
+//材質データ
+#include "Material.h"
+
+// シェーダの機能の組み合わせ（#define としてソースに差し込む）
+struct ShaderFeature
+{
+    //光源の数
+    int lights;
+
+    //鏡面反射光を計算するか
+    bool specular;
+
+    //陰影を頂点ごとに計算するか（false ならフラグメントごと）
+    bool perVertex;
+
+    //インスタンスごとの変換行列と材質の番号を頂点属性から受け取るか
+    bool instancing;
+
+    //関節の変換行列（パレット）を頂点の重みで混ぜてから変換するか
+    bool skinning;
+
+    //組み合わせを一つの整数にまとめる（キャッシュのキー）
+    GLuint key() const
+    {
+        return static_cast<GLuint>(lights) << 4 | (skinning ? 8u : 0u)
+            | (specular ? 4u : 0u) | (perVertex ? 2u : 0u) | (instancing ? 1u : 0u);
+    }
+
+    //シェーダのソースに差し込む #define を作る
+    std::string defines() const
+    {
+        return "#define LCOUNT " + std::to_string(lights) + "\n"
+            + "#define SPECULAR " + (specular ? "1" : "0") + "\n"
+            + "#define PER_VERTEX " + (perVertex ? "1" : "0") + "\n"
+            + "#define INSTANCING " + (instancing ? "1" : "0") + "\n"
+            + "#define SKINNING " + (skinning ? "1" : "0") + "\n";
+    }
+};
+
+// 機能の組み合わせごとにシェーダをコンパイルして保持する
+class ShaderVariants
+{
+public:
+
+    //コンパイルしたシェーダと uniform 変数の場所
+    struct Variant
+    {
+        //プログラムオブジェクト名（リンクに失敗したら0）
+        GLuint program;
+
+        //リンクが終わって uniform 変数の場所を取得したか
+        bool linked;
+
+        //コンパイル中のシェーダオブジェクト名
+        GLuint vobj, fobj;
+
+        //uniform 変数の場所
+        GLint modelviewLoc, projectionLoc, normalMatrixLoc;
+        GLint LposLoc, LambLoc, LdiffLoc, LspecLoc;
+        GLint materialLoc, materialIndexLoc;
+    };
+
+    //関節の変換行列（パレット）のユニフォームブロックの結合ポイント
+    static constexpr GLuint paletteBinding = 0;
+
+private:
+
+    //バーテックスシェーダとフラグメントシェーダのソース
+    std::vector<GLchar> vsrc, fsrc;
+
+    //ソースの1行目（#version）の長さ
+    GLint vversion, fversion;
+
+    //コンパイルしたシェーダ
+    std::map<GLuint, Variant> cache;
+
+    //ドライバがシェーダを並列にコンパイルできるか
+    bool parallel;
+
+    //1行目の長さを求める（#define は #version の後ろに置かなければならない）
+    static GLint firstLine(const std::vector<GLchar> &src)
+    {
+        GLint n(0);
+        while(src[n] != '\0' && src[n++] != '\n');
+        return n;
+    }
+
+    //#define を差し込んでシェーダオブジェクトのコンパイルを始める
+    static GLuint compile(GLenum type, const std::vector<GLchar> &src, GLint version,
+                          const std::string &defines)
+    {
+        const GLchar *const string[] = { src.data(), defines.c_str(), src.data() + version };
+        const GLint length[] = { version, static_cast<GLint>(defines.size()), -1 };
+
+        const GLuint shader(glCreateShader(type));
+        glShaderSource(shader, 3, string, length);
+        glCompileShader(shader);
+
+        return shader;
+    }
+
+    //リンクの終わったプログラムオブジェクトの結果を調べて uniform 変数の場所を取得する
+    static void finish(Variant &v)
+    {
+        //コンパイルとリンクの結果を表示する
+        const GLboolean vstat(printShaderInfoLog(v.vobj, "vertex shader"));
+        const GLboolean fstat(printShaderInfoLog(v.fobj, "fragment shader"));
+        glDeleteShader(v.vobj);
+        glDeleteShader(v.fobj);
+        v.linked = true;
+
+        if(!vstat || !fstat || !printProgramInfoLog(v.program))
+        {
+            //プログラムオブジェクトが作成できなければ0にする
+            glDeleteProgram(v.program);
+            v.program = 0;
+            return;
+        }
+        const GLsizeiptr size(GpuMemory::programSize(v.program));
+        GpuMemory::instance().allocate(GpuMemory::Program, v.program, size, size, 0, "ShaderVariants");
+
+        //uniform 変数の場所を取得する
+        v.modelviewLoc = glGetUniformLocation(v.program, "modelview");
+        v.projectionLoc = glGetUniformLocation(v.program, "projection");
+        v.normalMatrixLoc = glGetUniformLocation(v.program, "normalMatrix");
+        v.LposLoc = glGetUniformLocation(v.program, "Lpos");
+        v.LambLoc = glGetUniformLocation(v.program, "Lamb");
+        v.LdiffLoc = glGetUniformLocation(v.program, "Ldiff");
+        v.LspecLoc = glGetUniformLocation(v.program, "Lspec");
+        v.materialLoc = glGetUniformLocation(v.program, "material");
+        v.materialIndexLoc = glGetUniformLocation(v.program, "materialIndex");
+
+        //パレットのユニフォームブロックは決まった結合ポイントから読む
+        const GLuint palette(glGetUniformBlockIndex(v.program, "Palette"));
+        if(palette != GL_INVALID_INDEX) glUniformBlockBinding(v.program, palette, paletteBinding);
+    }
+
+public:
+
+    //シェーダのソースファイルを読み込む（GL を使わないのでワーカースレッドで読み込んでおける）
+    //  name: シェーダのソースファイル名
+    //  戻り値: 読み込んだソース（失敗したら空）
+    static std::vector<GLchar> read(const char *name)
+    {
+        std::vector<GLchar> src;
+        if(!readShaderSource(name, src)) src.clear();
+        return src;
+    }
+
+    //コンストラクタ
+    //  vert: バーテックスシェーダのソースファイル名
+    //  frag: フラグメントシェーダのソースファイル名
+    ShaderVariants(const char *vert, const char *frag)
+    : ShaderVariants(read(vert), read(frag))
+    {
+    }
+
+    //コンストラクタ（読み込んでおいたソースを使う）
+    //  vsrc: read() で読み込んだバーテックスシェーダのソース
+    //  fsrc: read() で読み込んだフラグメントシェーダのソース
+    ShaderVariants(std::vector<GLchar> &&vsrc, std::vector<GLchar> &&fsrc)
+    : vsrc(std::move(vsrc)), fsrc(std::move(fsrc))
+    , vversion(this -> vsrc.empty() ? 0 : firstLine(this -> vsrc))
+    , fversion(this -> fsrc.empty() ? 0 : firstLine(this -> fsrc))
+    , parallel(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+    {
+        //ドライバが使えるだけのスレッドでコンパイルさせる
+        if(GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xffffffff);
+        else if(GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xffffffff);
+    }
+
+    //デストラクタ
+    virtual ~ShaderVariants()
+    {
+        for(auto &c : cache)
+        {
+            if(!c.second.linked)
+            {
+                glDeleteShader(c.second.vobj);
+                glDeleteShader(c.second.fobj);
+            }
+            GpuMemory::instance().release(GpuMemory::Program, c.second.program);
+            glDeleteProgram(c.second.program);
+        }
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    ShaderVariants(const ShaderVariants &s);
+    //代入によるコピー禁止
+    ShaderVariants &operator = (const ShaderVariants &s);
+
+public:
+
+    //機能の組み合わせのコンパイルとリンクを始める（結果は待たない）
+    //  並列コンパイルが使えればドライバのスレッドで、
+    //  使えなくても結果を問い合わせるまではドライバの中で処理が進む
+    //  f: 機能の組み合わせ
+    void request(const ShaderFeature &f)
+    {
+        if(vsrc.empty() || fsrc.empty() || cache.count(f.key()) > 0) return;
+
+        Variant v = {};
+        const std::string defines(f.defines());
+        v.vobj = compile(GL_VERTEX_SHADER, vsrc, vversion, defines);
+        v.fobj = compile(GL_FRAGMENT_SHADER, fsrc, fversion, defines);
+
+        //プログラムオブジェクトをリンクする
+        v.program = glCreateProgram();
+        glAttachShader(v.program, v.vobj);
+        glAttachShader(v.program, v.fobj);
+        glBindAttribLocation(v.program, 0, "position");
+        glBindAttribLocation(v.program, 1, "normal");
+        glBindAttribLocation(v.program, 2, "instanceModelview");
+        glBindAttribLocation(v.program, 6, "instanceMaterial");
+        glBindAttribLocation(v.program, 7, "joints");
+        glBindAttribLocation(v.program, 8, "weights");
+        glBindAttribLocation(v.program, 9, "instanceSphere");   //球のインポスタの中心と半径
+        glBindFragDataLocation(v.program, 0, "fragment");
+        glLinkProgram(v.program);
+
+        cache.emplace(f.key(), v);
+    }
+
+    //機能の組み合わせのリンクが終わっているか（終わっていなくても待たない）
+    //  並列コンパイルが使えなければ問い合わせると待つので終わったものとみなす
+    //  f: 機能の組み合わせ
+    bool ready(const ShaderFeature &f) const
+    {
+        const auto found(cache.find(f.key()));
+        if(found == cache.end()) return false;
+        if(found -> second.linked || !parallel) return true;
+
+        GLint status;
+        glGetProgramiv(found -> second.program, GL_COMPLETION_STATUS_KHR, &status);
+        return status != GL_FALSE;
+    }
+
+    //機能の組み合わせのシェーダを取り出す（リンクが終わっていなければ待つ）
+    //  f: 機能の組み合わせ
+    const Variant &get(const ShaderFeature &f)
+    {
+        request(f);
+
+        static const Variant none = {};
+        const auto found(cache.find(f.key()));
+        if(found == cache.end()) return none;
+
+        if(!found -> second.linked) finish(found -> second);
+        return found -> second;
+    }
+
+    //材質と光源の数に対して最も軽い機能の組み合わせを選ぶ
+    //  lights: 使う光源の数（1以上）
+    //  m: 描画する材質
+    //  instancing: インスタンス描画か
+    //  skinning: 関節の変換行列で変形する図形か
+    static ShaderFeature choose(int lights, const Material &m, bool instancing = false, bool skinning = false)
+    {
+        //鏡面反射係数が0なら鏡面反射光の計算を省く
+        const bool specular(lights > 0
+            && (m.specular[0] > 0.0f || m.specular[1] > 0.0f || m.specular[2] > 0.0f));
+
+        //ハイライトがなければ拡散反射光は頂点で求めて補間しても見た目はほとんど変わらない
+        const ShaderFeature f = { lights, specular, !specular, instancing, skinning };
+        return f;
+    }
+
+    //使用中のシェーダに光源の uniform 変数を設定する（glUseProgram() の後に呼ぶ）
+    //  v: 使用中のシェーダ
+    //  lights: 光源の数
+    //  Lview: 視点座標系での光源の位置（光源ごとに四つの要素）
+    //  Lamb, Ldiff, Lspec: 光源ごとの環境光、拡散反射光、鏡面反射光の強度（光源ごとに RGB）
+    static void setLights(const Variant &v, int lights, const GLfloat *Lview,
+                          const GLfloat *Lamb, const GLfloat *Ldiff, const GLfloat *Lspec)
+    {
+        glUniform4fv(v.LposLoc, lights, Lview);
+        glUniform3fv(v.LambLoc, lights, Lamb);
+        glUniform3fv(v.LdiffLoc, lights, Ldiff);
+        glUniform3fv(v.LspecLoc, lights, Lspec);
+    }
+};
@@ -7,7 +7,7 @@
 //図形の描画
 class Shape{
     //図形データ
-    std::shared_ptr<const Object> object;
+    std::shared_ptr<Object> object;
     
 protected:
     //描画に使う頂点の数
@@ -21,14 +21,38 @@ public:
     // vertex:頂点属性を格納した配列
     // indexcount: 頂点のインデックスの要素数
     // index: 頂点のインデックスを格納した配列
+    // usage: バッファオブジェクトの使い方
     Shape(GLint size,GLsizei vertexcount,const Object::Vertex *vertex,
-          GLsizei indexcount = 0, const GLuint *index = NULL)
-    :object(new Object(size,vertexcount,vertex, indexcount, index))
+          GLsizei indexcount = 0, const GLuint *index = NULL, Object::Usage usage = Object::Static)
+    :object(new Object(size,vertexcount,vertex, indexcount, index, usage))
     ,vertexcount(vertexcount)
     {
         
     }
     
+    //頂点属性の一部を更新する
+    // first: 更新する最初の頂点の番号
+    // count: 更新する頂点の数
+    // vertex: 頂点属性を格納した配列
+    void update(GLint first, GLsizei count, const Object::Vertex *vertex){
+        object -> update(first, count, vertex);
+    }
+    
+    //インデックスの一部を更新する
+    // first: 更新する最初のインデックスの番号
+    // count: 更新するインデックスの数
+    // index: インデックスを格納した配列
+    void updateIndex(GLint first, GLsizei count, const GLuint *index){
+        object -> updateIndex(first, count, index);
+    }
+    
+    //頂点属性とインデックスの全体をバッファオブジェクトに直接書き込む
+    // f: 書き込み先の頂点属性の配列とインデックスの配列を受け取って書き込む関数 f(Object::Vertex *, GLuint *)
+    template<typename F>
+    bool fill(F f){
+        return object -> fill(f);
+    }
+    
     //描画
     void draw() const{
         //頂点配列オブジェクトを結合する
@@ -41,6 +65,12 @@ public:
     //描画の実行
     virtual void execute() const{
         //折れ線で描画する
-        glDrawArrays(GL_LINE_LOOP,0,vertexcount);
+        glDrawArrays(GL_LINE_LOOP,base(),vertexcount);
+    }
+    
+protected:
+    //描画に使う最初の頂点の番号
+    GLint base() const{
+        return object -> base();
     }
 };
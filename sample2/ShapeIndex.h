@@ -20,9 +20,10 @@ public:
     //  vertex: 頂点属性を格納した配列
     //  indexcount: 頂点のインデックスの要素数
     //  index: 頂点のインデックスを格納した配列
+    //  usage: バッファオブジェクトの使い方
     ShapeIndex(GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
-               GLsizei indexcount, const GLuint *index)
-    : Shape(size, vertexcount, vertex, indexcount, index)
+               GLsizei indexcount, const GLuint *index, Object::Usage usage = Object::Static)
+    : Shape(size, vertexcount, vertex, indexcount, index, usage)
     ,indexcount(indexcount)
     {
     }
@@ -31,6 +32,6 @@ public:
     virtual void execute() const
     {
         //線分群で描画する
-        glDrawElements(GL_LINES, indexcount, GL_UNSIGNED_INT, 0);
+        glDrawElementsBaseVertex(GL_LINES, indexcount, GL_UNSIGNED_INT, 0, base());
     }
 };
@@ -0,0 +1,192 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+//スレッド間のデータの受け渡し
+#include "TripleBuffer.h"
+
+// 描画とは別のスレッドで一定の時間刻みで状態を更新する
+//  State には interpolate(const State &, const State &, float) を用意しておく
+template <typename State>
+class Simulation
+{
+public:
+
+    //シミュレーションのスレッドが公開する一刻み分の結果
+    struct Frame
+    {
+        //一つ前の刻みの状態と最新の状態
+        State previous, current;
+
+        //最新の状態の時刻（秒）
+        double time;
+
+        //最新の状態を公開した時刻（秒）
+        double published;
+
+        //刻みの番号
+        unsigned long tick;
+
+        //予定の時刻からの刻みの開始の遅れの平均と最大（秒）
+        double jitterMean, jitterMax;
+    };
+
+    //揺らぎと遅延の統計
+    struct Stats
+    {
+        //シミュレーションが実行した刻みの数
+        unsigned long ticks;
+
+        //予定の時刻からの刻みの開始の遅れの平均と最大（秒）
+        double jitterMean, jitterMax;
+
+        //状態を公開してから描画に使われるまでの時間の平均と最大（秒）
+        double latencyMean, latencyMax;
+    };
+
+private:
+
+    //時間刻み（秒）
+    const double step;
+
+    //遅れを取り戻すために続けて実行する刻みの最大数（これを超えたら諦める）
+    static constexpr int maxCatchUp = 5;
+
+    //一刻み分状態を進める処理
+    const std::function<void(State &, double)> advance;
+
+    //シミュレーションのスレッドから描画のスレッドへの受け渡し
+    TripleBuffer<Frame> frames;
+
+    //スレッドを続けるか
+    std::atomic<bool> running;
+
+    //シミュレーションのスレッド
+    std::thread thread;
+
+    //遅延の統計（描画のスレッドだけが使う）
+    double latencySum, latencyMax;
+    unsigned long latencyCount;
+
+    //現在時刻（秒）
+    static double now()
+    {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //シミュレーションのスレッドの処理
+    void run(State state)
+    {
+        State previous(state);
+        double next(now());
+        unsigned long tick(0);
+        double jitterSum(0.0), jitterMax(0.0);
+
+        while(running.load(std::memory_order_relaxed))
+        {
+            //予定の時刻まで待つ
+            const double t(now());
+            if(t < next)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(next - t));
+                continue;
+            }
+
+            //予定の時刻からの遅れを記録する
+            const double late(t - next);
+            jitterSum += late;
+            jitterMax = std::max(jitterMax, late);
+
+            //遅れすぎていたら追いつくのを諦めて今を基準にする
+            if(late > step * maxCatchUp) next = t;
+
+            //一刻み進める
+            previous = state;
+            advance(state, step);
+            ++tick;
+
+            //結果を描画のスレッドに渡す
+            Frame &f(frames.write());
+            f.previous = previous;
+            f.current = state;
+            f.time = next;
+            f.tick = tick;
+            f.jitterMean = jitterSum / static_cast<double>(tick);
+            f.jitterMax = jitterMax;
+            f.published = now();
+            frames.publish();
+
+            next += step;
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  rate: 1秒あたりの刻みの数
+    //  initial: 状態の初期値
+    //  advance: 状態を dt 秒だけ進める処理
+    Simulation(double rate, const State &initial,
+               const std::function<void(State &, double)> &advance)
+    : step(1.0 / rate), advance(advance)
+    , frames(Frame{ initial, initial, now(), now(), 0, 0.0, 0.0 })
+    , running(true)
+    , latencySum(0.0), latencyMax(0.0), latencyCount(0)
+    {
+        //シミュレーションのスレッドを開始する
+        thread = std::thread(&Simulation::run, this, initial);
+    }
+
+    //デストラクタ
+    virtual ~Simulation()
+    {
+        //シミュレーションのスレッドを止める
+        running = false;
+        thread.join();
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    Simulation(const Simulation &s);
+    //代入によるコピー禁止
+    Simulation &operator = (const Simulation &s);
+
+public:
+
+    //描画する時刻の状態を求める（描画のスレッドから呼ぶ）
+    //  最新の刻みとその一つ前の刻みの間を補間するので一刻み分遅れて見える
+    State sample()
+    {
+        const double t(now());
+
+        //新しい刻みを受け取ったら遅延を記録する
+        if(frames.update())
+        {
+            const double latency(t - frames.read().published);
+            latencySum += latency;
+            latencyMax = std::max(latencyMax, latency);
+            ++latencyCount;
+        }
+
+        const Frame &f(frames.read());
+        const float alpha(static_cast<float>(std::min(std::max((t - f.time) / step, 0.0), 1.0)));
+        return interpolate(f.previous, f.current, alpha);
+    }
+
+    //揺らぎと遅延の統計を取り出す（描画のスレッドから呼ぶ）
+    Stats stats() const
+    {
+        const Frame &f(frames.read());
+        const Stats s =
+        {
+            f.tick, f.jitterMean, f.jitterMax,
+            latencyCount > 0 ? latencySum / static_cast<double>(latencyCount) : 0.0,
+            latencyMax
+        };
+        return s;
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+
+//変換行列
+#include "Matrix.h"
+
+//四元数
+#include "Quaternion.h"
+
+/*
+ 骨格アニメーション
+
+ 関節は親が必ず先に来る順に平らな配列に並べ、親の番号だけで階層を表す
+ 姿勢は関節ごとの回転（四元数）と平行移動を要素ごとの配列 (SoA) で持ち、
+ キーフレームの補間と二つの動きの混ぜ合わせは SSE で四つの関節ずつ行う
+ キーフレームは決まった間隔で焼き込んでおくので、サンプリングで時刻を探す必要はない
+ 関節の変換行列は配列の先頭から順に親の行列をかけて求め、逆バインド行列をかけてパレットにする
+*/
+
+// 関節ごとの姿勢（親の関節に対する回転と平行移動）
+struct Pose
+{
+    //関節の数
+    int joints;
+
+    //回転の四元数と平行移動（SSE で四つずつ処理するので四の倍数に切り上げて確保する）
+    std::vector<GLfloat> rx, ry, rz, rw, tx, ty, tz;
+
+    //コンストラクタ（全ての関節を回転も移動もしない姿勢にする）
+    //  joints: 関節の数
+    explicit Pose(int joints = 0)
+    {
+        resize(joints);
+    }
+
+    //関節の数を変えて全ての関節を回転も移動もしない姿勢にする
+    //  n: 関節の数
+    void resize(int n)
+    {
+        joints = n;
+        const std::size_t padded((static_cast<std::size_t>(n) + 3) & ~static_cast<std::size_t>(3));
+        for(std::vector<GLfloat> *v : { &rx, &ry, &rz, &tx, &ty, &tz }) v -> assign(padded, 0.0f);
+        rw.assign(padded, 1.0f);
+    }
+
+    //関節の姿勢を設定する
+    //  j: 関節の番号
+    //  q: 親の関節に対する回転
+    //  x, y, z: 親の関節に対する平行移動
+    void set(int j, const Quaternion &q, GLfloat x, GLfloat y, GLfloat z)
+    {
+        rx[j] = q.x;
+        ry[j] = q.y;
+        rz[j] = q.z;
+        rw[j] = q.w;
+        tx[j] = x;
+        ty[j] = y;
+        tz[j] = z;
+    }
+
+    //関節の回転
+    //  j: 関節の番号
+    Quaternion rotation(int j) const
+    {
+        return Quaternion(rx[j], ry[j], rz[j], rw[j]);
+    }
+};
+
+// 二つの姿勢を関節ごとに補間する（回転は正規化した線形補間、平行移動は線形補間）
+//  a, b: 補間する姿勢（関節の数が同じもの）
+//  t: 補間の割合（0 なら a、1 なら b）
+//  out: 補間した姿勢の格納先（a か b と同じでも良い）
+inline void blend(const Pose &a, const Pose &b, GLfloat t, Pose &out)
+{
+    if(out.joints != a.joints) out.resize(a.joints);
+    const std::size_t count(a.rx.size());
+    std::size_t i(0);
+
+#if defined(__SSE__)
+    const __m128 t1(_mm_set1_ps(t)), t0(_mm_set1_ps(1.0f - t));
+    const __m128 sign(_mm_set1_ps(-0.0f)), zero(_mm_setzero_ps()), one(_mm_set1_ps(1.0f));
+
+    //詰め物の関節も回転しない姿勢なので端数なく四つずつ処理できる
+    for(; i < count; i += 4)
+    {
+        const __m128 ax(_mm_loadu_ps(&a.rx[i])), ay(_mm_loadu_ps(&a.ry[i]));
+        const __m128 az(_mm_loadu_ps(&a.rz[i])), aw(_mm_loadu_ps(&a.rw[i]));
+        const __m128 bx(_mm_loadu_ps(&b.rx[i])), by(_mm_loadu_ps(&b.ry[i]));
+        const __m128 bz(_mm_loadu_ps(&b.rz[i])), bw(_mm_loadu_ps(&b.rw[i]));
+
+        //遠回りしないように内積が負なら b の割合の符号を反転する
+        const __m128 d(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                                  _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw))));
+        const __m128 s(_mm_xor_ps(t1, _mm_and_ps(d, sign)));
+        const __m128 x(_mm_add_ps(_mm_mul_ps(ax, t0), _mm_mul_ps(bx, s)));
+        const __m128 y(_mm_add_ps(_mm_mul_ps(ay, t0), _mm_mul_ps(by, s)));
+        const __m128 z(_mm_add_ps(_mm_mul_ps(az, t0), _mm_mul_ps(bz, s)));
+        const __m128 w(_mm_add_ps(_mm_mul_ps(aw, t0), _mm_mul_ps(bw, s)));
+
+        //正規化する（長さが 0 なら回転しない四元数にする）
+        const __m128 l(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                  _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+        const __m128 valid(_mm_cmpgt_ps(l, zero));
+        const __m128 r(_mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(l, _mm_set1_ps(1.0e-30f))))));
+        _mm_storeu_ps(&out.rx[i], _mm_mul_ps(x, r));
+        _mm_storeu_ps(&out.ry[i], _mm_mul_ps(y, r));
+        _mm_storeu_ps(&out.rz[i], _mm_mul_ps(z, r));
+        _mm_storeu_ps(&out.rw[i], _mm_or_ps(_mm_mul_ps(w, r), _mm_andnot_ps(valid, one)));
+
+        //平行移動は a + (b - a) t
+        _mm_storeu_ps(&out.tx[i], _mm_add_ps(_mm_loadu_ps(&a.tx[i]),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b.tx[i]), _mm_loadu_ps(&a.tx[i])), t1)));
+        _mm_storeu_ps(&out.ty[i], _mm_add_ps(_mm_loadu_ps(&a.ty[i]),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b.ty[i]), _mm_loadu_ps(&a.ty[i])), t1)));
+        _mm_storeu_ps(&out.tz[i], _mm_add_ps(_mm_loadu_ps(&a.tz[i]),
+            _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&b.tz[i]), _mm_loadu_ps(&a.tz[i])), t1)));
+    }
+#endif
+
+    //SSE が使えないときは一つずつ補間する
+    for(; i < count; i++)
+    {
+        const Quaternion q(nlerp(Quaternion(a.rx[i], a.ry[i], a.rz[i], a.rw[i]),
+                                 Quaternion(b.rx[i], b.ry[i], b.rz[i], b.rw[i]), t));
+        out.rx[i] = q.x;
+        out.ry[i] = q.y;
+        out.rz[i] = q.z;
+        out.rw[i] = q.w;
+        out.tx[i] = a.tx[i] + (b.tx[i] - a.tx[i]) * t;
+        out.ty[i] = a.ty[i] + (b.ty[i] - a.ty[i]) * t;
+        out.tz[i] = a.tz[i] + (b.tz[i] - a.tz[i]) * t;
+    }
+}
+
+// 決まった間隔で焼き込んだキーフレームの動き（最後のキーフレームの次は最初に戻る）
+class AnimationClip
+{
+    //関節の数
+    const int joints;
+
+    //一秒あたりのキーフレームの数
+    const GLfloat rate;
+
+    //キーフレームごとの姿勢
+    std::vector<Pose> keys;
+
+public:
+
+    //コンストラクタ
+    //  joints: 関節の数
+    //  rate: 一秒あたりのキーフレームの数
+    AnimationClip(int joints, GLfloat rate)
+    : joints(joints)
+    , rate(rate)
+    {
+    }
+
+    //キーフレームを末尾に追加する
+    //  戻り値: 追加したキーフレームの姿勢（回転も移動もしない姿勢で初期化してある）
+    Pose &addKey()
+    {
+        keys.emplace_back(joints);
+        return keys.back();
+    }
+
+    //関節の数
+    int getJoints() const { return joints; }
+
+    //一周の長さ（秒）
+    GLfloat duration() const { return static_cast<GLfloat>(keys.size()) / rate; }
+
+    //時刻の姿勢を前後のキーフレームの補間で求める
+    //  time: 時刻（秒、一周の長さを超えたら繰り返す）
+    //  out: 姿勢の格納先
+    void sample(GLfloat time, Pose &out) const
+    {
+        if(keys.empty())
+        {
+            out.resize(joints);
+            return;
+        }
+        const GLfloat n(static_cast<GLfloat>(keys.size()));
+        GLfloat f(time * rate);
+        f -= floorf(f / n) * n;
+        const std::size_t k0(std::min(static_cast<std::size_t>(f), keys.size() - 1));
+        const std::size_t k1((k0 + 1) % keys.size());
+        blend(keys[k0], keys[k1], f - static_cast<GLfloat>(k0), out);
+    }
+};
+
+// 関節の階層
+class Skeleton
+{
+public:
+
+    //関節の数の上限（point.vert の MAX_JOINTS と同じ）
+    static constexpr int maxJoints = 64;
+
+private:
+
+    //親の関節の番号（根は -1、親は必ず自分より前にある）
+    std::vector<int> parent;
+
+    //バインドポーズの関節の座標系から図形の座標系への変換の逆行列
+    std::vector<Matrix> inverseBind;
+
+public:
+
+    //関節を追加する
+    //  p: 親の関節の番号（根なら -1、追加済みの関節であること）
+    //  bind: バインドポーズの関節の変換行列の逆行列
+    //  戻り値: 関節の番号（上限を超えるか親が正しくなければ -1）
+    int add(int p, const Matrix &bind)
+    {
+        const int j(size());
+        if(j >= maxJoints || p >= j || p < -1) return -1;
+        parent.push_back(p);
+        inverseBind.push_back(bind);
+        return j;
+    }
+
+    //関節の数
+    int size() const { return static_cast<int>(parent.size()); }
+
+    //親の関節の番号
+    int getParent(int j) const { return parent[j]; }
+
+    //姿勢から関節の変換行列（パレット）を求める
+    //  pose: 関節ごとの姿勢
+    //  palette: 関節の数の変換行列の格納先
+    void evaluate(const Pose &pose, Matrix *palette) const
+    {
+        //親は先に求まっているので前から順に親の行列をかけて図形の座標系への変換を求める
+        const int n(std::min(size(), pose.joints));
+        for(int j = 0; j < n; j++)
+        {
+            Matrix local(pose.rotation(j).toMatrix());
+            local[12] = pose.tx[j];
+            local[13] = pose.ty[j];
+            local[14] = pose.tz[j];
+            palette[j] = parent[j] < 0 ? local : palette[parent[j]] * local;
+        }
+
+        //子が全て求まってからバインドポーズの逆行列をかける
+        for(int j = 0; j < n; j++) palette[j] = palette[j] * inverseBind[j];
+    }
+};
+
+// ユニフォームブロックに送る一体分の関節の変換行列（std140 の mat4 の配列と同じ並び）
+struct Palette
+{
+    Matrix joint[Skeleton::maxJoints];
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <GL/glew.h>
+
+//GPU 資源の管理
+#include "GpuResources.h"
+
+//関節の階層
+#include "Skeleton.h"
+
+// 関節の変換行列で変形する図形
+//  頂点ごとに影響する四つまでの関節の番号と重みを持ち、
+//  ShaderFeature::skinning を有効にした point.vert でパレットを混ぜて変形する
+class SkinnedShape
+{
+public:
+
+    //頂点属性
+    struct Vertex
+    {
+        //位置
+        GLfloat position[3];
+
+        //法線
+        GLfloat normal[3];
+
+        //影響する関節の番号
+        GLubyte joint[4];
+
+        //関節の重み（255 を 1 とし、合計が 255 になるようにする）
+        GLubyte weight[4];
+    };
+
+private:
+
+    //頂点配列オブジェクト（コンテキストごとに作る）
+    GpuResources::VertexArraySet vao;
+
+    //頂点バッファオブジェクトとインデックスのバッファオブジェクト
+    GpuResources::Buffer vbo, ibo;
+
+    //インデックスの要素数
+    const GLsizei indexcount;
+
+    //結合されている頂点配列オブジェクトにバッファオブジェクトを結び付ける
+    void setup()
+    {
+        //位置と法線は Object と同じ 0 番と 1 番、関節の番号と重みは ShaderVariants で 7 番と 8 番に結合されている
+        glBindBuffer(GL_ARRAY_BUFFER, vbo.get());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), static_cast<Vertex *>(0) -> position);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof (Vertex), static_cast<Vertex *>(0) -> normal);
+        glEnableVertexAttribArray(1);
+        glVertexAttribIPointer(7, 4, GL_UNSIGNED_BYTE, sizeof (Vertex), static_cast<Vertex *>(0) -> joint);
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(8, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (Vertex), static_cast<Vertex *>(0) -> weight);
+        glEnableVertexAttribArray(8);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo.get());
+    }
+
+public:
+
+    //コンストラクタ
+    //  vertexcount: 頂点の数
+    //  vertex: 頂点属性を格納した配列
+    //  indexcount: 三角形の頂点のインデックスの要素数
+    //  index: 頂点のインデックスを格納した配列
+    SkinnedShape(GLsizei vertexcount, const Vertex *vertex, GLsizei indexcount, const GLuint *index)
+    : vao("SkinnedShape")
+    , indexcount(indexcount)
+    {
+        GpuResources &resources(GpuResources::instance());
+        vbo = resources.acquireBuffer(vertexcount * sizeof (Vertex), GL_STATIC_DRAW, vertex, "SkinnedShape (vertex)");
+        ibo = resources.acquireBuffer(indexcount * sizeof (GLuint), GL_STATIC_DRAW, index, "SkinnedShape (index)");
+
+        //このコンテキストの頂点配列オブジェクトを作っておく
+        vao.bind([this]{ setup(); });
+    }
+
+    //デストラクタ
+    virtual ~SkinnedShape()
+    {
+        //頂点配列オブジェクトとバッファオブジェクトはハンドルが破棄されるときに返却される
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    SkinnedShape(const SkinnedShape &s);
+    //代入によるコピー禁止
+    SkinnedShape &operator = (const SkinnedShape &s);
+
+public:
+
+    //描画する（パレットのユニフォームブロックは結合しておく）
+    void draw()
+    {
+        vao.bind([this]{ setup(); });
+        glDrawElements(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0);
+    }
+};
+
+// y 軸に沿って関節を等間隔に並べた管の頂点属性とインデックスと骨格を作る
+//  joints: 関節の数（根から順に一つ前の関節を親とする）
+//  length: 管の長さ
+//  radius: 管の半径
+//  slices: 周方向の分割数
+//  rings: 一つの関節あたりの長さ方向の分割数
+//  vertex: 頂点属性の格納先
+//  index: インデックスの格納先
+//  skeleton: 骨格の格納先
+inline void makeSkinnedTube(int joints, GLfloat length, GLfloat radius, int slices, int rings,
+                            std::vector<SkinnedShape::Vertex> &vertex, std::vector<GLuint> &index,
+                            Skeleton &skeleton)
+{
+    //関節の間隔
+    const GLfloat segment(length / static_cast<GLfloat>(joints));
+
+    //関節はそれぞれの区間の下端に置き、バインドポーズの逆行列は根元に戻す平行移動にする
+    for(int j = 0; j < joints; j++)
+        skeleton.add(j - 1, Matrix::translate(0.0f, -segment * static_cast<GLfloat>(j), 0.0f));
+
+    //頂点属性を作る（区間の中で下の関節から上の関節へ重みを移す）
+    const int stacks(joints * rings);
+    for(int k = 0; k <= stacks; k++)
+    {
+        const GLfloat y(length * static_cast<GLfloat>(k) / static_cast<GLfloat>(stacks));
+        const GLfloat u(y / segment - 0.5f);
+        const int j0(std::max(0, std::min(joints - 1, static_cast<int>(floorf(u)))));
+        const int j1(std::min(joints - 1, j0 + 1));
+        const GLfloat w(std::max(0.0f, std::min(1.0f, u - static_cast<GLfloat>(j0))));
+        const GLubyte w1(static_cast<GLubyte>(w * 255.0f + 0.5f));
+
+        for(int i = 0; i <= slices; i++)
+        {
+            const GLfloat s(6.283185f * static_cast<GLfloat>(i) / static_cast<GLfloat>(slices));
+            const GLfloat x(sinf(s)), z(cosf(s));
+            const SkinnedShape::Vertex v =
+            {
+                { x * radius, y, z * radius },
+                { x, 0.0f, z },
+                { static_cast<GLubyte>(j0), static_cast<GLubyte>(j1), 0, 0 },
+                { static_cast<GLubyte>(255 - w1), w1, 0, 0 }
+            };
+            vertex.emplace_back(v);
+        }
+    }
+
+    //インデックスを作る
+    for(int k = 0; k < stacks; k++)
+    {
+        for(int i = 0; i < slices; i++)
+        {
+            //頂点のインデックス (下左、下右、上左、上右)
+            const GLuint k0(k * (slices + 1) + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k0 + slices + 1);
+            const GLuint k3(k2 + 1);
+            index.insert(index.end(), { k0, k1, k2, k2, k1, k3 });
+        }
+    }
+}
@@ -13,8 +13,10 @@ public:
     // size: 頂点の位置の次元
     // vertexcount: 頂点の数
     // vertex: 頂点属性を格納した配列
-    SolidShape(GLint size, GLsizei vertexcount, const Object::Vertex *vertex)
-      : Shape(size, vertexcount, vertex)
+    // usage: バッファオブジェクトの使い方
+    SolidShape(GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
+               Object::Usage usage = Object::Static)
+      : Shape(size, vertexcount, vertex, 0, NULL, usage)
     {
     }
     
@@ -22,6 +24,6 @@ public:
     virtual void execute() const
     {
         //三角形で描画する
-        glDrawArrays(GL_TRIANGLES, 0, vertexcount);
+        glDrawArrays(GL_TRIANGLES, base(), vertexcount);
     }
 };
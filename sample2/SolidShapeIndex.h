@@ -15,9 +15,10 @@ public:
     // vertex:頂点属性を格納した配列
     // indexcount: 頂点のインデックスの要素数
     // index: 頂点のインデックスを格納した配列
+    // usage: バッファオブジェクトの使い方
     SolidShapeIndex(GLint size, GLsizei vertexcount, const Object::Vertex *vertex,
-                    GLsizei indexcount, const GLuint *index)
-    :ShapeIndex(size, vertexcount, vertex, indexcount, index)
+                    GLsizei indexcount, const GLuint *index, Object::Usage usage = Object::Static)
+    :ShapeIndex(size, vertexcount, vertex, indexcount, index, usage)
     {
     }
     
@@ -25,6 +26,6 @@ public:
     virtual void execute() const
     {
         //三角形で描画する
-        glDrawElements(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0, base());
     }
 };
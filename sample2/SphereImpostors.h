@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+
+//GPU 資源の管理
+#include "GpuResources.h"
+
+//シェーダ
+#include "ShaderVariants.h"
+
+/*
+ 球のインポスタ
+
+ 一つの球を視線に向けた一枚の四角形としてインスタンシングでまとめて描画し、
+ フラグメントシェーダ (impostor.frag) で光線と球の交点を求めて正確な輪郭と深度と法線を得る
+ 頂点の数は分割数に依らず球一つにつき四つで、陰影は point.frag と同じ材質と光源を使う
+ シェーダは impostor.vert と impostor.frag から作った ShaderVariants で用意し、
+ uniform 変数は図形と同じように設定してから draw() を呼ぶ
+*/
+class SphereImpostors
+{
+public:
+
+    //インスタンスごとの球
+    struct Sphere
+    {
+        //中心（モデル座標系）
+        GLfloat center[3];
+
+        //半径
+        GLfloat radius;
+
+        //材質の番号
+        GLuint material;
+    };
+
+private:
+
+    //頂点配列オブジェクト、四隅の頂点バッファ、球のバッファ
+    GpuResources::VertexArraySet vao;
+    GpuResources::Buffer corner, instance;
+
+    //描画する球の上限
+    const GLsizei capacity;
+
+    //描画する球の写し
+    std::vector<Sphere> spheres;
+
+    //写しを変更してまだ転送していないか
+    bool dirty;
+
+    //結合されている頂点配列オブジェクトにバッファオブジェクトを結び付ける
+    void setup()
+    {
+        //四角形の四隅（position は ShaderVariants で 0 番に結合されている）
+        glBindBuffer(GL_ARRAY_BUFFER, corner.get());
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+
+        //インスタンスごとの中心と半径（instanceSphere は 9 番）と材質の番号（instanceMaterial は 6 番）
+        glBindBuffer(GL_ARRAY_BUFFER, instance.get());
+        glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof (Sphere), static_cast<Sphere *>(0) -> center);
+        glEnableVertexAttribArray(9);
+        glVertexAttribDivisor(9, 1);
+        glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, sizeof (Sphere), &static_cast<Sphere *>(0) -> material);
+        glEnableVertexAttribArray(6);
+        glVertexAttribDivisor(6, 1);
+    }
+
+public:
+
+    //コンストラクタ
+    //  capacity: 描画する球の上限
+    explicit SphereImpostors(GLsizei capacity)
+    : vao("SphereImpostors")
+    , capacity(capacity)
+    , dirty(false)
+    {
+        GpuResources &resources(GpuResources::instance());
+
+        //四角形の四隅
+        static const GLfloat quad[] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+        corner = resources.acquireBuffer(sizeof quad, GL_STATIC_DRAW, quad, "SphereImpostors");
+
+        //インスタンスごとの球
+        instance = resources.acquireBuffer(capacity * sizeof (Sphere), GL_DYNAMIC_DRAW, NULL, "SphereImpostors");
+        spheres.reserve(capacity);
+
+        //このコンテキストの頂点配列オブジェクトを作っておく
+        vao.bind([this]{ setup(); });
+    }
+
+    //デストラクタ
+    virtual ~SphereImpostors()
+    {
+        //バッファオブジェクトと頂点配列オブジェクトはハンドルが破棄されるときに返却される
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    SphereImpostors(const SphereImpostors &s);
+    //代入によるコピー禁止
+    SphereImpostors &operator = (const SphereImpostors &s);
+
+public:
+
+    //描画する球の数
+    GLsizei size() const { return static_cast<GLsizei>(spheres.size()); }
+
+    //球を追加する
+    //  s: 追加する球
+    //  戻り値: 球の番号（上限に達していたら -1）
+    GLint add(const Sphere &s)
+    {
+        if(size() >= capacity) return -1;
+        spheres.push_back(s);
+        dirty = true;
+        return size() - 1;
+    }
+
+    //球を書き換える
+    //  index: 球の番号
+    //  s: 新しい球
+    void set(GLint index, const Sphere &s)
+    {
+        if(index < 0 || index >= size()) return;
+        spheres[index] = s;
+        dirty = true;
+    }
+
+    //全ての球を取り除く
+    void clear()
+    {
+        spheres.clear();
+        dirty = true;
+    }
+
+    //変更した球をバッファオブジェクトに転送する（全てのウィンドウで共有する）
+    void upload()
+    {
+        if(!dirty) return;
+        dirty = false;
+        if(spheres.empty()) return;
+
+        //頂点配列オブジェクトの記録を変えないように頂点配列オブジェクトが参照しない結合ポイントを使い、
+        //新しい記憶領域に切り替えて描画中のデータを待たない
+        glBindBuffer(GL_COPY_WRITE_BUFFER, instance.get());
+        glBufferData(GL_COPY_WRITE_BUFFER, instance.size(), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, spheres.size() * sizeof (Sphere), spheres.data());
+    }
+
+    //全ての球を一度に描画する（プログラムと共通の uniform 変数は設定しておく）
+    //  v: impostor.vert と impostor.frag から作ったシェーダ
+    //  modelview: モデルビュー変換行列（拡大率は均等なもの）
+    void draw(const ShaderVariants::Variant &v, const GLfloat *modelview)
+    {
+        if(spheres.empty() || v.program == 0) return;
+
+        glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview);
+        vao.bind([this]{ setup(); });
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, size());
+    }
+};
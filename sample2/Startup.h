@@ -0,0 +1,276 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <condition_variable>
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+// 起動の処理の依存関係
+//  ファイルの読み込みや図形データの生成のように GL を使わない処理はワーカースレッドで、
+//  GL を使う処理はメインのスレッド（コンテキストを持つスレッド）で、それぞれ前提の処理が終わったものから実行し、
+//  処理ごとの開始と終了の時刻と最初のフレームを表示するまでの時間を記録する
+//  メインのスレッドで直接行った処理（ウィンドウの作成など）は mark() で区切って記録する
+class Startup
+{
+public:
+
+    //処理を実行するスレッド
+    enum Thread
+    {
+        Worker,     //ワーカースレッド（GL を使わない）
+        Main        //メインのスレッド（run() の中で実行し、GL を使える）
+    };
+
+    //処理の記録
+    struct Phase
+    {
+        //処理の名前
+        std::string name;
+
+        //実行したスレッド
+        Thread thread;
+
+        //起動からの開始と終了の時刻（秒、終わっていなければ終了は負）
+        double start, end;
+    };
+
+private:
+
+    //処理
+    struct Task
+    {
+        //記録
+        Phase phase;
+
+        //実行する関数
+        std::function<void()> function;
+
+        //この処理を前提とする処理
+        std::vector<int> next;
+
+        //終わっていない前提の処理の数
+        int waiting;
+    };
+
+    //起動の処理を実行するワーカースレッド
+    ThreadPool &pool;
+
+    //起動した時刻
+    const std::chrono::steady_clock::time_point origin;
+
+    //処理（番号で参照するので途中に追加しても動かない deque に置く）
+    std::deque<Task> tasks;
+
+    //前提の処理が終わってメインのスレッドで実行を待っている処理
+    std::deque<int> ready;
+
+    //終わっていない処理の数とそのうちワーカースレッドに渡した処理の数
+    int remaining, working;
+
+    //メインのスレッドで最後に終わった処理の終了の時刻（mark() で区切る処理の開始の時刻）
+    double mainEnd;
+
+    //最初のフレームを表示した時刻（まだなら負）
+    double first;
+
+    //tasks, ready, remaining, working の排他制御と処理が終わったことの通知
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+
+    //起動からの時間（秒）
+    double now() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    //前提の処理が終わった処理の実行を始める（ロックした状態で呼ぶ）
+    void dispatch(int id)
+    {
+        if(tasks[id].phase.thread == Main)
+        {
+            ready.push_back(id);
+            changed.notify_all();
+        }
+        else
+        {
+            ++working;
+            pool.submit([this, id]{ execute(id); });
+        }
+    }
+
+    //処理を実行して終わったことを記録する（ロックしていない状態で呼ぶ）
+    void execute(int id)
+    {
+        //処理を追加している間は tasks を参照しない（要素は動かないので取り出した後は触れて良い）
+        Task *t;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            t = &tasks[id];
+        }
+        const double start(now());
+        t -> function();
+        const double end(now());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        t -> phase.start = start;
+        if(t -> phase.thread == Worker) --working;
+        complete(id, end);
+    }
+
+    //処理が終わったことを記録して後の処理を始める（ロックした状態で呼ぶ）
+    void complete(int id, double end)
+    {
+        Task &t(tasks[id]);
+        t.phase.end = end;
+        t.function = nullptr;
+        if(t.phase.thread == Main) mainEnd = std::max(mainEnd, end);
+        for(int n : t.next) if(--tasks[n].waiting == 0) dispatch(n);
+        --remaining;
+        changed.notify_all();
+    }
+
+public:
+
+    //コンストラクタ（起動の時刻を記録するのでできるだけ早く作る）
+    //  pool: ワーカースレッドで実行する処理を渡すスレッド
+    explicit Startup(ThreadPool &pool)
+    : pool(pool)
+    , origin(std::chrono::steady_clock::now())
+    , remaining(0)
+    , working(0)
+    , mainEnd(0.0)
+    , first(-1.0)
+    {
+    }
+
+    //デストラクタ（ワーカースレッドの処理が this に触れなくなるまで待つ）
+    virtual ~Startup()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]{ return working == 0; });
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    Startup(const Startup &s);
+    //代入によるコピー禁止
+    Startup &operator = (const Startup &s);
+
+public:
+
+    //処理を追加する（前提の処理が全て終わっていればすぐに始める）
+    //  name: 処理の名前
+    //  function: 実行する関数
+    //  after: 前提の処理の番号
+    //  thread: 処理を実行するスレッド
+    //  戻り値: 処理の番号
+    int add(const char *name, std::function<void()> function,
+            std::initializer_list<int> after = {}, Thread thread = Worker)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int id(static_cast<int>(tasks.size()));
+        const Task task = { { name, thread, -1.0, -1.0 }, std::move(function), {}, 0 };
+        tasks.push_back(task);
+        for(int a : after)
+        {
+            if(tasks[a].phase.end >= 0.0) continue;
+            tasks[a].next.push_back(id);
+            ++tasks[id].waiting;
+        }
+        ++remaining;
+        if(tasks[id].waiting == 0) dispatch(id);
+        return id;
+    }
+
+    //メインのスレッドで直接行った処理を記録する（前の処理が終わってからここまでを一つの処理とする）
+    //  name: 処理の名前
+    //  戻り値: 処理の番号（この処理を前提とする処理を追加するときに使う）
+    int mark(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int id(static_cast<int>(tasks.size()));
+        const Task task = { { name, Main, mainEnd, -1.0 }, nullptr, {}, 0 };
+        tasks.push_back(task);
+        ++remaining;
+        complete(id, now());
+        return id;
+    }
+
+    //メインのスレッドで実行する処理を前提が終わったものから実行し、全ての処理が終わるまで待つ
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;)
+        {
+            changed.wait(lock, [this]{ return remaining == 0 || !ready.empty(); });
+            if(ready.empty()) return;
+            const int id(ready.front());
+            ready.pop_front();
+
+            lock.unlock();
+            execute(id);
+            lock.lock();
+        }
+    }
+
+    //最初のフレームを表示したことを記録する（二度目からは何もしない）
+    void firstFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(first < 0.0) first = now();
+    }
+
+    //起動から最初のフレームを表示するまでの時間（秒、まだなら負）
+    double getFirstFrame() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return first;
+    }
+
+    //処理の記録（追加した順）
+    std::vector<Phase> getPhases() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Phase> phases;
+        for(const Task &t : tasks) phases.push_back(t.phase);
+        return phases;
+    }
+
+    //処理ごとの開始の時刻と時間を表にして書き出す
+    //  out: 書き出し先
+    void dump(std::ostream &out) const
+    {
+        const std::vector<Phase> phases(getPhases());
+        const std::ios::fmtflags flags(out.flags());
+        const std::streamsize precision(out.precision());
+
+        //処理の時間の合計（全て順に実行したときの時間）と比べて重なりの効果を示す
+        double serial(0.0);
+        out << "Startup (ms):" << std::endl;
+        out << "  " << std::left << std::setw(28) << "phase" << std::setw(8) << "thread" << std::right
+            << std::setw(10) << "start" << std::setw(10) << "time" << std::endl;
+        out << std::fixed << std::setprecision(2);
+        for(const Phase &p : phases)
+        {
+            if(p.end < 0.0) continue;
+            out << "  " << std::left << std::setw(28) << p.name << std::setw(8) << (p.thread == Main ? "main" : "worker")
+                << std::right << std::setw(10) << p.start * 1000.0 << std::setw(10) << (p.end - p.start) * 1000.0 << std::endl;
+            serial += p.end - p.start;
+        }
+        const double firstFrame(getFirstFrame());
+        if(firstFrame >= 0.0) out << "  time to first frame " << firstFrame * 1000.0 << " ms";
+        else out << "  no frame yet";
+        out << " (phases sum " << serial * 1000.0 << " ms)" << std::endl;
+        out.flags(flags);
+        out.precision(precision);
+    }
+};
@@ -0,0 +1,652 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <GL/glew.h>
+
+//インデックスを使った三角形による描画
+#include "SolidShapeIndex.h"
+
+//ビューポートと視錐台
+#include "Viewport.h"
+
+//シェーダ
+#include "ShaderVariants.h"
+
+//ワーカースレッド
+#include "ThreadPool.h"
+
+/*
+ 区画に分けた高さ場の地形
+
+ 地形を xz 平面上の正方形の区画に分け、視点から一定の距離の中にある区画だけを
+ ワーカースレッドで作って決まった数のスロットを持つ一つの頂点バッファに転送する
+ 全ての区画は同じ (cells + 1) × (cells + 1) の格子なので、詳細度 (LOD) ごとのインデックスは
+ 全ての区画で共有し、glDrawElementsBaseVertex の基準の頂点でスロットを選んで描く
+ 詳細度は隣の区画と一段までしか変えず、粗い隣の区画に接する辺の奇数番目の頂点を
+ インデックスの上で偶数番目の頂点に寄せて隙間をふさぐ（辺ごとの有無で 16 通りのインデックスを持つ）
+ したがって詳細度が変わっても頂点は転送し直さず、使うメモリはスロットの数で決まる
+*/
+
+// 区画のスロットを並べた頂点バッファと詳細度ごとのインデックス
+class TerrainShape
+: public SolidShapeIndex
+{
+public:
+
+    //インデックスの範囲
+    struct Range
+    {
+        //先頭の位置と要素数
+        GLsizei first, count;
+    };
+
+    //一つの詳細度あたりの辺のつなぎ方の数（西、東、北、南の辺が粗い隣に接するかの組み合わせ）
+    static constexpr int variants = 16;
+
+private:
+
+    //一つの区画の頂点の数
+    const GLsizei chunkVertices;
+
+    //詳細度と辺のつなぎ方ごとのインデックスの範囲
+    const std::vector<Range> ranges;
+
+    //描画するスロットとインデックスの範囲
+    GLint slot;
+    Range range;
+
+public:
+
+    //コンストラクタ
+    //  cells: 区画の一辺の格子の数
+    //  slots: 区画のスロットの数
+    //  index: 全ての詳細度と辺のつなぎ方のインデックス
+    //  ranges: 詳細度と辺のつなぎ方ごとの index の範囲
+    TerrainShape(int cells, GLsizei slots, const std::vector<GLuint> &index, const std::vector<Range> &ranges)
+    : SolidShapeIndex(3, slots * (cells + 1) * (cells + 1), NULL,
+                      static_cast<GLsizei>(index.size()), index.data(), Object::Dynamic)
+    , chunkVertices((cells + 1) * (cells + 1))
+    , ranges(ranges)
+    , slot(0)
+    , range(ranges[0])
+    {
+    }
+
+    //区画の頂点属性をスロットに転送する
+    //  s: スロットの番号
+    //  vertex: 区画の頂点属性
+    void store(GLint s, const Object::Vertex *vertex)
+    {
+        update(s * chunkVertices, chunkVertices, vertex);
+    }
+
+    //スロットの区画を描画する
+    //  s: スロットの番号
+    //  level: 詳細度
+    //  edges: 粗い隣の区画に接する辺（西 1、東 2、北 4、南 8）
+    //  戻り値: 描画した三角形の数
+    GLsizei drawChunk(GLint s, int level, unsigned int edges)
+    {
+        slot = s;
+        range = ranges[level * variants + (edges & (variants - 1))];
+        draw();
+        return range.count / 3;
+    }
+
+    //描画の実行
+    virtual void execute() const
+    {
+        //インデックスは全ての区画で共有し、基準の頂点でスロットを選ぶ
+        glDrawElementsBaseVertex(GL_TRIANGLES, range.count, GL_UNSIGNED_INT,
+                                 reinterpret_cast<const GLvoid *>(range.first * sizeof (GLuint)),
+                                 base() + slot * chunkVertices);
+    }
+};
+
+// 区画の詳細度と辺のつなぎ方ごとのインデックスを作る
+//  cells: 区画の一辺の格子の数（2 のべき乗）
+//  levels: 詳細度の数（詳細度 l は 2^l 個おきの頂点を使う）
+//  index: インデックスの格納先
+//  ranges: 詳細度と辺のつなぎ方ごとの範囲の格納先
+inline void makeTerrainIndex(int cells, int levels, std::vector<GLuint> &index,
+                             std::vector<TerrainShape::Range> &ranges)
+{
+    for(int level = 0; level < levels; level++)
+    {
+        const int s(1 << level);
+        for(unsigned int edges = 0; edges < TerrainShape::variants; edges++)
+        {
+            //粗い隣の区画に接する辺では奇数番目の頂点を一つ前の頂点に寄せる（一番粗い詳細度に寄せる先はない）
+            const auto vertex([cells, s, edges](int x, int z)
+            {
+                if(s < cells)
+                {
+                    if(((x == 0 && (edges & 1u)) || (x == cells && (edges & 2u))) && z % (2 * s) != 0) z -= s;
+                    if(((z == 0 && (edges & 4u)) || (z == cells && (edges & 8u))) && x % (2 * s) != 0) x -= s;
+                }
+                return static_cast<GLuint>(z * (cells + 1) + x);
+            });
+
+            //寄せて潰れた三角形（面積が 0 のもの）は捨てる
+            const int w(cells + 1);
+            const auto triangle([&index, w](GLuint a, GLuint b, GLuint c)
+            {
+                const int ax(a % w), az(a / w), bx(b % w), bz(b / w), cx(c % w), cz(c / w);
+                if((bz - az) * (cx - ax) != (bx - ax) * (cz - az)) index.insert(index.end(), { a, b, c });
+            });
+
+            const TerrainShape::Range r = { static_cast<GLsizei>(index.size()), 0 };
+            for(int z = 0; z < cells; z += s)
+            {
+                for(int x = 0; x < cells; x += s)
+                {
+                    //格子の四隅（上から見て表が反時計回りになる順に二つの三角形にする）
+                    const GLuint a(vertex(x, z)), b(vertex(x + s, z)), c(vertex(x, z + s)), d(vertex(x + s, z + s));
+                    triangle(a, c, b);
+                    triangle(b, c, d);
+                }
+            }
+            ranges.push_back(r);
+            ranges.back().count = static_cast<GLsizei>(index.size()) - r.first;
+        }
+    }
+}
+
+// 区画に分けて必要な所だけを作る地形
+//  update() で視点の周りの区画の作成を依頼して出来上がったものを転送し、
+//  draw() でビューポートごとに詳細度を選んで視錐台の中の区画を描画する
+class Terrain
+{
+public:
+
+    //ワールド座標系の (x, z) の高さを返す関数（ワーカースレッドから同時に呼ばれる）
+    typedef std::function<GLfloat(GLfloat x, GLfloat z)> Source;
+
+private:
+
+    //区画の番号
+    typedef std::pair<int, int> Key;
+
+    //転送した区画
+    struct Chunk
+    {
+        //スロットの番号
+        GLint slot;
+
+        //ワールド座標系での境界ボックス
+        Bounds bounds;
+
+        //このビューポートでの詳細度
+        int level;
+    };
+
+    //ワーカースレッドで作った区画
+    struct Built
+    {
+        //区画の番号
+        Key key;
+
+        //頂点属性
+        std::vector<Object::Vertex> vertex;
+
+        //ワールド座標系での境界ボックス
+        Bounds bounds;
+    };
+
+    //出来上がった区画の受け渡し（地形が先に破棄されても良いようにワーカースレッドと共有する）
+    struct Mailbox
+    {
+        std::mutex mutex;
+        std::vector<Built> built;
+    };
+
+    //高さ
+    const Source source;
+
+    //区画の一辺の格子の数と格子の間隔
+    const int cells;
+    const GLfloat spacing;
+
+    //詳細度の数
+    const int levels;
+
+    //区画を置いておく距離と詳細度を一段下げる距離
+    const GLfloat range, detail;
+
+    //一フレームで転送する区画の数の上限
+    const int uploads;
+
+    //区画を作るワーカースレッド
+    ThreadPool &pool;
+
+    //区画のスロットを並べた図形
+    std::unique_ptr<TerrainShape> shape;
+
+    //スロットの数と空いているスロット
+    const GLsizei slots;
+    std::vector<GLint> freeSlots;
+
+    //転送した区画と作成を依頼した区画（依頼したときにスロットを取っておく）
+    std::map<Key, Chunk> resident;
+    std::map<Key, GLint> requested;
+
+    //出来上がった区画の受け渡し
+    const std::shared_ptr<Mailbox> mailbox;
+
+    //転送した区画の数の累計
+    unsigned long uploaded;
+
+    //区画の一辺の長さ
+    GLfloat extent() const { return cells * spacing; }
+
+    //xz 平面での点から区画までの距離
+    GLfloat distance(const Key &k, GLfloat x, GLfloat z) const
+    {
+        const GLfloat e(extent());
+        const GLfloat dx(std::max(std::max(k.first * e - x, x - (k.first + 1) * e), 0.0f));
+        const GLfloat dz(std::max(std::max(k.second * e - z, z - (k.second + 1) * e), 0.0f));
+        return sqrtf(dx * dx + dz * dz);
+    }
+
+    //区画の頂点属性を作る（ワーカースレッドで実行する）
+    //  source: 高さ
+    //  cells: 区画の一辺の格子の数
+    //  spacing: 格子の間隔
+    //  key: 区画の番号
+    static Built build(const Source &source, int cells, GLfloat spacing, const Key &key)
+    {
+        Built b;
+        b.key = key;
+
+        //法線を求めるために周りに一つずつ広げて高さを求める（隣の区画と辺の法線が一致する）
+        const int n(cells + 3);
+        const GLfloat ox(key.first * cells * spacing), oz(key.second * cells * spacing);
+        std::vector<GLfloat> height(n * n);
+        for(int j = 0; j < n; j++)
+            for(int i = 0; i < n; i++)
+                height[j * n + i] = source(ox + (i - 1) * spacing, oz + (j - 1) * spacing);
+
+        //頂点の位置は区画の隅を原点にする（遠くの区画でも精度を落とさない）
+        b.vertex.reserve((cells + 1) * (cells + 1));
+        GLfloat lo(height[n + 1]), hi(lo);
+        for(int j = 1; j <= cells + 1; j++)
+        {
+            for(int i = 1; i <= cells + 1; i++)
+            {
+                const GLfloat h(height[j * n + i]);
+                const GLfloat nx(height[j * n + i - 1] - height[j * n + i + 1]);
+                const GLfloat nz(height[(j - 1) * n + i] - height[(j + 1) * n + i]);
+                const GLfloat ny(2.0f * spacing);
+                const GLfloat r(1.0f / sqrtf(nx * nx + ny * ny + nz * nz));
+                const Object::Vertex v =
+                {
+                    { (i - 1) * spacing, h, (j - 1) * spacing },
+                    { nx * r, ny * r, nz * r }
+                };
+                b.vertex.emplace_back(v);
+                lo = std::min(lo, h);
+                hi = std::max(hi, h);
+            }
+        }
+
+        const GLfloat e(cells * spacing);
+        const GLfloat corner[][3] = { { ox, lo, oz }, { ox + e, hi, oz + e } };
+        b.bounds.extend(corner[0]);
+        b.bounds.extend(corner[1]);
+        return b;
+    }
+
+    //区画を取り除いてスロットを空ける
+    void evict(std::map<Key, Chunk>::iterator i)
+    {
+        freeSlots.push_back(i -> second.slot);
+        resident.erase(i);
+    }
+
+public:
+
+    //コンストラクタ
+    //  source: 高さ
+    //  pool: 区画を作るワーカースレッド
+    //  cells: 区画の一辺の格子の数（2 のべき乗）
+    //  spacing: 格子の間隔
+    //  range: 区画を置いておく視点からの距離
+    //  detail: 詳細度を一段下げる距離（この距離までは一番細かく、その倍ごとに一段下げる）
+    //  slots: 区画のスロットの数（使うメモリの上限を決める）
+    //  uploads: 一フレームで転送する区画の数の上限
+    Terrain(const Source &source, ThreadPool &pool, int cells, GLfloat spacing, GLfloat range, GLfloat detail,
+            GLsizei slots, int uploads = 4)
+    : source(source)
+    , cells(cells)
+    , spacing(spacing)
+    , levels(static_cast<int>(log2f(static_cast<GLfloat>(cells))) + 1)
+    , range(range)
+    , detail(detail)
+    , uploads(uploads)
+    , pool(pool)
+    , slots(slots)
+    , mailbox(std::make_shared<Mailbox>())
+    , uploaded(0)
+    {
+        std::vector<GLuint> index;
+        std::vector<TerrainShape::Range> ranges;
+        makeTerrainIndex(cells, levels, index, ranges);
+        shape.reset(new TerrainShape(cells, slots, index, ranges));
+        for(GLint s = slots - 1; s >= 0; s--) freeSlots.push_back(s);
+    }
+
+    //デストラクタ（作成中の区画は受け渡しの場所ごと捨てる）
+    virtual ~Terrain()
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    Terrain(const Terrain &t);
+    //代入によるコピー禁止
+    Terrain &operator = (const Terrain &t);
+
+public:
+
+    //出来上がった区画を転送し、視点の周りの足りない区画の作成を近い順に依頼する（描画のスレッドで呼ぶ）
+    //  eye: ワールド座標系での視点の位置
+    void update(const GLfloat *eye)
+    {
+        const GLfloat x(eye[0]), z(eye[2]);
+
+        //出来上がった区画を上限まで取り出す
+        std::vector<Built> arrived;
+        {
+            std::lock_guard<std::mutex> lock(mailbox -> mutex);
+            const std::size_t count(std::min(mailbox -> built.size(), static_cast<std::size_t>(uploads)));
+            std::move(mailbox -> built.begin(), mailbox -> built.begin() + count, std::back_inserter(arrived));
+            mailbox -> built.erase(mailbox -> built.begin(), mailbox -> built.begin() + count);
+        }
+
+        //依頼したときに取っておいたスロットに転送する（もう要らなければスロットを返す）
+        for(Built &b : arrived)
+        {
+            const auto r(requested.find(b.key));
+            if(r == requested.end()) continue;
+            const GLint slot(r -> second);
+            requested.erase(r);
+            if(distance(b.key, x, z) > range + extent())
+            {
+                freeSlots.push_back(slot);
+                continue;
+            }
+            shape -> store(slot, b.vertex.data());
+            const Chunk c = { slot, b.bounds, 0 };
+            resident[b.key] = c;
+            ++uploaded;
+        }
+
+        //遠ざかった区画を取り除く（行き来で作り直さないように一区画分の余裕を持たせる）
+        for(auto i = resident.begin(); i != resident.end();)
+        {
+            const auto next(std::next(i));
+            if(distance(i -> first, x, z) > range + extent()) evict(i);
+            i = next;
+        }
+
+        //範囲の中の足りない区画を近い順に並べる
+        const GLfloat e(extent());
+        const int x0(static_cast<int>(floorf((x - range) / e))), x1(static_cast<int>(floorf((x + range) / e)));
+        const int z0(static_cast<int>(floorf((z - range) / e))), z1(static_cast<int>(floorf((z + range) / e)));
+        std::vector<std::pair<GLfloat, Key>> missing;
+        for(int j = z0; j <= z1; j++)
+        {
+            for(int i = x0; i <= x1; i++)
+            {
+                const Key k(i, j);
+                const GLfloat d(distance(k, x, z));
+                if(d <= range && resident.count(k) == 0 && requested.count(k) == 0) missing.emplace_back(d, k);
+            }
+        }
+        std::sort(missing.begin(), missing.end());
+
+        //作成中の区画は転送の上限の数倍までにして、スロットが足りなければ一番遠い区画と入れ替える
+        const std::size_t inflight(static_cast<std::size_t>(uploads) * 4);
+        for(const auto &m : missing)
+        {
+            if(requested.size() >= inflight) break;
+            if(freeSlots.empty())
+            {
+                auto farthest(resident.end());
+                GLfloat longest(m.first);
+                for(auto i = resident.begin(); i != resident.end(); ++i)
+                {
+                    const GLfloat d(distance(i -> first, x, z));
+                    if(d > longest)
+                    {
+                        longest = d;
+                        farthest = i;
+                    }
+                }
+                if(farthest == resident.end()) break;
+                evict(farthest);
+            }
+            requested[m.second] = freeSlots.back();
+            freeSlots.pop_back();
+
+            //ワーカースレッドは地形そのものに触れない
+            const std::shared_ptr<Mailbox> box(mailbox);
+            const Source heights(source);
+            const int n(cells);
+            const GLfloat h(spacing);
+            const Key key(m.second);
+            pool.submit([box, heights, n, h, key]
+            {
+                Built b(build(heights, n, h, key));
+                std::lock_guard<std::mutex> lock(box -> mutex);
+                box -> built.push_back(std::move(b));
+            });
+        }
+    }
+
+    //視錐台の中の区画を描画する（プログラムと共通の uniform 変数、材質は設定しておく）
+    //  viewport: 描画するビューポート（apply() しておく）
+    //  v: 図形のシェーダ
+    //  戻り値: 描画した三角形の数
+    GLsizei draw(const Viewport &viewport, const ShaderVariants::Variant &v)
+    {
+        if(resident.empty() || v.program == 0) return 0;
+
+        //視点の位置
+        const Transform &view(viewport.getView());
+        const Vector eye(view.inverse() * Vector{ 0.0f, 0.0f, 0.0f, 1.0f });
+
+        //視点から境界ボックスまでの距離で詳細度を選ぶ
+        for(auto &r : resident)
+        {
+            const Bounds &b(r.second.bounds);
+            GLfloat d2(0.0f);
+            for(int i = 0; i < 3; i++)
+            {
+                const GLfloat d(std::max(std::max(b.lo[i] - eye[i], eye[i] - b.hi[i]), 0.0f));
+                d2 += d * d;
+            }
+            const GLfloat d(sqrtf(d2));
+            r.second.level = d < detail ? 0 : std::min(levels - 1, static_cast<int>(log2f(d / detail)) + 1);
+        }
+
+        //隣の区画と詳細度が二段以上離れないように細かい方に合わせる（詳細度は下がるだけなので止まる）
+        static const int offset[][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for(bool changed(true); changed;)
+        {
+            changed = false;
+            for(auto &r : resident)
+            {
+                for(const int *o : offset)
+                {
+                    const auto n(resident.find(Key(r.first.first + o[0], r.first.second + o[1])));
+                    if(n != resident.end() && r.second.level > n -> second.level + 1)
+                    {
+                        r.second.level = n -> second.level + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        //区画は平行移動だけなので法線ベクトルの変換行列は共通
+        GLfloat normalMatrix[9];
+        view.getNormalMatrix(normalMatrix);
+        glUniformMatrix3fv(v.normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+
+        GLsizei triangles(0);
+        const GLfloat e(extent());
+        for(const auto &r : resident)
+        {
+            const Chunk &c(r.second);
+            if(!viewport.visible(c.bounds)) continue;
+
+            //粗い隣の区画に接する辺
+            unsigned int edges(0);
+            for(int i = 0; i < 4; i++)
+            {
+                const auto n(resident.find(Key(r.first.first + offset[i][0], r.first.second + offset[i][1])));
+                if(n != resident.end() && n -> second.level > c.level) edges |= 1u << i;
+            }
+
+            const Transform modelview(view * Transform::translate(r.first.first * e, 0.0f, r.first.second * e));
+            glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview.toMatrix().data());
+            triangles += shape -> drawChunk(c.slot, c.level, edges);
+        }
+        return triangles;
+    }
+
+    //転送した区画の数
+    GLsizei getResident() const { return static_cast<GLsizei>(resident.size()); }
+
+    //作成中の区画の数
+    GLsizei getPending() const { return static_cast<GLsizei>(requested.size()); }
+
+    //転送した区画の数の累計
+    unsigned long getUploaded() const { return uploaded; }
+
+    //スロットの数
+    GLsizei getSlots() const { return slots; }
+
+    //スロットの頂点バッファの大きさ（バイト）
+    GLsizeiptr getBytes() const
+    {
+        return static_cast<GLsizeiptr>(slots) * (cells + 1) * (cells + 1) * sizeof (Object::Vertex);
+    }
+};
+
+// 格子状に並べた 16 ビットの高さのファイルから読み込んだ高さ場
+//  範囲の外は端の値を使い、間は双線形補間する
+class Heightfield
+{
+    //一辺の標本の数
+    int width, depth;
+
+    //標本の間隔と高さの倍率
+    GLfloat spacing, scale;
+
+    //標本
+    std::vector<std::uint16_t> sample;
+
+    //標本の高さ（範囲の外は端の値）
+    GLfloat at(int i, int j) const
+    {
+        i = std::max(0, std::min(width - 1, i));
+        j = std::max(0, std::min(depth - 1, j));
+        return sample[j * width + i] * scale;
+    }
+
+public:
+
+    //コンストラクタ
+    //  spacing: 標本の間隔
+    //  scale: 標本の値 1 あたりの高さ
+    Heightfield(GLfloat spacing = 1.0f, GLfloat scale = 1.0f)
+    : width(0)
+    , depth(0)
+    , spacing(spacing)
+    , scale(scale)
+    {
+    }
+
+    //リトルエンディアンの 16 ビットの標本を x が速く変わる順に並べたファイルを読み込む
+    //  name: ファイル名
+    //  w, d: x 方向と z 方向の標本の数
+    bool load(const char *name, int w, int d)
+    {
+        std::ifstream file(name, std::ios::binary);
+        if(file.fail())
+        {
+            std::cerr << "Error: Can't open heightfield file: " << name << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> bytes(static_cast<std::size_t>(w) * d * 2);
+        if(!file.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+        {
+            std::cerr << "Error: Heightfield file is too short: " << name << std::endl;
+            return false;
+        }
+        sample.resize(static_cast<std::size_t>(w) * d);
+        for(std::size_t i = 0; i < sample.size(); i++)
+            sample[i] = static_cast<std::uint16_t>(bytes[i * 2] | bytes[i * 2 + 1] << 8);
+        width = w;
+        depth = d;
+        return true;
+    }
+
+    //ワールド座標系の (x, z) の高さ
+    GLfloat operator()(GLfloat x, GLfloat z) const
+    {
+        if(sample.empty()) return 0.0f;
+        const GLfloat u(x / spacing), v(z / spacing);
+        const int i(static_cast<int>(floorf(u))), j(static_cast<int>(floorf(v)));
+        const GLfloat s(u - i), t(v - j);
+        return (at(i, j) * (1.0f - s) + at(i + 1, j) * s) * (1.0f - t)
+             + (at(i, j + 1) * (1.0f - s) + at(i + 1, j + 1) * s) * t;
+    }
+};
+
+// 格子点の乱数を滑らかに補間した値を重ねた起伏の高さ
+//  x, z: ワールド座標系の位置
+//  amplitude: 一番大きな起伏の高さ
+//  wavelength: 一番大きな起伏の波長
+//  octaves: 重ねる数（一つ重ねるごとに波長と高さを半分にする）
+//  seed: 乱数の種
+inline GLfloat fractalHeight(GLfloat x, GLfloat z, GLfloat amplitude, GLfloat wavelength, int octaves,
+                             unsigned int seed = 1)
+{
+    //格子点の乱数（-1 ～ 1）
+    const auto lattice([seed](int i, int j)
+    {
+        unsigned int h(static_cast<unsigned int>(i) * 374761393u + static_cast<unsigned int>(j) * 668265263u
+                       + seed * 2246822519u);
+        h = (h ^ (h >> 13)) * 1274126177u;
+        h ^= h >> 16;
+        return static_cast<GLfloat>(h & 0xffffffu) / 8388607.5f - 1.0f;
+    });
+
+    GLfloat height(0.0f), a(amplitude), f(1.0f / wavelength);
+    for(int o = 0; o < octaves; o++)
+    {
+        const GLfloat u(x * f), v(z * f);
+        const int i(static_cast<int>(floorf(u))), j(static_cast<int>(floorf(v)));
+        GLfloat s(u - i), t(v - j);
+        s = s * s * (3.0f - 2.0f * s);
+        t = t * t * (3.0f - 2.0f * t);
+        height += a * ((lattice(i, j) * (1.0f - s) + lattice(i + 1, j) * s) * (1.0f - t)
+                     + (lattice(i, j + 1) * (1.0f - s) + lattice(i + 1, j + 1) * s) * t);
+        a *= 0.5f;
+        f *= 2.0f;
+    }
+    return height;
+}
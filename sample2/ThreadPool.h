@@ -0,0 +1,175 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+// ワーカースレッドの集まり
+//  submit() で渡した処理を空いているスレッドで実行する
+//  parallelFor() は範囲を分けて呼び出したスレッドも含めて並列に処理し、終わるまで待つ
+class ThreadPool
+{
+    //ワーカースレッド
+    std::vector<std::thread> workers;
+
+    //実行を待っている処理
+    std::deque<std::function<void()>> tasks;
+
+    //実行中の処理の数
+    unsigned int busy;
+
+    //スレッドを止めるか
+    bool stopping;
+
+    //tasks, busy, stopping の排他制御
+    std::mutex mutex;
+
+    //処理が追加されたことと全ての処理が終わったことの通知
+    std::condition_variable wake, idle;
+
+    //ワーカースレッドの処理
+    void run()
+    {
+        for(;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]{ return stopping || !tasks.empty(); });
+                if(tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                ++busy;
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--busy == 0 && tasks.empty()) idle.notify_all();
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  threads: ワーカースレッドの数（0 ならハードウェアのスレッド数 - 1）
+    explicit ThreadPool(unsigned int threads = 0)
+    : busy(0), stopping(false)
+    {
+        if(threads == 0)
+        {
+            const unsigned int hardware(std::thread::hardware_concurrency());
+            threads = hardware > 1 ? hardware - 1 : 1;
+        }
+        for(unsigned int i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::run, this);
+    }
+
+    //デストラクタ（残っている処理を全て実行してから止める）
+    virtual ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread &t : workers) t.join();
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    ThreadPool(const ThreadPool &p);
+    //代入によるコピー禁止
+    ThreadPool &operator = (const ThreadPool &p);
+
+public:
+
+    //ワーカースレッドの数
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    //処理を追加する
+    //  task: 空いているワーカースレッドで実行する処理
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    //追加した処理が全て終わるまで待つ
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]{ return busy == 0 && tasks.empty(); });
+    }
+
+    //[0, count) を grain 個ずつに分けて並列に処理する
+    //  count: 処理する要素の数
+    //  grain: 一度に処理する要素の数
+    //  f: [begin, end) の要素を処理する関数 f(begin, end)
+    template <typename F>
+    void parallelFor(std::size_t count, std::size_t grain, F f)
+    {
+        if(count == 0) return;
+        grain = std::max<std::size_t>(grain, 1);
+        const std::size_t chunks((count + grain - 1) / grain);
+
+        //分けるほどの量がなければこのスレッドで処理する
+        if(chunks == 1 || workers.empty())
+        {
+            f(static_cast<std::size_t>(0), count);
+            return;
+        }
+
+        //塊の分担の状態（遅れて始まったワーカーが戻った後に触れても良いように共有する）
+        struct State
+        {
+            //まだ処理していない塊の番号
+            std::atomic<std::size_t> next;
+
+            //終わっていない塊の数
+            std::size_t remaining;
+
+            //remaining の排他制御と全ての塊が終わったことの通知
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        const std::shared_ptr<State> state(std::make_shared<State>());
+        state->next = 0;
+        state->remaining = chunks;
+        const F *const function(&f);
+
+        //塊を一つずつ取り出して処理する（全て取り出された後は f に触れずに戻る）
+        const auto work([state, function, chunks, grain, count]()
+        {
+            std::size_t processed(0);
+            for(std::size_t c; (c = state->next.fetch_add(1)) < chunks; ++processed)
+            {
+                const std::size_t begin(c * grain);
+                (*function)(begin, std::min(begin + grain, count));
+            }
+
+            if(processed > 0)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if((state->remaining -= processed) == 0) state->done.notify_one();
+            }
+        });
+
+        //ワーカースレッドと呼び出したスレッドで分担する
+        const std::size_t helpers(std::min<std::size_t>(workers.size(), chunks - 1));
+        for(std::size_t i = 0; i < helpers; i++) submit(work);
+        work();
+
+        //全ての塊が終わるまで待つ
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]{ return state->remaining == 0; });
+    }
+};
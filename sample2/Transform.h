@@ -0,0 +1,456 @@
+#pragma once
+#include <cmath>
+#include <GL/glew.h>
+
+//変換行列
+#include "Matrix.h"
+
+//ベクトル
+#include "Vector.h"
+
+/*
+ アフィン変換行列
+
+ 平行移動・拡大縮小・回転・ビュー変換は 4 行目が (0, 0, 0, 1) のアフィン変換なので
+ 3 行 4 列だけを持てば足りる
+   Transform 同士の乗算 36 回の乗算と 27 回の加算（Matrix は 64 回と 48 回）
+ さらに translate などは平行移動や回転だけを持つ軽い式として返し、
+ view * translate * rotate のような連鎖は一つの変数に右から順にかけるだけで求める
+   translate をかける 9 回の乗算、scale をかける 9 回の乗算、rotate をかける 27 回の乗算
+ 全て constexpr なので、定数の引数から作る変換は実行前に求まる
+*/
+
+// 定数式でも使える平方根
+//  v: 平方根を求める値
+constexpr GLfloat constSqrt(GLfloat v)
+{
+    if(!(v > 0.0f)) return 0.0f;
+
+    //ニュートン法（上から単調に近づくので値が変わらなくなったら終わり）
+    double x(v > 1.0f ? v : 1.0), prev(0.0);
+    for(int i = 0; i < 128 && x != prev; i++)
+    {
+        prev = x;
+        x = 0.5 * (x + v / x);
+    }
+    return static_cast<GLfloat>(x);
+}
+
+class Transform;
+
+// アフィン変換の式（Transform, Translation, Scaling, Rotation とその積）
+//  assignTo(t): t にこの式の値を入れる
+//  multiply(t): t に右からこの式をかける
+template <typename E>
+struct AffineExpr
+{
+    constexpr const E &self() const { return static_cast<const E &>(*this); }
+};
+
+// アフィン変換の式の積（値は Transform に代入したときに求める）
+template <typename L, typename R>
+class Product
+: public AffineExpr<Product<L, R> >
+{
+    //左の式と右の式
+    const L l;
+    const R r;
+
+public:
+
+    //コンストラクタ
+    constexpr Product(const L &l, const R &r)
+    : l(l), r(r)
+    {
+    }
+
+    //t にこの式の値を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        l.assignTo(t);
+        r.multiply(t);
+    }
+
+    //t に右からこの式をかける
+    constexpr void multiply(Transform &t) const
+    {
+        l.multiply(t);
+        r.multiply(t);
+    }
+};
+
+// アフィン変換の式の積を作る
+template <typename L, typename R>
+constexpr Product<L, R> operator*(const AffineExpr<L> &l, const AffineExpr<R> &r)
+{
+    return Product<L, R>(l.self(), r.self());
+}
+
+// アフィン変換行列（列優先の 3 行 4 列、4 行目は (0, 0, 0, 1)）
+class Transform
+: public AffineExpr<Transform>
+{
+    //変換行列の要素（m[0..2], m[3..5], m[6..8] は 1〜3 列目、m[9..11] は平行移動）
+    GLfloat m[12];
+
+public:
+
+    //コンストラクタ（単位行列）
+    constexpr Transform()
+    : m{ 1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 0.0f, 0.0f }
+    {
+    }
+
+    //アフィン変換の式の値で初期化するコンストラクタ
+    template <typename E>
+    constexpr Transform(const AffineExpr<E> &e)
+    : m{}
+    {
+        e.self().assignTo(*this);
+    }
+
+    //アフィン変換の式の値を代入する
+    template <typename E>
+    constexpr Transform &operator=(const AffineExpr<E> &e)
+    {
+        Transform t;
+        e.self().assignTo(t);
+        return *this = t;
+    }
+
+    //変換行列の要素を返す
+    constexpr GLfloat operator[](int i) const { return m[i]; }
+    constexpr GLfloat &operator[](int i) { return m[i]; }
+
+    //変換行列の配列を返す
+    const GLfloat *data() const { return m; }
+
+    //t にこの行列を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        t = *this;
+    }
+
+    //t に右からこの行列をかける
+    constexpr void multiply(Transform &t) const
+    {
+        const Transform a(t);
+
+        //左上 3x3 の積
+        for(int j = 0; j < 9; j += 3)
+        {
+            for(int i = 0; i < 3; i++)
+            {
+                t.m[j + i] = a.m[i] * m[j] + a.m[3 + i] * m[j + 1] + a.m[6 + i] * m[j + 2];
+            }
+        }
+
+        //平行移動 = 左の 3x3 × 右の平行移動 + 左の平行移動
+        for(int i = 0; i < 3; i++)
+        {
+            t.m[9 + i] = a.m[i] * m[9] + a.m[3 + i] * m[10] + a.m[6 + i] * m[11] + a.m[9 + i];
+        }
+    }
+
+    //4x4 の変換行列に変換する（uniform 変数に送るとき）
+    constexpr Matrix toMatrix() const
+    {
+        Matrix t((Matrix::Zero()));
+        for(int j = 0; j < 4; j++)
+        {
+            for(int i = 0; i < 3; i++) t[j * 4 + i] = m[j * 3 + i];
+        }
+        t[15] = 1.0f;
+        return t;
+    }
+
+    //法線ベクトルの変換行列を求める（Matrix::getNormalMatrix と同じく行列式では割らない）
+    constexpr void getNormalMatrix(GLfloat *n) const
+    {
+        cofactor(m, m + 3, m + 6, n);
+    }
+
+    //行列式を求める
+    constexpr GLfloat determinant() const
+    {
+        // 1列目・(2列目 × 3列目)
+        return m[0] * (m[4] * m[8] - m[5] * m[7])
+             + m[1] * (m[5] * m[6] - m[3] * m[8])
+             + m[2] * (m[3] * m[7] - m[4] * m[6]);
+    }
+
+    //逆行列を求める（行列式が0なら単位行列を返す）
+    constexpr Transform inverse() const
+    {
+        //余因子行列は法線ベクトルの変換行列と同じもので、その転置を行列式で割ると 3x3 の逆行列
+        GLfloat c[9] = {};
+        cofactor(m, m + 3, m + 6, c);
+        const GLfloat det(m[0] * c[0] + m[1] * c[1] + m[2] * c[2]);
+
+        Transform t;
+        if(det == 0.0f) return t;
+
+        const GLfloat r(1.0f / det);
+        for(int j = 0; j < 3; j++)
+        {
+            for(int i = 0; i < 3; i++) t.m[j * 3 + i] = c[i * 3 + j] * r;
+        }
+
+        //平行移動 = -(3x3 の逆行列 × 平行移動)
+        for(int i = 0; i < 3; i++)
+        {
+            t.m[9 + i] = -(t.m[i] * m[9] + t.m[3 + i] * m[10] + t.m[6 + i] * m[11]);
+        }
+        return t;
+    }
+
+    //単位行列を作成する
+    static constexpr Transform identity()
+    {
+        return Transform();
+    }
+
+    // (x,y,z)だけ平行移動する変換行列を作成する
+    static constexpr class Translation translate(GLfloat x, GLfloat y, GLfloat z);
+
+    // (x,y,z)倍に拡大縮小する変換行列を作成する
+    static constexpr class Scaling scale(GLfloat x, GLfloat y, GLfloat z);
+
+    //(x,y,z)を軸にa回転する行列を作成する
+    static class Rotation rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z);
+
+    //ビュー変換行列を作成する（定数の引数なら実行前に求まる）
+    static constexpr Transform lookat(
+        GLfloat ex, GLfloat ey, GLfloat ez,   //視点の位置
+        GLfloat gx, GLfloat gy, GLfloat gz,   //目標点の位置
+        GLfloat ux, GLfloat uy, GLfloat uz)   //上方向のベクトル
+    {
+        Transform v;
+
+        // t軸 = e - g
+        const GLfloat tx(ex - gx);
+        const GLfloat ty(ey - gy);
+        const GLfloat tz(ez - gz);
+
+        // r軸 = u軸 × t 軸
+        const GLfloat rx(uy * tz - uz * ty);
+        const GLfloat ry(uz * tx - ux * tz);
+        const GLfloat rz(ux * ty - uy * tx);
+
+        // s軸 = t 軸　× r 軸
+        const GLfloat sx(ty * rz - tz * ry);
+        const GLfloat sy(tz * rx - tx * rz);
+        const GLfloat sz(tx * ry - ty * rx);
+
+        // s軸の長さが0なら平行移動だけ
+        const GLfloat s2(sx * sx + sy * sy + sz * sz);
+        if(s2 != 0.0f)
+        {
+            // r軸、s軸、t軸を正規化して行に格納する
+            const GLfloat r(constSqrt(rx * rx + ry * ry + rz * rz));
+            const GLfloat s(constSqrt(s2));
+            const GLfloat t(constSqrt(tx * tx + ty * ty + tz * tz));
+            v.m[0] = rx / r; v.m[3] = ry / r; v.m[6] = rz / r;
+            v.m[1] = sx / s; v.m[4] = sy / s; v.m[7] = sz / s;
+            v.m[2] = tx / t; v.m[5] = ty / t; v.m[8] = tz / t;
+        }
+
+        // 回転 × 視点の平行移動 の平行移動成分 = -(回転 × 視点の位置)
+        for(int i = 0; i < 3; i++)
+        {
+            v.m[9 + i] = -(v.m[i] * ex + v.m[3 + i] * ey + v.m[6 + i] * ez);
+        }
+        return v;
+    }
+};
+
+// 平行移動だけのアフィン変換
+class Translation
+: public AffineExpr<Translation>
+{
+    //移動量
+    GLfloat x, y, z;
+
+public:
+
+    //コンストラクタ
+    constexpr Translation(GLfloat x, GLfloat y, GLfloat z)
+    : x(x), y(y), z(z)
+    {
+    }
+
+    //移動量を返す
+    constexpr GLfloat operator[](int i) const { return i == 0 ? x : i == 1 ? y : z; }
+
+    //t にこの変換を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        t = Transform();
+        t[ 9] = x;
+        t[10] = y;
+        t[11] = z;
+    }
+
+    //t に右からこの変換をかける（t の平行移動に t の 3x3 × 移動量を足すだけ）
+    constexpr void multiply(Transform &t) const
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            t[9 + i] += t[i] * x + t[3 + i] * y + t[6 + i] * z;
+        }
+    }
+};
+
+// 拡大縮小だけのアフィン変換
+class Scaling
+: public AffineExpr<Scaling>
+{
+    //拡大率
+    GLfloat x, y, z;
+
+public:
+
+    //コンストラクタ
+    constexpr Scaling(GLfloat x, GLfloat y, GLfloat z)
+    : x(x), y(y), z(z)
+    {
+    }
+
+    //t にこの変換を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        t = Transform();
+        t[0] = x;
+        t[4] = y;
+        t[8] = z;
+    }
+
+    //t に右からこの変換をかける（t の 1〜3 列目を拡大率倍するだけ）
+    constexpr void multiply(Transform &t) const
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            t[i] *= x;
+            t[3 + i] *= y;
+            t[6 + i] *= z;
+        }
+    }
+};
+
+// 回転だけのアフィン変換
+class Rotation
+: public AffineExpr<Rotation>
+{
+    //回転の 3x3 行列（列優先）
+    GLfloat r[9];
+
+public:
+
+    //コンストラクタ
+    //  c, s: 回転角の余弦と正弦
+    //  x, y, z: 回転軸
+    constexpr Rotation(GLfloat c, GLfloat s, GLfloat x, GLfloat y, GLfloat z)
+    : r{ 1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f, 1.0f }
+    {
+        const GLfloat d(constSqrt(x * x + y * y + z * z));
+
+        if(d > 0.0f)
+        {
+            const GLfloat l(x / d), m(y / d), n(z / d);
+            const GLfloat l2(l * l), m2(m * m), n2(n * n);
+            const GLfloat lm(l * m), mn(m * n), nl(n * l);
+            const GLfloat c1(1.0f - c);
+
+            r[0] = (1.0f - l2) * c + l2;
+            r[1] = lm * c1 + n * s;
+            r[2] = nl * c1 - m * s;
+            r[3] = lm * c1 - n * s;
+            r[4] = (1.0f - m2) * c + m2;
+            r[5] = mn * c1 + l * s;
+            r[6] = nl * c1 + m * s;
+            r[7] = mn * c1 - l * s;
+            r[8] = (1.0f - n2) * c + n2;
+        }
+    }
+
+    //3x3 の回転行列から作るコンストラクタ
+    //  m: 列優先の 9 要素の行列
+    constexpr explicit Rotation(const GLfloat *m)
+    : r{}
+    {
+        for(int i = 0; i < 9; i++) r[i] = m[i];
+    }
+
+    //t にこの変換を入れる
+    constexpr void assignTo(Transform &t) const
+    {
+        t = Transform();
+        for(int i = 0; i < 9; i++) t[i] = r[i];
+    }
+
+    //t に右からこの変換をかける（平行移動は変わらない）
+    constexpr void multiply(Transform &t) const
+    {
+        const Transform a(t);
+        for(int j = 0; j < 9; j += 3)
+        {
+            for(int i = 0; i < 3; i++)
+            {
+                t[j + i] = a[i] * r[j] + a[3 + i] * r[j + 1] + a[6 + i] * r[j + 2];
+            }
+        }
+    }
+};
+
+// (x,y,z)だけ平行移動する変換行列を作成する
+constexpr Translation Transform::translate(GLfloat x, GLfloat y, GLfloat z)
+{
+    return Translation(x, y, z);
+}
+
+// (x,y,z)倍に拡大縮小する変換行列を作成する
+constexpr Scaling Transform::scale(GLfloat x, GLfloat y, GLfloat z)
+{
+    return Scaling(x, y, z);
+}
+
+//(x,y,z)を軸にa回転する行列を作成する
+inline Rotation Transform::rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
+{
+    return Rotation(cos(a), sin(a), x, y, z);
+}
+
+// 4x4 の変換行列とアフィン変換行列の乗算（投影変換行列 × モデルビュー変換行列）
+//  4 行目が (0, 0, 0, 1) なので 48 回の乗算で済む
+template <typename E>
+constexpr Matrix operator*(const Matrix &p, const AffineExpr<E> &e)
+{
+    const Transform a(e);
+    Matrix t((Matrix::Zero()));
+
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            t[j * 4 + i] = p[i] * a[j * 3] + p[4 + i] * a[j * 3 + 1] + p[8 + i] * a[j * 3 + 2];
+        }
+        t[12 + i] = p[i] * a[9] + p[4 + i] * a[10] + p[8 + i] * a[11] + p[12 + i];
+    }
+    return t;
+}
+
+// アフィン変換行列とベクトルの乗算
+//  m: Transform 型の行列
+//  v: Vector 型のベクトル
+inline Vector operator*(const Transform &m, const Vector &v)
+{
+    Vector t;
+
+    for(int i = 0; i < 3; i++)
+    {
+        t[i] = m[i] * v[0] + m[3 + i] * v[1] + m[6 + i] * v[2] + m[9 + i] * v[3];
+    }
+    t[3] = v[3];
+
+    return t;
+}
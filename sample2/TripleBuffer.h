@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+
+// 一つのスレッドが書き込み別の一つのスレッドが読み出すロックフリーのトリプルバッファ
+//  書き込み側と読み出し側はお互いを待たず、読み出し側は常に最新の完成したデータを得る
+template <typename T>
+class TripleBuffer
+{
+    //新しいデータが中間のバッファに置かれていることを示すビット
+    static constexpr unsigned int fresh = 4;
+
+    //三つのバッファ（書き込み中、中間、読み出し中）
+    T buffer[3];
+
+    //中間のバッファの位置（下位2ビット）と新しいデータがあるか（fresh）
+    alignas(64) std::atomic<unsigned int> middle;
+
+    //書き込み側が使うバッファの位置
+    alignas(64) unsigned int back;
+
+    //読み出し側が使うバッファの位置
+    alignas(64) unsigned int front;
+
+public:
+
+    //コンストラクタ
+    //  initial: 三つのバッファの初期値
+    TripleBuffer(const T &initial = T())
+    : buffer{ initial, initial, initial }, middle(1), back(0), front(2)
+    {
+    }
+
+private:
+    //コピーコンストラクタによるコピー禁止
+    TripleBuffer(const TripleBuffer &b);
+    //代入によるコピー禁止
+    TripleBuffer &operator = (const TripleBuffer &b);
+
+public:
+
+    //書き込み側が次に書き込むバッファを取り出す
+    T &write()
+    {
+        return buffer[back];
+    }
+
+    //書き込んだバッファを読み出し側に渡す
+    void publish()
+    {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    //新しいデータがあれば読み出し側のバッファと入れ替える
+    //  戻り値: 入れ替えたら true
+    bool update()
+    {
+        if((middle.load(std::memory_order_relaxed) & fresh) == 0) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    //読み出し側のバッファを取り出す（update() を呼ぶまで変わらない）
+    const T &read() const
+    {
+        return buffer[front];
+    }
+};
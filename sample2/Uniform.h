@@ -1,15 +1,17 @@
 #pragma once
-#include<memory>
 #include<GL/glew.h>
 
+//GPU 資源の管理
+#include "GpuResources.h"
+
 // ユニフォームバッファオブジェクト
 template <typename T>
 class Uniform
 {
     struct UniformBuffer
     {
-        //ユニフォームバッファオブジェクト名
-        GLuint ubo;
+        //ユニフォームバッファオブジェクト
+        GpuResources::Buffer ubo;
         
         //ユニフォームブロックのサイズ
         GLsizeiptr blocksize;
@@ -17,63 +19,79 @@ class Uniform
         //コンストラクタ
         //  data: uniformブロックに格納するデータ
         // count: 確保するuniformブロックの数
-        UniformBuffer(const T *data, unsigned int count)
+        // owner: 使用量の記録に使う持ち主
+        UniformBuffer(const T *data, unsigned int count, const char *owner)
         {
             // ユニフォームブロックのサイズを求める
             GLint alignment;
             glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
             blocksize = (((sizeof (T) - 1) / alignment) + 1) * alignment;
-            //ユニフォームバッファオブジェクトを作成する
-            glGenBuffers(1, &ubo);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-            glBufferData(GL_UNIFORM_BUFFER, count * blocksize, NULL, GL_STATIC_DRAW);
+            //ユニフォームバッファオブジェクトを取り出す（削除はハンドルの破棄で遅らせて行う）
+            //  ブロックごとの境界合わせの詰め物も持ち主の詰め物として記録する
+            ubo = GpuResources::instance().acquireBuffer(count * blocksize, GL_STATIC_DRAW, NULL,
+                                                         owner, count * sizeof (T));
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo.get());
             
-            for(unsigned int i = 0; i < count; i++)
+            for(unsigned int i = 0; data != NULL && i < count; i++)
             {
                 glBufferSubData(GL_UNIFORM_BUFFER, i*blocksize, sizeof(T), data + i);
             }
         }
-        
-        //デストラクタ
-        ~UniformBuffer()
-        {
-            //ユニフォームバッファオブジェクトを削除する
-            glDeleteBuffers(1, &ubo);
-        }
     };
     
     
-    //バッファオブジェクト
-    const std::shared_ptr<const UniformBuffer> buffer;
+    //バッファオブジェクト（参照カウントは使わず、Uniform ごと移動する）
+    UniformBuffer buffer;
     
 public:
     
     //コンストラクタ
     // data: uniformブロックに格納するデータ
     // count: 確保するuniformブロックの数
-    Uniform(const T *data = NULL, unsigned int count = 1)
-        :buffer(new UniformBuffer(data, count))
+    // owner: 使用量の記録に使う持ち主（Uniform<Material> なら "Uniform<Material>" など）
+    Uniform(const T *data = NULL, unsigned int count = 1, const char *owner = "Uniform")
+        :buffer(data, count, owner)
     {
     }
     
+    //ムーブコンストラクタ
+    Uniform(Uniform &&u) = default;
+    
+    //ムーブ代入
+    Uniform &operator = (Uniform &&u) = default;
+    
     //デストラクタ
     virtual ~Uniform()
     {
     }
     
+private:
+    //コピーコンストラクタによるコピー禁止
+    Uniform(const Uniform &u);
+    //代入によるコピー禁止
+    Uniform &operator = (const Uniform &u);
+    
+public:
+    
     //ユニフォームバッファオブジェクトにデータを格納する
     // data: uniformブロックに格納するデータ
     // start: データを格納するuniformブロックの先頭の位置
     // count: データを格納するuniformブロックの数
     void set(const T *data, unsigned int start = 0, unsigned int count = 1) const
     {
-        glBindBuffer(GL_UNIFORM_BUFFER, buffer -> ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer.ubo.get());
+        
+        //境界合わせの詰め物がなければ一度に転送する
+        if(buffer.blocksize == static_cast<GLsizeiptr>(sizeof(T)))
+        {
+            glBufferSubData(GL_UNIFORM_BUFFER, start * buffer.blocksize, count * sizeof(T), data);
+            return;
+        }
         for(unsigned int i = 0; i < count; i++)
         {
-            glBufferSubData(GL_UNIFORM_BUFFER, (start + i) * buffer -> blocksize,
+            glBufferSubData(GL_UNIFORM_BUFFER, (start + i) * buffer.blocksize,
                                                 sizeof(T), data + i);
         }
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), data);
     }
     
     // このユニフォームバッファオブジェクトを使用する
@@ -83,7 +101,7 @@ public:
     {
         //材質に設定するユニフォームバッファオブジェクトを指定する
         glBindBufferRange(GL_UNIFORM_BUFFER, bp,
-                          buffer->ubo, i * buffer -> blocksize, sizeof(T));
+                          buffer.ubo.get(), i * buffer.blocksize, sizeof(T));
     }
 };
 
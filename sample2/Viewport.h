@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <GL/glew.h>
+
+//変換行列
+#include "Matrix.h"
+#include "Transform.h"
+
+//境界ボックス
+#include "Picking.h"
+
+// ウィンドウの中の描画領域とそこから見る視点
+//  一つのウィンドウを分割して複数の視点から描画するときにビューポートごとに作る
+//  apply() で描画先の大きさに合わせた投影変換行列と視錐台を求め、
+//  visible() で視錐台の外にある図形を描画する前に取り除く
+class Viewport
+{
+    //ウィンドウに対する領域（左下を原点とした割合で x, y, 幅, 高さ）
+    GLfloat rect[4];
+
+    //ビュー変換
+    Transform view;
+
+    //前方面と後方面の距離
+    GLfloat zNear, zFar;
+
+    //このフレームのビューポート（画素で x, y, 幅, 高さ）
+    GLint pixels[4];
+
+    //このフレームの投影変換行列
+    Matrix projection;
+
+    //このフレームのワールド座標系での視錐台の六つの平面（内側が正）
+    GLfloat plane[6][4];
+
+    //投影変換行列と視錐台を求める
+    void frustum(GLfloat fovy, GLfloat aspect)
+    {
+        projection = Matrix::perspective(fovy, aspect, zNear, zFar);
+
+        //クリップ座標系への変換行列の行から視錐台の平面を取り出す
+        const Matrix clip(projection * view);
+        for(int i = 0; i < 3; i++)
+        {
+            for(int j = 0; j < 4; j++)
+            {
+                plane[i * 2][j] = clip[j * 4 + 3] + clip[j * 4 + i];
+                plane[i * 2 + 1][j] = clip[j * 4 + 3] - clip[j * 4 + i];
+            }
+        }
+    }
+
+public:
+
+    //コンストラクタ
+    //  x, y, width, height: ウィンドウに対する領域（左下を原点とした割合）
+    //  view: ビュー変換
+    //  zNear, zFar: 前方面と後方面の距離
+    Viewport(GLfloat x, GLfloat y, GLfloat width, GLfloat height, const Transform &view,
+             GLfloat zNear = 1.0f, GLfloat zFar = 10.0f)
+    : rect{ x, y, width, height }
+    , view(view)
+    , zNear(zNear), zFar(zFar)
+    , pixels{}
+    {
+        frustum(1.0f, width / height);
+    }
+
+    //ビュー変換を変える（視錐台は次の apply() で求め直す）
+    void setView(const Transform &v) { view = v; }
+
+    //ビュー変換
+    const Transform &getView() const { return view; }
+
+    //このフレームのビューポート（画素で x, y, 幅, 高さ）
+    const GLint *getPixels() const { return pixels; }
+
+    //このフレームの投影変換行列
+    const Matrix &getProjection() const { return projection; }
+
+    //描画先のこの領域をビューポートに設定し、投影変換行列と視錐台を求める
+    //  target: 描画先の大きさ（画素）
+    //  fovy: 画角
+    void apply(const GLsizei *target, GLfloat fovy)
+    {
+        const GLint x(static_cast<GLint>(rect[0] * target[0]));
+        const GLint y(static_cast<GLint>(rect[1] * target[1]));
+        const GLsizei w(std::max(static_cast<GLsizei>(rect[2] * target[0]), 1));
+        const GLsizei h(std::max(static_cast<GLsizei>(rect[3] * target[1]), 1));
+        glViewport(x, y, w, h);
+        pixels[0] = x;
+        pixels[1] = y;
+        pixels[2] = w;
+        pixels[3] = h;
+
+        //縦横比は領域の画素数から求める
+        frustum(fovy, static_cast<GLfloat>(w) / static_cast<GLfloat>(h));
+    }
+
+    //ワールド座標系の境界ボックスが視錐台と重なるか
+    //  b: ワールド座標系での境界ボックス
+    bool visible(const Bounds &b) const
+    {
+        for(const GLfloat *p : plane)
+        {
+            //平面の法線の方向に一番遠い頂点が外側にあれば全体が外側にある
+            const GLfloat d(p[0] * (p[0] > 0.0f ? b.hi[0] : b.lo[0])
+                          + p[1] * (p[1] > 0.0f ? b.hi[1] : b.lo[1])
+                          + p[2] * (p[2] > 0.0f ? b.hi[2] : b.lo[2]) + p[3]);
+            if(d < 0.0f) return false;
+        }
+        return true;
+    }
+
+    //ウィンドウ上の位置がこの領域の中にあればこの領域の正規化デバイス座標系に直す
+    //  x, y: ウィンドウ上の位置（左上を原点とした画面座標）
+    //  size: ウィンドウのサイズ
+    //  ndc: 正規化デバイス座標系での位置の格納先
+    bool contains(double x, double y, const GLfloat *size, GLfloat *ndc) const
+    {
+        const GLfloat u((static_cast<GLfloat>(x) / size[0] - rect[0]) / rect[2]);
+        const GLfloat v((1.0f - static_cast<GLfloat>(y) / size[1] - rect[1]) / rect[3]);
+        if(u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f) return false;
+        ndc[0] = u * 2.0f - 1.0f;
+        ndc[1] = v * 2.0f - 1.0f;
+        return true;
+    }
+};
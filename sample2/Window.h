@@ -1,8 +1,19 @@
 #pragma once
 #include <iostream>
+#include <new>
+#include <cstdlib>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+//GL の呼び出しの記録（GL_TRACE が 0 なら何もしない）
+#include "GlTrace.h"
+
+//入力イベントのキュー
+#include "InputQueue.h"
+
+//GPU 資源の管理
+#include "GpuResources.h"
+
 // ウィンドウ関連の処理
 class Window{
     //ウィンドウのハンドル
@@ -11,19 +22,21 @@ class Window{
     //ウィンドウのサイズ
     GLfloat size[2];
     
+    //フレームバッファのサイズ（Retina ディスプレイではウィンドウのサイズより大きい）
+    GLsizei framebuffer[2];
+    
     //ワールド座標系に対するデバイス座標系の拡大率
     GLfloat scale;
     
-    //図形の正規化デバイス座標系上での位置
-    GLfloat location[2];
-    
-    int keyStatus;
+    //入力イベント（コールバックで追加し、どのスレッドからでも読み出せる）
+    InputQueue events;
     
 public:
     //コンストラクタ
-    Window(int width = 640, int height = 480, const char *title = "Hello!")
-    : window(glfwCreateWindow(width, height, title, NULL, NULL))
-    , scale(100.0f),location{ 0.0f, 0.0f}, keyStatus(GLFW_RELEASE)
+    //  share: GPU 資源を共有するウィンドウ（NULL なら共有しない）
+    Window(int width = 640, int height = 480, const char *title = "Hello!", const Window *share = NULL)
+    : window(glfwCreateWindow(width, height, title, NULL, share != NULL ? share -> window : NULL))
+    , scale(100.0f)
     {
         if(window == NULL)
         {
@@ -33,19 +46,23 @@ public:
         }
         
         //現在のウィンドウを処理対象にする
-        glfwMakeContextCurrent(window);
+        makeCurrent();
         
-        //GLEWを初期化する
-        glewExperimental = GL_TRUE;
-        if(glewInit() != GLEW_OK)
+        //GLEWを初期化する（関数のアドレスはどのコンテキストでも同じなので最初のウィンドウだけで行う）
+        static bool glew(false);
+        if(!glew)
         {
-            //GLEWの初期化に失敗した
-            std::cerr << "Can't initialize GLEW" << std::endl;
-            exit(1);
+            glewExperimental = GL_TRUE;
+            if(glewInit() != GLEW_OK)
+            {
+                //GLEWの初期化に失敗した
+                std::cerr << "Can't initialize GLEW" << std::endl;
+                exit(1);
+            }
+            glew = true;
         }
         
-        // 垂直同期のタイミングを待つ
-        glfwSwapInterval(1);
+        //垂直同期の設定は FramePacer で行う
         
         //このインスタンスの this ポインタを記録しておく
         glfwSetWindowUserPointer(window, this);
@@ -56,6 +73,12 @@ public:
         // キーボード操作時に呼び出す処理の登録
         glfwSetKeyCallback(window, keyboard);
         
+        // マウスのボタン操作時に呼び出す処理の登録
+        glfwSetMouseButtonCallback(window, mouse);
+        
+        // マウスカーソルの移動時に呼び出す処理の登録
+        glfwSetCursorPosCallback(window, cursor);
+        
         // ウィンドウのサイズ変更時に呼び出す処理の登録
         glfwSetWindowSizeCallback(window,resize);
         
@@ -65,9 +88,26 @@ public:
     
     //デストラクタ
     virtual ~Window(){
+        //コンテキストがあるうちにこのコンテキストで取っておいた GPU 資源を削除する
+        makeCurrent();
+        GpuResources::instance().clear();
+#if GL_TRACE
+        GlTrace::instance().releaseContext(window);
+#endif
+        
         glfwDestroyWindow(window);
     }
     
+    //ヒープに作るときも入力イベントのキューの整列を守る（C++14 の new は alignas を考えない）
+    static void *operator new(std::size_t size){
+        void *p;
+        if(posix_memalign(&p, alignof(Window), size) != 0) throw std::bad_alloc();
+        return p;
+    }
+    static void operator delete(void *p){
+        free(p);
+    }
+    
     //描画ループの継続判定
     explicit operator bool(){
         
@@ -75,56 +115,60 @@ public:
         glfwPollEvents();
                 
                 
-        //キーボードの状態を調べる
-        if(glfwGetKey(window, GLFW_KEY_LEFT) != GLFW_RELEASE)
-            location[0] -= 10.0f / size[0];
-        else if(glfwGetKey(window, GLFW_KEY_RIGHT) != GLFW_RELEASE)
-            location[0] += 10.0f / size[0];
-        
-        if(glfwGetKey(window, GLFW_KEY_DOWN) != GLFW_RELEASE)
-            location[1] -= 10.0f / size[1];
-        else if(glfwGetKey(window, GLFW_KEY_UP) != GLFW_RELEASE)
-            location[1] += 10.0f / size[1];
-        
-        
-        //マウスの左ボタンの状態を調べる
-        /*
-         GLFW_MOUSE_BUTTON_1 と　GLFW_MOUSE_BUTTON_LEFTは左ボタン
-         GLFW_MOUSE_BUTTON_2 と　GLFW_MOUSE_BUTTON_RIGHTは右ボタン
-         GLFW_MOUSE_BUTTON_3 と　GLFW_MOUSE_BUTTON_MIDDLEは中ボタン
-         GLFW_MOUSE_BUTTON_4 ~ GLFW_MOUSE_BUTTON_8 はマウス依存
-         GLFW_MOUSE_BUTTON_LAST はGLFW_MOUSE_BUTTON_8と同じ
-         */
-        if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) != GLFW_RELEASE)
-        {
-            //マウスの左ボタンが押されていたらマウスカーソルの位置を取得する
-            double x,y;
-            glfwGetCursorPos(window, &x, &y);
-            
-            //マウスカーソルの正規化デバイス座標系上での位置を求める
-            location[0] = static_cast<GLfloat>(x) * 2.0f / size[0] - 1.0f;
-            location[1] = 1.0f - static_cast<GLfloat>(y) * 2.0f / size[1];
-        }
-        
+        //キーやマウスの操作はコールバックで入力イベントのキューに追加される
+        return !glfwWindowShouldClose(window);
+    }
+    
+    //このウィンドウを処理対象にする
+    void makeCurrent(){
+        glfwMakeContextCurrent(window);
         
-        return !glfwWindowShouldClose(window) && !glfwGetKey(window, GLFW_KEY_ESCAPE);
+        //頂点配列オブジェクトや結合の状態はコンテキストごとなので切り替えたことを知らせる
+        GpuResources::instance().setContext(window);
+#if GL_TRACE
+        //GL の呼び出しを記録しているときは記録の状態も切り替える
+        GlTrace::instance().setContext(window);
+#endif
+    }
+    
+    //ウィンドウを閉じる操作が行われたか
+    bool shouldClose() const {
+        return glfwWindowShouldClose(window) != 0;
+    }
+    
+    //イベントを取り出す（提出の直前に入力を読み直すときに使う）
+    void pollEvents(){
+        glfwPollEvents();
     }
     
     // ダブルバッファリング
     void swapBuffers(){
         //カラーバッファを入れ替える
         glfwSwapBuffers(window);
+        
+        //このフレームに手放された GPU 資源を描画が終わってから使い回せるようにする
+        GpuResources::instance().endFrame();
     }
     
     
     //ウィンドウのサイズを取り出す
     const GLfloat *getSize() const { return size; }
     
+    //フレームバッファのサイズを取り出す
+    const GLsizei *getFramebufferSize() const { return framebuffer; }
+    
     //ワールド座標系に対するデバイス座標系の拡大率を取り出す
     GLfloat getScale() const{ return scale; }
     
-    //位置を取り出す
-    const GLfloat *getLocation() const { return location;}
+    //入力イベントのキューを取り出す（読み出すスレッドごとに InputQueue::Reader を作る）
+    const InputQueue &getEvents() const { return events; }
+    
+    //入力イベントをキューに追加する
+    void push(InputEvent::Type type, int code, int action, int mods, double x, double y)
+    {
+        const InputEvent e = { type, code, action, mods, x, y, glfwGetTime() };
+        events.push(e);
+    }
     
     // ウィンドウのサイズ変更時の処理
     static void resize(GLFWwindow *const window,int width,int height)
@@ -132,8 +176,8 @@ public:
         //フレームバッファのサイズを調べる
         int fbWidth,fbHeight;
         glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
-        //ウィンドウ全体をビューポートに設定する
-        glViewport(0, 0, fbWidth, fbHeight);
+        //このウィンドウが処理対象ならウィンドウ全体をビューポートに設定する
+        if(glfwGetCurrentContext() == window) glViewport(0, 0, fbWidth, fbHeight);
         
         //このインスタンスのthisポインタを得る
         Window *const instance(static_cast<Window *>(glfwGetWindowUserPointer(window)));
@@ -142,6 +186,13 @@ public:
             //開いたウィンドウのサイズを保存する
             instance -> size[0] = static_cast<GLfloat>(width);
             instance -> size[1] = static_cast<GLfloat>(height);
+            
+            //フレームバッファのサイズを保存する
+            instance -> framebuffer[0] = fbWidth;
+            instance -> framebuffer[1] = fbHeight;
+            
+            //サイズの変更を入力イベントとして伝える
+            instance -> push(InputEvent::Resize, 0, 0, 0, width, height);
         }
         
     }
@@ -154,6 +205,9 @@ public:
         if(instance != NULL){
             //ワールド座標系に対するデバイス座標系の拡大率を更新する
             instance -> scale += static_cast<GLfloat>(y);
+            
+            //ホイールの操作を入力イベントとして伝える
+            instance -> push(InputEvent::Scroll, 0, 0, 0, x, y);
         }
     }
     
@@ -162,8 +216,45 @@ public:
         Window *const instance(static_cast<Window *>(glfwGetWindowUserPointer(window)));
         
         if(instance != NULL){
-            //キーの状態を保存する
-            instance -> keyStatus = action;
+            //キーの操作を入力イベントとして伝える
+            instance -> push(InputEvent::Key, key, action, mods, 0.0, 0.0);
+            
+            //ESC キーが押されたら終了する
+            if(key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+                glfwSetWindowShouldClose(window, GL_TRUE);
+        }
+    }
+    
+    //マウスのボタン操作時の処理
+    /*
+     GLFW_MOUSE_BUTTON_1 と　GLFW_MOUSE_BUTTON_LEFTは左ボタン
+     GLFW_MOUSE_BUTTON_2 と　GLFW_MOUSE_BUTTON_RIGHTは右ボタン
+     GLFW_MOUSE_BUTTON_3 と　GLFW_MOUSE_BUTTON_MIDDLEは中ボタン
+     GLFW_MOUSE_BUTTON_4 ~ GLFW_MOUSE_BUTTON_8 はマウス依存
+     GLFW_MOUSE_BUTTON_LAST はGLFW_MOUSE_BUTTON_8と同じ
+     */
+    static void mouse(GLFWwindow *window, int button, int action, int mods)
+    {
+        Window *const instance(static_cast<Window *>(glfwGetWindowUserPointer(window)));
+        
+        if(instance != NULL){
+            //ボタンを操作したときのマウスカーソルの位置を取得する
+            double x,y;
+            glfwGetCursorPos(window, &x, &y);
+            
+            //ボタンの操作を入力イベントとして伝える
+            instance -> push(InputEvent::MouseButton, button, action, mods, x, y);
+        }
+    }
+    
+    //マウスカーソルの移動時の処理
+    static void cursor(GLFWwindow *window, double x, double y)
+    {
+        Window *const instance(static_cast<Window *>(glfwGetWindowUserPointer(window)));
+        
+        if(instance != NULL){
+            //マウスカーソルの移動を入力イベントとして伝える
+            instance -> push(InputEvent::CursorPos, 0, 0, 0, x, y);
         }
     }
 };
@@ -0,0 +1,1248 @@
+#include<cstdlib>
+#include<cstring>
+#include<cmath>
+#include<chrono>
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<memory>
+#include<algorithm>
+#include<sys/resource.h>
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include "Window.h"
+#include "Matrix.h"
+#include "Transform.h"
+#include "Quaternion.h"
+#include "Vector.h"
+#include "Shape.h"
+#include "SolidShape.h"
+#include "SolidShapeIndex.h"
+#include "Material.h"
+#include "MaterialRegistry.h"
+#include "ShaderVariants.h"
+#include "Geometry.h"
+#include "ThreadPool.h"
+#include "ParticleSystem.h"
+#include "MeshCodec.h"
+#include "GpuMemory.h"
+#include "Startup.h"
+#include "SphereImpostors.h"
+#include "SkinnedShape.h"
+#include "Animator.h"
+#include "Terrain.h"
+
+/*
+ 描画のベンチマーク
+
+ 球と六面体を N 個、光源を M 個、材質を K 種類並べた場面を
+ 見えないウィンドウに決まったフレーム数だけ描画し、
+ CPU の処理時間、描画命令の数、状態の切り替えの数、メモリの使用量を JSON で出力する
+
+ 同じ数の図形について、回転を Matrix::rotate と operator* で求める場合と
+ 四元数・双対四元数で合成してまとめて変換行列にする場合の CPU の時間も比べる
+
+ 百万個のパーティクルの CPU での更新とバッファへの転送の時間も計る
+
+ 起動の処理（ウィンドウの作成、シェーダの読み込みとコンパイル）と最初のフレームを表示するまでの時間も計る
+
+ 同じ数の球を分割した図形で一つずつ描く場合とインポスタでまとめて描く場合のフレームの時間も比べる
+
+ 骨格アニメーションの姿勢の計算を一つのスレッドとワーカースレッドで行う時間と、パレットの転送とスキニングした図形の描画の時間も計る
+
+ 区画に分けた数 km の地形の上を飛び、区画の作成と転送の依頼と、詳細度を選んだ描画の時間も計る
+
+ 使い方: benchmark [-frames 数] [-output ファイル] [-baseline ファイル] [-save] [-tolerance 割合]
+   -baseline を指定すると保存してある結果と比べ、悪化していたら 1 を返して終了する
+   -save を指定すると今回の結果を -baseline のファイルに保存する
+*/
+
+// 場面の大きさ
+struct SceneSize
+{
+    //場面の名前
+    const char *name;
+
+    //球の数と六面体の数
+    int spheres, cubes;
+
+    //光源の数
+    int lights;
+
+    //材質の種類
+    int materials;
+};
+
+// 計測する場面
+static constexpr SceneSize scenes[] =
+{
+    // 名前      球     六面体  光源  材質
+    { "small",    100,   100,   1,    4 },
+    { "medium",  1000,  1000,   2,   64 },
+    { "large",  10000, 10000,   4, 1024 }
+};
+
+// 一つの場面の計測結果
+struct Result
+{
+    //場面の名前
+    std::string name;
+
+    //図形の数、光源の数、材質の種類（重複を除いたもの）
+    int objects, lights, materials;
+
+    //一フレームの CPU の処理時間の平均、中央値、95 パーセンタイル、最大（ミリ秒）
+    double cpuMean, cpuMedian, cpuP95, cpuMax;
+
+    //GPU の処理の完了までを含めた一フレームの時間の平均（ミリ秒）
+    double frameMean;
+
+    //一フレームあたりの描画命令、状態の切り替え、uniform 変数の設定の数
+    long drawCalls, stateChanges, uniformUpdates;
+
+    //確保したバッファオブジェクトの大きさ（バイト）
+    long gpuBufferBytes;
+
+    //GPU メモリの使用量の記録による確保した大きさと詰め物の大きさ（バイト）
+    long gpuAllocatedBytes, gpuPaddingBytes;
+
+    //プロセスの最大常駐メモリ（バイト）
+    long maxRssBytes;
+};
+
+// 回転の求め方ごとの計測結果
+struct RotationResult
+{
+    //図形の数
+    int objects;
+
+    //一フレーム分の変換行列を求める時間の平均（ミリ秒）
+    //  matrix: Matrix::rotate と Matrix の operator* を毎回求める
+    //  transform: Transform::rotate を Transform の式で合成する
+    //  quaternion: 四元数を合成して Transform の式に混ぜる
+    //  dualQuaternion: 双対四元数を合成して toMatrices でまとめて変換する
+    double matrix, transform, quaternion, dualQuaternion;
+};
+
+// パーティクルの計測結果
+struct ParticleResult
+{
+    //パーティクルの数
+    int count;
+
+    //一フレームあたりの更新（詰め直しを含む）と転送の時間の平均（ミリ秒）
+    double update, upload;
+};
+
+// 図形データの圧縮の計測結果
+struct MeshResult
+{
+    //頂点の数とインデックスの要素数
+    int vertices, indices;
+
+    //圧縮前と圧縮後の大きさ（バイト）
+    long rawBytes, encodedBytes;
+
+    //メモリへの復号とバッファオブジェクトへの直接の復号の時間の平均（ミリ秒）
+    double decode, upload;
+};
+
+// 球のインポスタの計測結果
+struct ImpostorResult
+{
+    //球の数
+    int spheres;
+
+    //GPU の処理の完了までを含めた一フレームの時間の平均（ミリ秒）
+    //  tessellated: 分割した球を一つずつ描く
+    //  impostor: インポスタをインスタンシングで一度に描く
+    double tessellated, impostor;
+};
+
+// 骨格アニメーションの計測結果
+struct SkinningResult
+{
+    //キャラクタの数と一体あたりの関節の数
+    int characters, joints;
+
+    //一フレームあたりの時間の平均（ミリ秒）
+    //  serial: 姿勢の計算を呼び出したスレッドだけで行う
+    //  parallel: 姿勢の計算をワーカースレッドで分担する
+    //  upload: パレットの転送
+    //  draw: GPU の処理の完了までを含めたスキニングした図形の描画
+    double serial, parallel, upload, draw;
+};
+
+// 地形の計測結果
+struct TerrainResult
+{
+    //置いておいた区画の数の最大とスロットの数
+    int chunks, slots;
+
+    //スロットの頂点バッファの大きさ（バイト）
+    long vertexBytes;
+
+    //計測中に転送した区画の数と一フレームあたりの描画した三角形の数
+    long uploaded, triangles;
+
+    //一フレームあたりの時間の平均（ミリ秒）
+    //  update: 出来上がった区画の転送と作成の依頼
+    //  draw: GPU の処理の完了までを含めた描画
+    double update, draw;
+};
+
+// 起動の計測結果
+struct StartupResult
+{
+    //ウィンドウとコンテキストの作成、シェーダのソースの読み込み、シェーダのコンパイルとリンクの時間（ミリ秒）
+    double window, sources, compile;
+
+    //起動から最初のフレームを表示するまでの時間（ミリ秒）
+    double firstFrame;
+};
+
+// 現在時刻（秒）
+static double now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// プロセスの最大常駐メモリ（バイト）
+static long maxRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<long>(usage.ru_maxrss);
+#else
+    return static_cast<long>(usage.ru_maxrss) * 1024L;
+#endif
+}
+
+// 決まった順に値を作る乱数（場面を毎回同じにするため）
+static GLfloat nextRandom(unsigned int &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<GLfloat>(seed >> 8) / static_cast<GLfloat>(1u << 24);
+}
+
+// 場面で共通に使う材質
+enum Surface
+{
+    Glossy,     //鏡面反射のある白
+    Matte,      //鏡面反射のない白
+    Grass,      //鏡面反射のない緑（地形）
+    surfaces
+};
+static constexpr Material surface[surfaces] =
+{
+    //     Kamb              Kdiff               Kspec        Kshi
+    {0.1f, 0.1f, 0.1f,  1.0f, 1.0f, 1.0f,  0.3f, 0.3f, 0.3f,  30.0f},
+    {0.1f, 0.1f, 0.1f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f, 0.0f,  30.0f},
+    {0.1f, 0.1f, 0.1f,  0.4f, 0.6f, 0.3f,  0.0f, 0.0f, 0.0f,   1.0f}
+};
+
+// 光源を場面の上の円周に沿って並べる（強度は光源の数で割って合計を一定にする）
+//  lights: 光源の数
+//  center: 円の中心（ワールド座標系）
+//  radius: 円の半径
+//  ambient, diffuse, specular: 全ての光源の環境光、拡散反射光、鏡面反射光の強度の合計
+//  Lpos: ワールド座標系での光源の位置の格納先
+//  Lamb, Ldiff, Lspec: 光源ごとの強度（RGB）の格納先
+static void makeLights(int lights, const Vector &center, GLfloat radius,
+                       GLfloat ambient, GLfloat diffuse, GLfloat specular, std::vector<Vector> &Lpos,
+                       std::vector<GLfloat> &Lamb, std::vector<GLfloat> &Ldiff, std::vector<GLfloat> &Lspec)
+{
+    Lpos.clear();
+    Lamb.assign(lights * 3, ambient / lights);
+    Ldiff.assign(lights * 3, diffuse / lights);
+    Lspec.assign(lights * 3, specular / lights);
+    for(int i = 0; i < lights; i++)
+    {
+        const GLfloat a(6.283185f * static_cast<GLfloat>(i) / static_cast<GLfloat>(lights));
+        Lpos.push_back(Vector{ center[0] + radius * cosf(a), center[1], center[2] + radius * sinf(a), 1.0f });
+    }
+}
+
+// 場面を作って決まったフレーム数だけ描画する
+//  size: 場面の大きさ
+//  frames: 描画するフレーム数
+//  variants: シェーダ
+Result run(const SceneSize &size, int frames, ShaderVariants &variants)
+{
+    unsigned int seed(12345u);
+
+    // 図形データを作成する
+    std::vector<Object::Vertex> solidSphereVertex;
+    std::vector<GLuint> solidSphereIndex;
+    makeSolidSphere(16, 8, solidSphereVertex, solidSphereIndex);
+    const std::unique_ptr<const Shape> sphere(new SolidShapeIndex(3,
+        static_cast<GLsizei>(solidSphereVertex.size()), solidSphereVertex.data(),
+        static_cast<GLsizei>(solidSphereIndex.size()), solidSphereIndex.data()));
+    const std::unique_ptr<const Shape> cube(new SolidShapeIndex(3, 36, solidCubeVertex, 36, solidCubeIndex));
+
+    // 光源データを作成する
+    std::vector<Vector> Lpos;
+    std::vector<GLfloat> Lamb, Ldiff, Lspec;
+    makeLights(size.lights, Vector{ 0.0f, 10.0f, 0.0f, 1.0f }, 20.0f, 0.1f, 0.9f, 0.9f, Lpos, Lamb, Ldiff, Lspec);
+
+    // 材質を作成する（四つに一つは鏡面反射のない材質にして軽いシェーダも使う）
+    MaterialRegistry material;
+    std::vector<GLuint> materialIndex;
+    std::vector<ShaderFeature> feature;
+    for(int i = 0; i < size.materials; i++)
+    {
+        const GLfloat r(nextRandom(seed)), g(nextRandom(seed)), b(nextRandom(seed));
+        const GLfloat k(i % 4 == 3 ? 0.0f : 0.3f);
+        const Material m = { r * 0.2f, g * 0.2f, b * 0.2f,  r, g, b,  k, k, k,  30.0f };
+        materialIndex.push_back(material.add(m));
+        feature.push_back(ShaderVariants::choose(size.lights, m));
+        variants.request(feature.back());
+    }
+
+    // 図形を格子状に並べる
+    const int count(size.spheres + size.cubes);
+    const int side(static_cast<int>(ceil(cbrt(static_cast<double>(count)))));
+    std::vector<Translation> placement;
+    for(int i = 0; i < count; i++)
+    {
+        const GLfloat x(static_cast<GLfloat>(i % side) - side * 0.5f);
+        const GLfloat y(static_cast<GLfloat>(i / side % side) - side * 0.5f);
+        const GLfloat z(static_cast<GLfloat>(i / side / side) - side * 0.5f);
+        placement.push_back(Transform::translate(x * 3.0f, y * 3.0f, z * 3.0f));
+    }
+
+    // 視点は場面全体が見える位置に置く
+    const GLfloat distance(side * 4.0f);
+    const Transform view(Transform::lookat(distance, distance * 0.8f, distance, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(0.8f, 640.0f / 480.0f, 1.0f, distance * 4.0f));
+    std::vector<Vector> Lview;
+    for(const Vector &p : Lpos) Lview.push_back(view * p);
+
+    Result result = {};
+    result.name = size.name;
+    result.objects = count;
+    result.lights = size.lights;
+    result.materials = material.size();
+    result.gpuBufferBytes = static_cast<long>(solidSphereVertex.size() * sizeof (Object::Vertex)
+        + solidSphereIndex.size() * sizeof (GLuint) + sizeof solidCubeVertex + sizeof solidCubeIndex
+        + material.size() * sizeof (Material));
+
+    std::vector<double> cpu;
+    double frameTotal(0.0);
+    long drawCalls(0), stateChanges(0), uniformUpdates(0);
+
+    // 最初のフレームはシェーダのリンクの待ちを含むので計測しない
+    for(int frame = -1; frame < frames; frame++)
+    {
+        const double t0(now());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // 材質のバッファを結合する
+        material.update();
+        material.select(0);
+        ++stateChanges;
+
+        //時刻はフレームの番号から決める
+        const GLfloat time(static_cast<GLfloat>(frame) / 60.0f);
+
+        GLuint current(0);
+        for(int i = 0; i < count; i++)
+        {
+            // 材質に合わせたシェーダを使う
+            const int m(i % size.materials);
+            const ShaderVariants::Variant &v(variants.get(feature[m]));
+            if(v.program != current)
+            {
+                current = v.program;
+                glUseProgram(v.program);
+                glUniform1i(v.materialLoc, 0);
+                glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, projection.data());
+                ShaderVariants::setLights(v, size.lights, Lview[0].data(), Lamb.data(), Ldiff.data(), Lspec.data());
+                ++stateChanges;
+                uniformUpdates += 6;
+            }
+
+            // モデルビュー変換行列と法線ベクトルの変換行列を求める
+            const Transform modelview(view * placement[i]
+                * Transform::rotate(time + static_cast<GLfloat>(i) * 0.1f, 0.0f, 1.0f, 0.0f));
+            GLfloat normalMatrix[9];
+            modelview.getNormalMatrix(normalMatrix);
+            glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview.toMatrix().data());
+            glUniformMatrix3fv(v.normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+            glUniform1i(v.materialIndexLoc, materialIndex[m]);
+            uniformUpdates += 3;
+
+            // 図形を描画する（頂点配列オブジェクトの結合を伴う）
+            (i < size.spheres ? sphere : cube) -> draw();
+            ++stateChanges;
+            ++drawCalls;
+        }
+        glFlush();
+        const double t1(now());
+
+        // GPU の処理の完了を待つ
+        glFinish();
+        const double t2(now());
+
+        if(frame < 0)
+        {
+            drawCalls = stateChanges = uniformUpdates = 0;
+            continue;
+        }
+        cpu.push_back((t1 - t0) * 1000.0);
+        frameTotal += (t2 - t0) * 1000.0;
+    }
+
+    // 統計を求める
+    std::vector<double> sorted(cpu);
+    std::sort(sorted.begin(), sorted.end());
+    double sum(0.0);
+    for(double c : cpu) sum += c;
+    result.cpuMean = sum / frames;
+    result.cpuMedian = sorted[sorted.size() / 2];
+    result.cpuP95 = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+    result.cpuMax = sorted.back();
+    result.frameMean = frameTotal / frames;
+    result.drawCalls = drawCalls / frames;
+    result.stateChanges = stateChanges / frames;
+    result.uniformUpdates = uniformUpdates / frames;
+    result.maxRssBytes = maxRss();
+    const GpuMemory::Totals &memory(GpuMemory::instance().getTotals());
+    result.gpuAllocatedBytes = static_cast<long>(memory.all.bytes);
+    result.gpuPaddingBytes = static_cast<long>(memory.all.bytes - memory.all.payload);
+
+    return result;
+}
+
+// 回転の求め方ごとに変換行列を求める時間を計る（描画はしない）
+//  count: 図形の数
+//  frames: 繰り返すフレーム数
+RotationResult rotation(int count, int frames)
+{
+    unsigned int seed(54321u);
+
+    // 図形ごとの位置と回転軸と回転の速さ
+    std::vector<Translation> placement;
+    std::vector<Vector> axis;
+    std::vector<Quaternion> spin, orientation(count);
+    std::vector<DualQuaternion> body(count);
+    for(int i = 0; i < count; i++)
+    {
+        placement.push_back(Transform::translate(nextRandom(seed) * 100.0f, nextRandom(seed) * 100.0f, nextRandom(seed) * 100.0f));
+        axis.push_back(Vector{ nextRandom(seed) - 0.5f, nextRandom(seed) - 0.5f, nextRandom(seed) - 0.5f, 0.0f });
+        spin.push_back(Quaternion::rotate(1.0f / 60.0f, axis[i][0], axis[i][1], axis[i][2]));
+    }
+    const Transform view(Transform::lookat(150.0f, 120.0f, 150.0f, 50.0f, 50.0f, 50.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix viewMatrix(view.toMatrix());
+    const DualQuaternion viewDual(view);
+
+    std::vector<Matrix> modelview(count);
+    double elapsed[4] = {};
+    volatile GLfloat sink(0.0f);
+
+    for(int frame = 0; frame < frames; frame++)
+    {
+        const GLfloat time(static_cast<GLfloat>(frame) / 60.0f);
+
+        // Matrix::rotate と operator* の連鎖
+        const double t0(now());
+        for(int i = 0; i < count; i++)
+        {
+            modelview[i] = viewMatrix * Matrix::translate(placement[i][0], placement[i][1], placement[i][2])
+                * Matrix::rotate(time, axis[i][0], axis[i][1], axis[i][2]);
+        }
+        sink = sink + modelview[count - 1][12];
+
+        // Transform の式
+        const double t1(now());
+        for(int i = 0; i < count; i++)
+        {
+            modelview[i] = Transform(view * placement[i]
+                * Transform::rotate(time, axis[i][0], axis[i][1], axis[i][2])).toMatrix();
+        }
+        sink = sink + modelview[count - 1][12];
+
+        // 四元数を合成して Transform の式に混ぜる
+        const double t2(now());
+        for(int i = 0; i < count; i++)
+        {
+            orientation[i] = (spin[i] * orientation[i]).normalize();
+            modelview[i] = Transform(view * placement[i] * orientation[i]).toMatrix();
+        }
+        sink = sink + modelview[count - 1][12];
+
+        // 双対四元数を合成してまとめて変換行列にする
+        const double t3(now());
+        for(int i = 0; i < count; i++)
+        {
+            body[i] = viewDual * DualQuaternion(orientation[i], placement[i][0], placement[i][1], placement[i][2]);
+        }
+        toMatrices(body.data(), body.size(), modelview.data());
+        sink = sink + modelview[count - 1][12];
+        const double t4(now());
+
+        elapsed[0] += t1 - t0;
+        elapsed[1] += t2 - t1;
+        elapsed[2] += t3 - t2;
+        elapsed[3] += t4 - t3;
+    }
+
+    const RotationResult result =
+    {
+        count,
+        elapsed[0] * 1000.0 / frames,
+        elapsed[1] * 1000.0 / frames,
+        elapsed[2] * 1000.0 / frames,
+        elapsed[3] * 1000.0 / frames
+    };
+    return result;
+}
+
+// パーティクルの更新と転送の時間を計る
+//  count: パーティクルの数
+//  frames: 繰り返すフレーム数
+//  pool: 更新を分担するワーカースレッド
+ParticleResult particles(int count, int frames, ThreadPool &pool)
+{
+    //計測の間に寿命が尽きないようにして数を一定に保つ
+    ParticleSystem system(count, 1.0e6f, pool);
+    static constexpr GLfloat origin[] = { 0.0f, 0.0f, 0.0f };
+    static constexpr GLfloat gravity[] = { 0.0f, -9.8f, 0.0f };
+    system.emit(count, origin, 5.0f, 0.5f);
+
+    double update(0.0), upload(0.0);
+    for(int frame = 0; frame < frames; frame++)
+    {
+        const double t0(now());
+        system.update(1.0f / 60.0f, gravity);
+        const double t1(now());
+        system.upload();
+        glFinish();
+        const double t2(now());
+
+        update += t1 - t0;
+        upload += t2 - t1;
+    }
+
+    const ParticleResult result = { system.size(), update * 1000.0 / frames, upload * 1000.0 / frames };
+    return result;
+}
+
+// 分割した球とインポスタで同じ場面を描く時間を比べる
+//  count: 球の数
+//  lights: 光源の数
+//  frames: 描画するフレーム数
+//  variants: 分割した球のシェーダ
+ImpostorResult impostors(int count, int lights, int frames, ShaderVariants &variants)
+{
+    // 分割した球とインポスタとそのシェーダを作る（インポスタは全ての球を一度に描くのでインスタンス描画の組み合わせ）
+    std::vector<Object::Vertex> solidSphereVertex;
+    std::vector<GLuint> solidSphereIndex;
+    makeSolidSphere(16, 8, solidSphereVertex, solidSphereIndex);
+    const SolidShapeIndex sphere(3,
+        static_cast<GLsizei>(solidSphereVertex.size()), solidSphereVertex.data(),
+        static_cast<GLsizei>(solidSphereIndex.size()), solidSphereIndex.data());
+    ShaderVariants impostorVariants("impostor.vert", "impostor.frag");
+    MaterialRegistry material;
+    const GLuint index(material.add(surface[Glossy]));
+    const ShaderVariants::Variant &tessellated(variants.get(ShaderVariants::choose(lights, surface[Glossy])));
+    const ShaderVariants::Variant &impostor(impostorVariants.get(ShaderVariants::choose(lights, surface[Glossy], true)));
+    material.update();
+    material.select(0);
+
+    // 球を格子状に並べて視点は場面全体が見える位置に置く
+    const int side(static_cast<int>(ceil(cbrt(static_cast<double>(count)))));
+    const GLfloat distance(side * 4.0f);
+    const Transform view(Transform::lookat(distance, distance * 0.8f, distance, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(0.8f, 640.0f / 480.0f, 1.0f, distance * 4.0f));
+    std::vector<Translation> placement;
+    SphereImpostors spheres(count);
+    for(int i = 0; i < count; i++)
+    {
+        const GLfloat x((static_cast<GLfloat>(i % side) - side * 0.5f) * 3.0f);
+        const GLfloat y((static_cast<GLfloat>(i / side % side) - side * 0.5f) * 3.0f);
+        const GLfloat z((static_cast<GLfloat>(i / side / side) - side * 0.5f) * 3.0f);
+        placement.push_back(Transform::translate(x, y, z));
+        const SphereImpostors::Sphere s = { { x, y, z }, 1.0f, index };
+        spheres.add(s);
+    }
+    spheres.upload();
+
+    // 光源は場面の上に一つずつ置く
+    std::vector<Vector> Lpos, Lview;
+    std::vector<GLfloat> Lamb, Ldiff, Lspec;
+    makeLights(lights, Vector{ 0.0f, 10.0f, 0.0f, 1.0f }, 20.0f, 0.1f, 0.9f, 0.9f, Lpos, Lamb, Ldiff, Lspec);
+    for(const Vector &p : Lpos) Lview.push_back(view * p);
+    const auto use([&](const ShaderVariants::Variant &v)
+    {
+        glUseProgram(v.program);
+        glUniform1i(v.materialLoc, 0);
+        glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, projection.data());
+        ShaderVariants::setLights(v, lights, Lview[0].data(), Lamb.data(), Ldiff.data(), Lspec.data());
+    });
+
+    double elapsed[2] = {};
+    for(int frame = 0; frame < frames; frame++)
+    {
+        // 分割した球を一つずつ描く
+        const double t0(now());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        use(tessellated);
+        glUniform1i(tessellated.materialIndexLoc, index);
+        for(int i = 0; i < count; i++)
+        {
+            const Transform modelview(view * placement[i]);
+            GLfloat normalMatrix[9];
+            modelview.getNormalMatrix(normalMatrix);
+            glUniformMatrix4fv(tessellated.modelviewLoc, 1, GL_FALSE, modelview.toMatrix().data());
+            glUniformMatrix3fv(tessellated.normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+            sphere.draw();
+        }
+        glFinish();
+
+        // インポスタを一度に描く
+        const double t1(now());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        use(impostor);
+        spheres.draw(impostor, view.toMatrix().data());
+        glFinish();
+        const double t2(now());
+
+        elapsed[0] += t1 - t0;
+        elapsed[1] += t2 - t1;
+    }
+
+    const ImpostorResult result = { count, elapsed[0] * 1000.0 / frames, elapsed[1] * 1000.0 / frames };
+    return result;
+}
+
+// 骨格アニメーションの姿勢の計算とスキニングした図形の描画の時間を計る
+//  count: キャラクタの数
+//  lights: 光源の数
+//  frames: 描画するフレーム数
+//  variants: 図形のシェーダ
+//  pool: 姿勢の計算を分担するワーカースレッド
+SkinningResult skinning(int count, int lights, int frames, ShaderVariants &variants, ThreadPool &pool)
+{
+    // 関節が 16 個の管とその骨格を作る
+    static const int joints(16);
+    std::vector<SkinnedShape::Vertex> vertex;
+    std::vector<GLuint> index;
+    Skeleton skeleton;
+    makeSkinnedTube(joints, 4.0f, 0.2f, 12, 2, vertex, index, skeleton);
+    SkinnedShape tube(static_cast<GLsizei>(vertex.size()), vertex.data(),
+                      static_cast<GLsizei>(index.size()), index.data());
+
+    // 管をくねらせる動きと揺らす動きを 30 フレーム分焼き込む
+    static const int keys(30);
+    AnimationClip wave(joints, 30.0f), sway(joints, 30.0f);
+    for(int k = 0; k < keys; k++)
+    {
+        const GLfloat phase(6.283185f * static_cast<GLfloat>(k) / static_cast<GLfloat>(keys));
+        Pose &w(wave.addKey()), &s(sway.addKey());
+        for(int j = 0; j < joints; j++)
+        {
+            const GLfloat y(j == 0 ? 0.0f : 4.0f / joints);
+            w.set(j, Quaternion::rotate(0.2f * sinf(phase + 0.4f * j), 0.0f, 0.0f, 1.0f), 0.0f, y, 0.0f);
+            s.set(j, Quaternion::rotate(0.1f * sinf(phase), 1.0f, 0.0f, 0.0f), 0.0f, y, 0.0f);
+        }
+    }
+
+    // キャラクタごとに開始の時刻と混ぜる割合をずらす
+    Animator animator(skeleton, count);
+    for(int i = 0; i < count; i++)
+    {
+        const GLint c(animator.add(wave, static_cast<GLfloat>(i % keys) / 30.0f));
+        animator.mix(c, &sway, 0.0f, static_cast<GLfloat>(i % 4) * 0.25f);
+    }
+
+    // シェーダと材質を用意する
+    MaterialRegistry material;
+    const GLuint materialIndex(material.add(surface[Glossy]));
+    const ShaderVariants::Variant &v(variants.get(ShaderVariants::choose(lights, surface[Glossy], false, true)));
+    material.update();
+    material.select(0);
+
+    // キャラクタを格子状に並べて視点は場面全体が見える位置に置く
+    const int side(static_cast<int>(ceil(sqrt(static_cast<double>(count)))));
+    const GLfloat distance(side * 1.5f);
+    const Transform view(Transform::lookat(0.0f, distance * 0.6f, distance, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(0.8f, 640.0f / 480.0f, 1.0f, distance * 4.0f));
+    std::vector<Matrix> modelview;
+    std::vector<GLfloat> normalMatrix(count * 9);
+    for(int i = 0; i < count; i++)
+    {
+        const GLfloat x(static_cast<GLfloat>(i % side) - side * 0.5f);
+        const GLfloat z(static_cast<GLfloat>(i / side) - side * 0.5f);
+        const Transform m(view * Transform::translate(x, 0.0f, z));
+        modelview.push_back(m.toMatrix());
+        m.getNormalMatrix(&normalMatrix[i * 9]);
+    }
+
+    // 光源は場面の上に一つずつ置く
+    glUseProgram(v.program);
+    glUniform1i(v.materialLoc, 0);
+    glUniform1i(v.materialIndexLoc, materialIndex);
+    glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, projection.data());
+    std::vector<Vector> Lpos, Lview;
+    std::vector<GLfloat> Lamb, Ldiff, Lspec;
+    makeLights(lights, Vector{ 0.0f, 10.0f, 0.0f, 1.0f }, 20.0f, 0.1f, 0.9f, 0.9f, Lpos, Lamb, Ldiff, Lspec);
+    for(const Vector &p : Lpos) Lview.push_back(view * p);
+    ShaderVariants::setLights(v, lights, Lview[0].data(), Lamb.data(), Ldiff.data(), Lspec.data());
+
+    double elapsed[4] = {};
+    for(int frame = 0; frame < frames; frame++)
+    {
+        // 姿勢の計算を一つのスレッドで行う
+        const double t0(now());
+        animator.update(1.0f / 60.0f);
+
+        // 同じ計算をワーカースレッドで分担する
+        const double t1(now());
+        animator.update(1.0f / 60.0f, &pool);
+
+        // パレットを転送する
+        const double t2(now());
+        animator.upload();
+
+        // キャラクタごとにパレットを結合して描く
+        const double t3(now());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for(int i = 0; i < count; i++)
+        {
+            animator.select(i);
+            glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview[i].data());
+            glUniformMatrix3fv(v.normalMatrixLoc, 1, GL_FALSE, &normalMatrix[i * 9]);
+            tube.draw();
+        }
+        glFinish();
+        const double t4(now());
+
+        elapsed[0] += t1 - t0;
+        elapsed[1] += t2 - t1;
+        elapsed[2] += t3 - t2;
+        elapsed[3] += t4 - t3;
+    }
+
+    const SkinningResult result =
+    {
+        count, joints,
+        elapsed[0] * 1000.0 / frames, elapsed[1] * 1000.0 / frames,
+        elapsed[2] * 1000.0 / frames, elapsed[3] * 1000.0 / frames
+    };
+    return result;
+}
+
+// 区画に分けた地形の上を飛んで区画の作成と転送と描画の時間を計る
+//  lights: 光源の数
+//  frames: 描画するフレーム数
+//  variants: 図形のシェーダ
+//  pool: 区画を作るワーカースレッド
+TerrainResult terrain(int lights, int frames, ShaderVariants &variants, ThreadPool &pool)
+{
+    // 一辺 256 m の区画を視点から 3 km まで置く
+    static const int cells(32);
+    static const GLfloat spacing(8.0f), range(3000.0f);
+    Terrain ground([](GLfloat x, GLfloat z){ return fractalHeight(x, z, 300.0f, 4000.0f, 8); },
+                   pool, cells, spacing, range, 256.0f, 512);
+
+    // シェーダと材質を用意する
+    MaterialRegistry material;
+    const GLuint materialIndex(material.add(surface[Grass]));
+    const ShaderVariants::Variant &v(variants.get(ShaderVariants::choose(lights, surface[Grass])));
+    material.update();
+    material.select(0);
+
+    // 地形の上 400 m を x 方向にフレームあたり 20 m 進む
+    const auto eyeAt([](int frame){ return Vector{ frame * 20.0f, 400.0f, 0.0f, 1.0f }; });
+    Viewport viewport(0.0f, 0.0f, 1.0f, 1.0f, Transform(), 1.0f, range * 1.5f);
+    static const GLsizei target[] = { 640, 480 };
+
+    // 最初の場所の区画が全て揃うまで作っておく
+    const Vector start(eyeAt(0));
+    do
+    {
+        ground.update(start.data());
+        pool.wait();
+    }
+    while(ground.getPending() > 0);
+
+    TerrainResult result = {};
+    result.slots = ground.getSlots();
+    result.vertexBytes = static_cast<long>(ground.getBytes());
+    const unsigned long preloaded(ground.getUploaded());
+    double elapsed[2] = {};
+    long triangles(0);
+    std::vector<Vector> Lpos, Lview;
+    std::vector<GLfloat> Lamb, Ldiff, Lspec;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        const Vector eye(eyeAt(frame));
+        viewport.setView(Transform::lookat(eye[0], eye[1], eye[2], eye[0] + 100.0f, eye[1] - 40.0f, eye[2],
+                                           0.0f, 1.0f, 0.0f));
+
+        // 区画の作成を依頼して出来上がったものを転送する
+        const double t0(now());
+        ground.update(eye.data());
+
+        // 光源は視点の上に一つずつ置く
+        const double t1(now());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        viewport.apply(target, 0.8f);
+        const Transform &view(viewport.getView());
+        glUseProgram(v.program);
+        glUniform1i(v.materialLoc, 0);
+        glUniform1i(v.materialIndexLoc, materialIndex);
+        glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, viewport.getProjection().data());
+        makeLights(lights, Vector{ eye[0], 3000.0f, 0.0f, 1.0f }, 2000.0f, 0.2f, 0.8f, 0.0f, Lpos, Lamb, Ldiff, Lspec);
+        Lview.clear();
+        for(const Vector &p : Lpos) Lview.push_back(view * p);
+        ShaderVariants::setLights(v, lights, Lview[0].data(), Lamb.data(), Ldiff.data(), Lspec.data());
+
+        // 視錐台の中の区画を詳細度を選んで描く
+        triangles += ground.draw(viewport, v);
+        glFinish();
+        const double t2(now());
+
+        elapsed[0] += t1 - t0;
+        elapsed[1] += t2 - t1;
+        result.chunks = std::max(result.chunks, static_cast<int>(ground.getResident()));
+    }
+
+    result.uploaded = static_cast<long>(ground.getUploaded() - preloaded);
+    result.triangles = triangles / frames;
+    result.update = elapsed[0] * 1000.0 / frames;
+    result.draw = elapsed[1] * 1000.0 / frames;
+    return result;
+}
+
+// 図形データの圧縮率と復号の時間を計る
+//  slices: 球の分割数
+//  frames: 繰り返す回数
+//  pool: 復号を分担するワーカースレッド
+MeshResult mesh(int slices, int frames, ThreadPool &pool)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    makeSolidSphere(slices, slices, vertex, index);
+    const GLsizei vertexcount(static_cast<GLsizei>(vertex.size())), indexcount(static_cast<GLsizei>(index.size()));
+    const std::vector<unsigned char> data(MeshCodec::encode(vertex.data(), vertexcount, index.data(), indexcount));
+
+    //メモリに復号する
+    std::vector<Object::Vertex> decodedVertex(vertex.size());
+    std::vector<GLuint> decodedIndex(index.size());
+    const double t0(now());
+    for(int frame = 0; frame < frames; frame++)
+        MeshCodec::decode(data.data(), data.size(), decodedVertex.data(), decodedIndex.data(), &pool);
+    const double decode(now() - t0);
+
+    //マップしたバッファオブジェクトに復号する
+    SolidShapeIndex shape(3, vertexcount, NULL, indexcount, NULL);
+    const double t1(now());
+    for(int frame = 0; frame < frames; frame++)
+    {
+        shape.fill([&data, &pool](Object::Vertex *v, GLuint *i)
+        {
+            return MeshCodec::decode(data.data(), data.size(), v, i, &pool);
+        });
+    }
+    glFinish();
+    const double upload(now() - t1);
+
+    const MeshResult result =
+    {
+        vertexcount, indexcount,
+        static_cast<long>(vertex.size() * sizeof(Object::Vertex) + index.size() * sizeof(GLuint)),
+        static_cast<long>(data.size()),
+        decode * 1000.0 / frames, upload * 1000.0 / frames
+    };
+    return result;
+}
+
+// 計測結果を JSON で書き出す
+//  out: 書き出す先
+//  results: 計測結果
+//  rotation: 回転の求め方ごとの計測結果
+//  particle: パーティクルの計測結果
+//  meshed: 図形データの圧縮の計測結果
+//  impostor: 球のインポスタの計測結果
+//  skinned: 骨格アニメーションの計測結果
+//  terrained: 地形の計測結果
+//  started: 起動の計測結果
+//  frames: 描画したフレーム数
+void write(std::ostream &out, const std::vector<Result> &results, const RotationResult &rotation,
+           const ParticleResult &particle, const MeshResult &meshed, const ImpostorResult &impostor,
+           const SkinningResult &skinned, const TerrainResult &terrained, const StartupResult &started,
+           int frames)
+{
+    out << "{\n  \"frames\": " << frames << ",\n"
+        << "  \"startup\": {\n"
+        << "    \"name\": \"startup\",\n"
+        << "    \"windowMs\": " << started.window << ",\n"
+        << "    \"sourcesMs\": " << started.sources << ",\n"
+        << "    \"compileMs\": " << started.compile << ",\n"
+        << "    \"firstFrameMs\": " << started.firstFrame << "\n"
+        << "  },\n"
+        << "  \"rotation\": {\n"
+        << "    \"name\": \"rotation\",\n"
+        << "    \"objects\": " << rotation.objects << ",\n"
+        << "    \"matrixMs\": " << rotation.matrix << ",\n"
+        << "    \"transformMs\": " << rotation.transform << ",\n"
+        << "    \"quaternionMs\": " << rotation.quaternion << ",\n"
+        << "    \"dualQuaternionMs\": " << rotation.dualQuaternion << "\n"
+        << "  },\n"
+        << "  \"particles\": {\n"
+        << "    \"name\": \"particles\",\n"
+        << "    \"count\": " << particle.count << ",\n"
+        << "    \"updateMs\": " << particle.update << ",\n"
+        << "    \"uploadMs\": " << particle.upload << "\n"
+        << "  },\n"
+        << "  \"mesh\": {\n"
+        << "    \"name\": \"mesh\",\n"
+        << "    \"vertices\": " << meshed.vertices << ",\n"
+        << "    \"indices\": " << meshed.indices << ",\n"
+        << "    \"rawBytes\": " << meshed.rawBytes << ",\n"
+        << "    \"encodedBytes\": " << meshed.encodedBytes << ",\n"
+        << "    \"decodeMs\": " << meshed.decode << ",\n"
+        << "    \"uploadMs\": " << meshed.upload << "\n"
+        << "  },\n"
+        << "  \"impostors\": {\n"
+        << "    \"name\": \"impostors\",\n"
+        << "    \"spheres\": " << impostor.spheres << ",\n"
+        << "    \"tessellatedMs\": " << impostor.tessellated << ",\n"
+        << "    \"impostorMs\": " << impostor.impostor << "\n"
+        << "  },\n"
+        << "  \"skinning\": {\n"
+        << "    \"name\": \"skinning\",\n"
+        << "    \"characters\": " << skinned.characters << ",\n"
+        << "    \"joints\": " << skinned.joints << ",\n"
+        << "    \"serialMs\": " << skinned.serial << ",\n"
+        << "    \"parallelMs\": " << skinned.parallel << ",\n"
+        << "    \"uploadMs\": " << skinned.upload << ",\n"
+        << "    \"drawMs\": " << skinned.draw << "\n"
+        << "  },\n"
+        << "  \"terrain\": {\n"
+        << "    \"name\": \"terrain\",\n"
+        << "    \"chunks\": " << terrained.chunks << ",\n"
+        << "    \"slots\": " << terrained.slots << ",\n"
+        << "    \"vertexBytes\": " << terrained.vertexBytes << ",\n"
+        << "    \"uploaded\": " << terrained.uploaded << ",\n"
+        << "    \"triangles\": " << terrained.triangles << ",\n"
+        << "    \"updateMs\": " << terrained.update << ",\n"
+        << "    \"drawMs\": " << terrained.draw << "\n"
+        << "  },\n"
+        << "  \"scenes\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r(results[i]);
+        out << "    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"objects\": " << r.objects << ",\n"
+            << "      \"lights\": " << r.lights << ",\n"
+            << "      \"materials\": " << r.materials << ",\n"
+            << "      \"cpuMeanMs\": " << r.cpuMean << ",\n"
+            << "      \"cpuMedianMs\": " << r.cpuMedian << ",\n"
+            << "      \"cpuP95Ms\": " << r.cpuP95 << ",\n"
+            << "      \"cpuMaxMs\": " << r.cpuMax << ",\n"
+            << "      \"frameMeanMs\": " << r.frameMean << ",\n"
+            << "      \"drawCalls\": " << r.drawCalls << ",\n"
+            << "      \"stateChanges\": " << r.stateChanges << ",\n"
+            << "      \"uniformUpdates\": " << r.uniformUpdates << ",\n"
+            << "      \"gpuBufferBytes\": " << r.gpuBufferBytes << ",\n"
+            << "      \"gpuAllocatedBytes\": " << r.gpuAllocatedBytes << ",\n"
+            << "      \"gpuPaddingBytes\": " << r.gpuPaddingBytes << ",\n"
+            << "      \"maxRssBytes\": " << r.maxRssBytes << "\n"
+            << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// 保存してある結果から場面の値を取り出す（このプログラムが書き出した JSON だけを読む）
+//  json: 保存してある結果
+//  name: 場面の名前
+//  key: 値の名前
+//  value: 取り出した値の格納先
+bool lookup(const std::string &json, const std::string &name, const std::string &key, double &value)
+{
+    const size_t scene(json.find("\"name\": \"" + name + "\""));
+    if(scene == std::string::npos) return false;
+    const size_t end(json.find('}', scene));
+    const size_t pos(json.find("\"" + key + "\": ", scene));
+    if(pos == std::string::npos || pos > end) return false;
+    value = atof(json.c_str() + pos + key.size() + 4);
+    return true;
+}
+
+// 保存してある結果と比べる
+//  json: 保存してある結果
+//  results: 今回の計測結果
+//  rotation: 今回の回転の求め方ごとの計測結果
+//  particle: 今回のパーティクルの計測結果
+//  meshed: 今回の図形データの圧縮の計測結果
+//  impostor: 今回の球のインポスタの計測結果
+//  skinned: 今回の骨格アニメーションの計測結果
+//  terrained: 今回の地形の計測結果
+//  started: 今回の起動の計測結果
+//  tolerance: 許容する悪化の割合
+//  戻り値: 悪化していなければ true
+bool compare(const std::string &json, const std::vector<Result> &results, const RotationResult &rotation,
+             const ParticleResult &particle, const MeshResult &meshed, const ImpostorResult &impostor,
+             const SkinningResult &skinned, const TerrainResult &terrained, const StartupResult &started,
+             double tolerance)
+{
+    bool ok(true);
+
+    // 四元数と双対四元数の経路とパーティクルと図形データの復号とインポスタと骨格アニメーションと
+    // 地形と最初のフレームまでの時間は
+    // 許容する割合を超えて遅くなったら悪化とする
+    const struct { const char *name; const char *key; double value; } paths[] =
+    {
+        { "rotation", "quaternionMs", rotation.quaternion },
+        { "rotation", "dualQuaternionMs", rotation.dualQuaternion },
+        { "particles", "updateMs", particle.update },
+        { "particles", "uploadMs", particle.upload },
+        { "mesh", "decodeMs", meshed.decode },
+        { "mesh", "uploadMs", meshed.upload },
+        { "impostors", "impostorMs", impostor.impostor },
+        { "skinning", "parallelMs", skinned.parallel },
+        { "skinning", "drawMs", skinned.draw },
+        { "terrain", "updateMs", terrained.update },
+        { "terrain", "drawMs", terrained.draw },
+        { "startup", "firstFrameMs", started.firstFrame }
+    };
+    for(const auto &p : paths)
+    {
+        double base;
+        if(!lookup(json, p.name, p.key, base)) continue;
+        if(p.value > base * (1.0 + tolerance))
+        {
+            std::cerr << "Regression: " << p.name << " " << p.key << " " << base << " -> " << p.value << std::endl;
+            ok = false;
+        }
+    }
+
+    // 同じ図形を圧縮するので大きくなったら悪化とする
+    double encoded;
+    if(lookup(json, "mesh", "encodedBytes", encoded) && meshed.encodedBytes > static_cast<long>(encoded))
+    {
+        std::cerr << "Regression: mesh encodedBytes " << static_cast<long>(encoded)
+                  << " -> " << meshed.encodedBytes << std::endl;
+        ok = false;
+    }
+
+    for(const Result &r : results)
+    {
+        // 時間は許容する割合を超えて遅くなったら悪化とする
+        const struct { const char *key; double value; } timing[] =
+        {
+            { "cpuMedianMs", r.cpuMedian },
+            { "cpuP95Ms", r.cpuP95 },
+            { "frameMeanMs", r.frameMean }
+        };
+        for(const auto &t : timing)
+        {
+            double base;
+            if(!lookup(json, r.name, t.key, base)) continue;
+            if(t.value > base * (1.0 + tolerance))
+            {
+                std::cerr << "Regression: " << r.name << " " << t.key << " "
+                          << base << " -> " << t.value << std::endl;
+                ok = false;
+            }
+        }
+
+        // 命令の数は決まった場面なので増えたら悪化とする
+        const struct { const char *key; long value; } counts[] =
+        {
+            { "drawCalls", r.drawCalls },
+            { "stateChanges", r.stateChanges },
+            { "uniformUpdates", r.uniformUpdates },
+            { "gpuBufferBytes", r.gpuBufferBytes },
+            { "gpuAllocatedBytes", r.gpuAllocatedBytes },
+            { "gpuPaddingBytes", r.gpuPaddingBytes }
+        };
+        for(const auto &c : counts)
+        {
+            double base;
+            if(!lookup(json, r.name, c.key, base)) continue;
+            if(c.value > static_cast<long>(base))
+            {
+                std::cerr << "Regression: " << r.name << " " << c.key << " "
+                          << static_cast<long>(base) << " -> " << c.value << std::endl;
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+    // 引数を調べる
+    int frames(300);
+    const char *output(NULL);
+    const char *baseline(NULL);
+    bool save(false);
+    double tolerance(0.1);
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-frames") == 0 && i + 1 < argc) frames = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "-output") == 0 && i + 1 < argc) output = argv[++i];
+        else if(strcmp(argv[i], "-baseline") == 0 && i + 1 < argc) baseline = argv[++i];
+        else if(strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc) tolerance = atof(argv[++i]);
+        else if(strcmp(argv[i], "-save") == 0) save = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-frames n] [-output file] [-baseline file] [-save] [-tolerance ratio]" << std::endl;
+            return 2;
+        }
+    }
+
+    // 起動の処理を分担するワーカースレッド（起動の後はパーティクルの更新と図形データの復号を分担する）
+    ThreadPool pool;
+
+    // ウィンドウを作っている間にワーカースレッドでシェーダのソースを読み込む
+    Startup startup(pool);
+    std::vector<GLchar> source[2];
+    const int sources(startup.add("shader sources", [&source]
+    {
+        source[0] = ShaderVariants::read("point.vert");
+        source[1] = ShaderVariants::read("point.frag");
+    }));
+
+    //GLFW初期化
+    if(glfwInit() == GL_FALSE){
+        std::cerr << "Can't initialize GLFW" << std::endl;
+        return 1;
+    }
+    atexit(glfwTerminate);
+
+    // OpenGL Version 3.3 Core Profile のウィンドウを表示せずに作る（インスタンス描画の glVertexAttribDivisor は 3.3 から）
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    Window window(640, 480, "benchmark");
+
+    // 垂直同期を待たない
+    glfwSwapInterval(0);
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+    const int context(startup.mark("window"));
+
+    // ソースを読み込んだら全ての場面で使う機能の組み合わせのシェーダをコンパイルしてリンクを待つ
+    std::unique_ptr<ShaderVariants> variants;
+    const int compile(startup.add("shader compile", [&]
+    {
+        variants.reset(new ShaderVariants(std::move(source[0]), std::move(source[1])));
+        for(const SceneSize &size : scenes)
+        {
+            variants -> request(ShaderVariants::choose(size.lights, surface[Glossy]));
+            variants -> request(ShaderVariants::choose(size.lights, surface[Matte]));
+        }
+        for(const SceneSize &size : scenes)
+        {
+            variants -> get(ShaderVariants::choose(size.lights, surface[Glossy]));
+            variants -> get(ShaderVariants::choose(size.lights, surface[Matte]));
+        }
+    }, { context, sources }, Startup::Main));
+
+    // 最初のフレームを表示して描画が終わるまで待つ
+    startup.add("first frame", [&startup, &window]
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        window.swapBuffers();
+        glFinish();
+        startup.firstFrame();
+    }, { compile }, Startup::Main);
+    startup.run();
+
+    // 起動の処理ごとの時間を取り出す
+    const std::vector<Startup::Phase> phases(startup.getPhases());
+    const auto elapsed([&phases](int id){ return (phases[id].end - phases[id].start) * 1000.0; });
+    const StartupResult started = { elapsed(context), elapsed(sources), elapsed(compile), startup.getFirstFrame() * 1000.0 };
+    std::cerr << "startup: window " << started.window << " ms, sources " << started.sources << " ms, compile "
+              << started.compile << " ms, first frame " << started.firstFrame << " ms" << std::endl;
+
+    // 場面ごとに計測する
+    std::vector<Result> results;
+    for(const SceneSize &size : scenes)
+    {
+        results.push_back(run(size, frames, *variants));
+        std::cerr << size.name << ": " << results.back().cpuMedian << " ms" << std::endl;
+    }
+
+    // 一番大きな場面と同じ数の図形で回転の求め方を比べる
+    const SceneSize &largest(scenes[sizeof scenes / sizeof scenes[0] - 1]);
+    const RotationResult rotated(rotation(largest.spheres + largest.cubes, frames));
+    std::cerr << "rotation: matrix " << rotated.matrix << " ms, quaternion " << rotated.quaternion
+              << " ms, dual quaternion " << rotated.dualQuaternion << " ms" << std::endl;
+
+    // 百万個のパーティクルを更新して転送する
+    const ParticleResult particle(particles(1000000, frames, pool));
+    std::cerr << "particles: update " << particle.update << " ms, upload " << particle.upload << " ms" << std::endl;
+
+    // 512 × 512 に分割した球の図形データを圧縮して復号する
+    const MeshResult meshed(mesh(512, 20, pool));
+    std::cerr << "mesh: " << meshed.rawBytes << " -> " << meshed.encodedBytes << " bytes, decode "
+              << meshed.decode << " ms, upload " << meshed.upload << " ms" << std::endl;
+
+    // 一番大きな場面と同じ数の球を分割した図形とインポスタで描く
+    const ImpostorResult impostor(impostors(largest.spheres, largest.lights, frames, *variants));
+    std::cerr << "impostors: " << impostor.spheres << " spheres, tessellated " << impostor.tessellated
+              << " ms, impostor " << impostor.impostor << " ms" << std::endl;
+
+    // 二千体のキャラクタの姿勢を求めてスキニングした図形を描く
+    const SkinningResult skinned(skinning(2000, largest.lights, frames, *variants, pool));
+    std::cerr << "skinning: " << skinned.characters << " characters, serial " << skinned.serial << " ms, parallel "
+              << skinned.parallel << " ms, upload " << skinned.upload << " ms, draw " << skinned.draw << " ms" << std::endl;
+
+    // 区画に分けた地形の上を飛ぶ
+    const TerrainResult terrained(terrain(largest.lights, frames, *variants, pool));
+    std::cerr << "terrain: " << terrained.chunks << " chunks (" << terrained.vertexBytes << " bytes), "
+              << terrained.triangles << " triangles, update " << terrained.update << " ms, draw "
+              << terrained.draw << " ms" << std::endl;
+
+    // 結果を書き出す
+    if(output != NULL)
+    {
+        std::ofstream file(output);
+        write(file, results, rotated, particle, meshed, impostor, skinned, terrained, started, frames);
+    }
+    else write(std::cout, results, rotated, particle, meshed, impostor, skinned, terrained, started, frames);
+
+    if(baseline == NULL) return 0;
+
+    // 結果を保存する
+    if(save)
+    {
+        std::ofstream file(baseline);
+        write(file, results, rotated, particle, meshed, impostor, skinned, terrained, started, frames);
+        return 0;
+    }
+
+    // 保存してある結果と比べる
+    std::ifstream file(baseline);
+    if(file.fail())
+    {
+        std::cerr << "No baseline: " << baseline << " (run with -save to create it)" << std::endl;
+        return 0;
+    }
+    std::stringstream json;
+    json << file.rdbuf();
+
+    return compare(json.str(), results, rotated, particle, meshed, impostor, skinned, terrained, started, tolerance) ? 0 : 1;
+}
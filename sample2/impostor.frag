@@ -0,0 +1,54 @@
+#version 150 core
+// 機能の組み合わせ（ShaderVariants が #version の直後に #define を差し込む）
+#ifndef LCOUNT
+#define LCOUNT 2     //光源の数
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1   //鏡面反射光を計算するか
+#endif
+const int Lcount = LCOUNT;
+uniform mat4 projection;
+uniform vec4 Lpos[Lcount]; //光源の位置
+uniform vec3 Lamb[Lcount];
+uniform vec3 Ldiff[Lcount];
+uniform vec3 Lspec[Lcount]; //光源強度の鏡面反射光成分
+in vec3 Q;
+flat in vec3 C;
+flat in float R;
+flat in vec3 Kamb;  // 環境光の反射係数
+flat in vec3 Kdiff; //拡散反射係数
+flat in vec3 Kspec; //鏡面反射係数
+flat in float Kshi; //輝き係数
+out vec4 fragment;
+
+void main(){
+    //視点から四角形上の点に向かう光線と球の手前の交点を求める
+    float a = dot(Q, Q);
+    float b = dot(Q, C);
+    float c = dot(C, C) - R * R;
+    float disc = b * b - a * c;
+    if(disc < 0.0) discard;
+    vec4 P = vec4(Q * ((b - sqrt(disc)) / a), 1.0);
+    vec3 N = (P.xyz - C) / R;
+
+    //交点の深度を書き込む
+    vec4 clip = projection * P;
+    gl_FragDepth = (clip.z / clip.w * (gl_DepthRange.far - gl_DepthRange.near)
+        + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+    //陰影は point.frag と同じ
+    vec3 V = -normalize(P.xyz);
+    vec3 Idiff = vec3(0.0);
+    vec3 Ispec = vec3(0.0);
+    for(int i = 0; i < Lcount; i++)
+    {
+        vec3 L = normalize((Lpos[i] * P.w - P * Lpos[i].w).xyz);
+        vec3 Iamb = Kamb * Lamb[i];
+        Idiff += max(dot(N,L), 0.0) * Kdiff * Ldiff[i] + Iamb;
+#if SPECULAR
+        vec3 H = normalize(L + V);
+        Ispec += pow(max(dot(N,H), 0.0), Kshi) * Kspec * Lspec[i];
+#endif
+    }
+    fragment = vec4(Idiff + Ispec, 1.0);
+}
@@ -0,0 +1,50 @@
+#version 150 core
+// 機能の組み合わせ（ShaderVariants が #version の直後に #define を差し込む）
+#ifndef LCOUNT
+#define LCOUNT 2     //光源の数
+#endif
+uniform mat4 modelview;
+uniform mat4 projection;
+uniform samplerBuffer material; //材質データ(std140 の Material の配列）
+in vec2 position;        //四角形の四隅（-1〜1）
+in vec4 instanceSphere;  //インスタンスごとの球の中心と半径
+in int instanceMaterial; //インスタンスごとの材質の番号
+out vec3 Q;              //四角形上の点（視点座標系）
+flat out vec3 C;         //球の中心（視点座標系）
+flat out float R;        //球の半径（視点座標系）
+flat out vec3 Kamb;  // 環境光の反射係数
+flat out vec3 Kdiff; //拡散反射係数
+flat out vec3 Kspec; //鏡面反射係数
+flat out float Kshi; //輝き係数
+
+void main(){
+    //材質を取り出す（一つの材質はテクセル三つ分）
+    vec4 K0 = texelFetch(material, instanceMaterial * 3);
+    vec4 K1 = texelFetch(material, instanceMaterial * 3 + 1);
+    vec4 K2 = texelFetch(material, instanceMaterial * 3 + 2);
+    Kamb = K0.rgb;
+    Kdiff = K1.rgb;
+    Kspec = K2.rgb;
+    Kshi = K2.a;
+
+    //球の中心と半径を視点座標系に移す（拡大率は均等とする）
+    C = (modelview * vec4(instanceSphere.xyz, 1.0)).xyz;
+    R = instanceSphere.w * length(modelview[0].xyz);
+
+    //視点が球の中にあれば描かない
+    float d2 = dot(C, C);
+    if(d2 <= R * R)
+    {
+        Q = vec3(0.0);
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    //視線に垂直で球の中心を通る平面上に、視点からの接線の円錐の断面を囲む四角形を置く
+    vec3 w = C / sqrt(d2);
+    vec3 u = abs(w.y) < 0.99 ? normalize(cross(w, vec3(0.0, 1.0, 0.0))) : vec3(1.0, 0.0, 0.0);
+    vec3 v = cross(u, w);
+    float s = R * sqrt(d2 / (d2 - R * R));
+    Q = C + (position.x * u + position.y * v) * s;
+    gl_Position = projection * vec4(Q, 1.0);
+}
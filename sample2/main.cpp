@@ -1,4 +1,5 @@
 #include<cstdlib>
+#include<cstring>
 #include<cmath>
 #include<iostream>
 #include<fstream>
@@ -6,8 +7,11 @@
 #include<memory>
 #include<GL/glew.h>
 #include<GLFW/glfw3.h>
+#include "GlTrace.h"
 #include "Window.h"
 #include "Matrix.h"
+#include "Transform.h"
+#include "Quaternion.h"
 #include "Vector.h"
 #include "Shape.h"
 #include "ShapeIndex.h"
@@ -15,228 +19,318 @@
 #include "SolidShape.h"
 #include "Uniform.h"
 #include "Material.h"
+#include "MaterialRegistry.h"
+#include "Program.h"
+#include "ShaderVariants.h"
+#include "Simulation.h"
+#include "InputQueue.h"
+#include "Geometry.h"
+#include "ThreadPool.h"
+#include "ParticleSystem.h"
+#include "Picking.h"
+#include "FramePacer.h"
+#include "DynamicResolution.h"
+#include "Viewport.h"
+#include "FrameCapture.h"
+#include "Startup.h"
+#include "FrameRecorder.h"
+#include "SphereImpostors.h"
 /*
  Vectorはベクトルであってvectorではない
  紛らわしいがこれが一番名前として分かりやすいので採用
 */
 
-// シェーダオブジェクトのコンパイル結果を表示する
-// shader: シェーダオブジェクト名
-// str:    コンパイルエラーが発生した場所を示す文字列
-
-GLboolean printShaderInfoLog(GLuint shader,const char *str){
-    //コンパイル結果を取得する
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if(status == GL_FALSE) std :: cerr << "Compile Error in " << str << std::endl;
-    
-    //シェーダのコンパイル時のログの長さを取得する
-    GLsizei bufSize;
-    glGetShaderiv(shader,GL_INFO_LOG_LENGTH,&bufSize);
-    
-    if(bufSize > 1){
-        //シェーダのコンパイル時のログの内容を取得する
-        std::vector<GLchar> infoLog(bufSize);
-        GLsizei length;
-        glGetShaderInfoLog(shader,bufSize,&length,&infoLog[0]);
-        std::cerr << &infoLog[0] << std::endl;
-    }
+// シミュレーションのスレッドが更新する場面の状態
+struct SceneState
+{
+    //図形の向き
+    Quaternion orientation;
     
-    return static_cast<GLboolean>(status);
-}
-
-//プログラムオブジェクトのリンク結果をg表示する
-// program:プログラムオブジェクト名
-
-GLboolean printProgramInfoLog(GLuint program){
-    //リンク結果を取得する
-    GLint status;
-    glGetProgramiv(program,GL_LINK_STATUS,&status);
-    if(status == GL_FALSE) std::cerr << "Link Error." << std::endl;
-    
-    //シェーダのリンク時のログの長さを取得する
-    GLsizei bufsize;
-    glGetProgramiv(program,GL_INFO_LOG_LENGTH,&bufsize);
-    
-    if(bufsize > 1){
-        //シェーダのリンク時のログの内容を取得する
-        std::vector<GLchar> infoLog(bufsize);
-        GLsizei length;
-        glGetProgramInfoLog(program,bufsize,&length,&infoLog[0]);
-        std::cerr << &infoLog[0] << std::endl;
-    }
+    //図形の正規化デバイス座標系上での位置
+    GLfloat location[2];
     
-    return static_cast<GLboolean>(status);
-}
-
+    //反映した入力の時刻（glfwGetTime() の値でこれより前の入力は反映済み）
+    double input;
+};
 
-//   プログラムオブジェクトを作成する
-//   vsrc: バーテックスシェーダのソースプログラムの表示
-//   fsrc: フラグメントシェーダのソースプログラムの文字列
+// 二つの刻みの間の場面の状態を求める
+//  a: 一つ前の刻みの状態
+//  b: 最新の刻みの状態
+//  t: 補間の割合
+SceneState interpolate(const SceneState &a, const SceneState &b, float t)
+{
+    const SceneState s =
+    {
+        nlerp(a.orientation, b.orientation, t),
+        {
+            a.location[0] + (b.location[0] - a.location[0]) * t,
+            a.location[1] + (b.location[1] - a.location[1]) * t
+        },
+        b.input
+    };
+    return s;
+}
 
-GLuint createProgram(const char *vsrc, const char *fsrc){
-    //空のプログラムオブジェクトを作成する
-    const GLuint program(glCreateProgram());
+// 入力イベントに従って図形を動かす
+//  シミュレーションのスレッドでは apply() で刻みごとに入力を反映し、
+//  描画のスレッドでは別に作ったものの latch() で刻みにまだ反映されていない入力を提出の直前に足す
+class Control
+{
+    //矢印キー（左、右、下、上）
+    static constexpr int arrow[] = { GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_DOWN, GLFW_KEY_UP };
+    
+    //入力イベントの読み出し
+    InputQueue::Reader reader;
+    
+    //マウスの左ボタンで動かすビューポート（変わらない領域だけを読むので描画のスレッドと共有できる）
+    const Viewport &viewport;
+    
+    //矢印キーが押されているか
+    bool down[4];
+    
+    //矢印キーが押された時刻
+    double since[4];
+    
+    //マウスの左ボタンが押されているか
+    bool drag;
+    
+    //ドラッグした位置（ビューポートの正規化デバイス座標系）とその入力の時刻
+    GLfloat target[2];
+    double moved;
+    
+    //ウィンドウのサイズ
+    GLfloat size[2];
+    
+    //前の刻みの時刻
+    double last;
     
-    //バーテックスシェーダのソースがあった時
-    if(vsrc != NULL){
-        //バーテックスシェーダのシェーダオブジェクトを作成する
-        const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
-        glShaderSource(vobj,1,&vsrc,NULL);
-        glCompileShader(vobj);
+    //マウスの左ボタンが押されていたらマウスカーソルのビューポートの正規化デバイス座標系上での位置に移動する
+    //  e: マウスの入力イベント
+    //  戻り値: 移動したら true
+    bool follow(const InputEvent &e)
+    {
+        GLfloat ndc[2];
+        if(!drag || !viewport.contains(e.x, e.y, size, ndc)) return false;
+        
+        target[0] = ndc[0];
+        target[1] = ndc[1];
+        moved = e.time;
+        return true;
+    }
+    
+    //溜まっている入力イベントを読み出して入力の状態を更新する
+    //  now: 現在の時刻
+    //  from: この時刻より後に押されていた時間だけを数える
+    //  held: 押して離した矢印キーが押されていた時間の加算先
+    //  戻り値: 図形を動かす入力イベントのうち一番古いものの時刻（なければ負）
+    double read(double now, double from, double *held)
+    {
+        double oldest(-1.0);
         
-        if(printShaderInfoLog(vobj,"vertex shader"))
-            glAttachShader(program,vobj);
-        glDeleteShader(vobj);
+        //マウスカーソルのビューポートの正規化デバイス座標系上での位置
+        GLfloat ndc[2];
         
+        reader.drain([&](const InputEvent &e)
+        {
+            const double t(std::min(std::max(e.time, from), now));
+            bool used(false);
+            
+            switch(e.type)
+            {
+            case InputEvent::Key:
+                for(int i = 0; i < 4; i++)
+                {
+                    if(e.code != arrow[i]) continue;
+                    used = true;
+                    
+                    if(e.action == GLFW_PRESS && !down[i])
+                    {
+                        down[i] = true;
+                        since[i] = t;
+                    }
+                    else if(e.action == GLFW_RELEASE && down[i])
+                    {
+                        //刻みの間に押して離しても押していた時間の分だけ動かす
+                        held[i] += t - std::max(since[i], from);
+                        down[i] = false;
+                    }
+                }
+                break;
+                
+            case InputEvent::MouseButton:
+                if(e.code != GLFW_MOUSE_BUTTON_1) break;
+                
+                //ビューポートの中で押したときだけ動かす
+                drag = e.action != GLFW_RELEASE && viewport.contains(e.x, e.y, size, ndc);
+                
+                //押したときはその位置に移動する
+                if(follow(e)) used = true;
+                break;
+                
+            case InputEvent::CursorPos:
+                if(follow(e)) used = true;
+                break;
+                
+            case InputEvent::Resize:
+                size[0] = static_cast<GLfloat>(e.x);
+                size[1] = static_cast<GLfloat>(e.y);
+                break;
+                
+            default:
+                break;
+            }
+            
+            if(used && (oldest < 0.0 || e.time < oldest)) oldest = e.time;
+        });
         
+        return oldest;
     }
     
-    
-    if(fsrc != NULL){
-        //フラグメントシェーダのシェーダオブジェクトを作成する
-        const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
-        glShaderSource(fobj,1,&fsrc,NULL);
-        glCompileShader(fobj);
+    //from より後の入力で図形を動かす
+    //  s: 場面の状態
+    //  now: 現在の時刻
+    //  from: この時刻より後の入力だけを反映する
+    //  held: 押して離した矢印キーが押されていた時間
+    void move(SceneState &s, double now, double from, double *held) const
+    {
+        //ドラッグした位置に移動する
+        if(moved > from)
+        {
+            s.location[0] = target[0];
+            s.location[1] = target[1];
+        }
         
-        //フラグメントシェーダのシェーダオブジェクトをプログラムオブジェクトに組み込む
-        if(printShaderInfoLog(fobj,"fragment shader"))
-            glAttachShader(program,fobj);
-        glDeleteShader(fobj);
+        //押されたままの矢印キーは now まで押されていたとする
+        for(int i = 0; i < 4; i++)
+            if(down[i]) held[i] += now - std::max(since[i], from);
+        
+        //押されていた時間に比例して移動する（一秒間に 600 画素）
+        s.location[0] += static_cast<GLfloat>((held[1] - held[0]) * 600.0) / size[0];
+        s.location[1] += static_cast<GLfloat>((held[3] - held[2]) * 600.0) / size[1];
     }
     
-    //プログラムオブジェクトをリンクする
-    glBindAttribLocation(program,0,"position");
-    glBindAttribLocation(program, 1, "normal");
-    glBindFragDataLocation(program,0,"fragment");
-    glLinkProgram(program);
+public:
     
-    //作成したプログラムオブジェクトを返す
-    if(printProgramInfoLog(program))
-        return program;
+    //コンストラクタ
+    //  events: 入力イベントのキュー
+    //  viewport: マウスの左ボタンで動かすビューポート
+    Control(const InputQueue &events, const Viewport &viewport)
+    : reader(events), viewport(viewport), down{}, since{}, drag(false), target{}, moved(-1.0)
+    , size{ 1.0f, 1.0f }, last(glfwGetTime())
+    {
+    }
     
-    //プログラムオブジェクトが作成できなければ0を返す
-    glDeleteProgram(program);
-    return 0;
-}
-
-
+    //前の刻みから後の入力イベントを図形の状態に反映する（シミュレーションのスレッドで呼ぶ）
+    //  s: 場面の状態
+    void apply(SceneState &s)
+    {
+        const double now(glfwGetTime());
+        
+        //矢印キーが押されていた時間
+        double held[4] = {};
+        
+        read(now, last, held);
+        move(s, now, last, held);
+        last = now;
+        
+        //ここまでの入力を反映した
+        s.input = now;
+    }
+    
+    //シミュレーションの刻みにまだ反映されていない入力を描画する状態に足す（描画のスレッドで提出の直前に呼ぶ）
+    //  s: シミュレーションから取り出した場面の状態（s.input までの入力は反映済み）
+    //  戻り値: このフレームで初めて読んだ図形を動かす入力イベントのうち一番古いものの時刻（なければ負）
+    double latch(SceneState &s)
+    {
+        const double now(glfwGetTime());
+        
+        //矢印キーが押されていた時間
+        double held[4] = {};
+        
+        const double oldest(read(now, s.input, held));
+        move(s, now, s.input, held);
+        return oldest;
+    }
+};
+constexpr int Control::arrow[];
 
-//シェーダのソースファイルを読み込んだメモリを返す
-//name: シェーダのソースファイル名
-//buffer: 読み込んだソースファイルのテキスト
-bool readShaderSource(const char *name,std::vector<GLchar> &buffer){
-    //ファイル名がNULL
-    if(name == NULL) return false;
-    
-    //ソースファイルを開く
-    std::ifstream file(name,std::ios::binary);
-    if(file.fail()){
-        //開けなかった場合
-        std::cerr << "Error: Can't open source file: " << name << std::endl;
-        return false;
+int main(int argc, char *argv[]) {
+    
+    // 引数を調べる
+    //  -capture file: 描画したフレームを書き出す（.y4m なら一つの動画、それ以外は frame%05lu.png のように整数の変換を一つだけ含む書式の連番の PNG）
+    //  -headless frames: ウィンドウを表示せずに垂直同期を待たないで決まった数のフレームを描画する
+    //  -memory file: フレームごとの GPU メモリの使用量を CSV で書き出す
+    //  -trace file: フレームごとの GL の呼び出しの回数を CSV で書き出す（GL_TRACE を組み込んだときだけ）
+    //  -record file: フレームごとの描画を replay で再現できるように書き出す（インポスタの描画は記録しない）
+    //  -impostors: 球を分割した図形の代わりにフラグメントシェーダで光線と交差させるインポスタで描く
+    //  -split: メインのウィンドウを左右に分けて真上からも見て、横から見る二つ目のウィンドウも開く
+    const char *capturePath(NULL);
+    const char *memoryPath(NULL);
+    const char *tracePath(NULL);
+    const char *recordPath(NULL);
+    int headless(0);
+    bool impostor(false);
+    bool split(false);
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-capture") == 0 && i + 1 < argc) capturePath = argv[++i];
+        else if(strcmp(argv[i], "-headless") == 0 && i + 1 < argc) headless = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "-memory") == 0 && i + 1 < argc) memoryPath = argv[++i];
+        else if(strcmp(argv[i], "-trace") == 0 && i + 1 < argc && GlTrace::available) tracePath = argv[++i];
+        else if(strcmp(argv[i], "-record") == 0 && i + 1 < argc) recordPath = argv[++i];
+        else if(strcmp(argv[i], "-impostors") == 0) impostor = true;
+        else if(strcmp(argv[i], "-split") == 0) split = true;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-capture file] [-headless frames] [-memory file]"
+                      << (GlTrace::available ? " [-trace file]" : "") << " [-record file] [-impostors] [-split]" << std::endl;
+            return 2;
+        }
     }
     
-    //ファイルの末尾に移動し現在位置（＝ファイルサイズ）を得る
-    file.seekg(0L,std::ios::end);
-    GLsizei length = static_cast<GLsizei>(file.tellg());
+    // ワーカースレッドで行う起動の処理の結果（処理が終わるまで待つ startup より先に作って後で壊す）
+    std::vector<GLchar> pointSource[2], particleSource[2], impostorSource[2];
+    std::vector<Object::Vertex> solidSphereVertex;
+    std::vector<GLuint> solidSphereIndex;
+    std::shared_ptr<PickMesh> sphereMesh;
     
-    //ファイルサイズのメモリを確保
-    buffer.resize(length + 4);
+    //球の分割数
+    const int slices(16), stacks(8);
     
-    //ファイルを先頭から読み込む
-    file.seekg(0L,std::ios::beg);
-    file.read(buffer.data(),length);
-    buffer[length] = '\n';
+    // 起動の処理を分担するワーカースレッド（起動の後はパーティクルの更新とフレームの書き出しを分担する）
+    ThreadPool pool;
     
-    if(file.fail()){
-        //上手く読み込めなかった
-        std::cerr << "Error: Could not read source file" << name << std::endl;
-        file.close();
-        return false;
-    }
+    // 起動の処理の依存関係と時間の記録
+    Startup startup(pool);
     
-    //読み込み成功
-    file.close();
-    return true;
-}
-
-
-//シェーダのソースファイルを読み込んでプログラムオブジェクトを作成する
-//  vert:バーテックスシェーダのソースファイル名
-//  frag:フラグメントシェーダのソースファイル名
-GLuint loadProgram(const char *vert,const char *frag){
-    //シェーダのソースファイルを読み込む
-    std::vector<GLchar> vsrc;
-    const bool vstat(readShaderSource(vert, vsrc));
-    std::vector<GLchar> fsrc;
-    const bool fstat(readShaderSource(frag, fsrc));
-    
-    //プログラムオブジェクトを作成する
-    return vstat && fstat ? createProgram(vsrc.data(), fsrc.data()) : 0;
-}
-
-
-
-// 面ごとに法線を変えた六面体の頂点属性
-constexpr Object::Vertex solidCubeVertex[] =
-{
-    // 左
-    { -1.0f, -1.0f, -1.0f,  -1.0f, 0.0f, 0.0f }, 
-    { -1.0f, -1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
-    { -1.0f,  1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
-    { -1.0f, -1.0f, -1.0f,  -1.0f, 0.0f, 0.0f },
-    { -1.0f,  1.0f,  1.0f,  -1.0f, 0.0f, 0.0f },
-    { -1.0f,  1.0f, -1.0f,  -1.0f, 0.0f, 0.0f },
-    // 裏
-    {  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    { -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    { -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    {  1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    { -1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    {  1.0f,  1.0f, -1.0f, 0.0f, 0.0f, -1.0f },
-    // 下
-    { -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
-    {  1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
-    {  1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
-    { -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f },
-    {  1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
-    { -1.0f, -1.0f,  1.0f, 0.0f, -1.0f, 0.0f },
-    // 右
-    { 1.0f, -1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
-    { 1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
-    { 1.0f,  1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
-    { 1.0f, -1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
-    { 1.0f,  1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
-    { 1.0f,  1.0f,  1.0f, 1.0f, 0.0f, 0.0f },
-    // 上
-    { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
-    { -1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
-    {  1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
-    { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
-    {  1.0f, 1.0f,  1.0f, 0.0f, 1.0f, 0.0f },
-    {  1.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f },
-    // 前
-    { -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
-    {  1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
-    {  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
-    { -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
-    {  1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f },
-    { -1.0f,  1.0f, 1.0f, 0.0f, 0.0f, 1.0f }
-};
-
-// 六面体の面を塗りつぶす三角形の頂点のインデックス
-constexpr GLuint solidCubeIndex[] =
-{
-    0, 1, 2, 3, 4, 5, // 左
-    6, 7, 8, 9, 10, 11,//裏
-    12, 13, 14, 15, 16, 17, // 下
-    18, 19, 20, 21, 22, 23, // 右
-    24, 25, 26, 27, 28, 29, // 上
-    30, 31, 32, 33, 34, 35 //前
-};
-
-int main() {
+    // ウィンドウを作っている間にワーカースレッドでシェーダのソースを読み込む
+    const int pointSources(startup.add("point shader sources", [&pointSource, &impostorSource, impostor]
+    {
+        pointSource[0] = ShaderVariants::read("point.vert");
+        pointSource[1] = ShaderVariants::read("point.frag");
+        if(!impostor) return;
+        impostorSource[0] = ShaderVariants::read("impostor.vert");
+        impostorSource[1] = ShaderVariants::read("impostor.frag");
+    }));
+    const int particleSources(startup.add("particle shader sources", [&particleSource]
+    {
+        particleSource[0] = ShaderVariants::read("particle.vert");
+        particleSource[1] = ShaderVariants::read("particle.frag");
+    }));
+    
+    //ワーカースレッドで球の頂点属性とインデックスを作る
+    const int sphere(startup.add("sphere mesh", [&]
+    {
+        makeSolidSphere(slices, stacks, solidSphereVertex, solidSphereIndex);
+    }));
+    
+    //球ができたら選択に使う境界ボリューム階層を作る
+    startup.add("pick mesh", [&]
+    {
+        sphereMesh.reset(new PickMesh(
+            static_cast<GLsizei>(solidSphereVertex.size()), solidSphereVertex.data(),
+            static_cast<GLsizei>(solidSphereIndex.size()), solidSphereIndex.data()));
+    }, { sphere });
     
     //GLFW初期化
     if(glfwInit() == GL_FALSE){
@@ -248,103 +342,48 @@ int main() {
     //プログラム終了時の処理を登録する
     atexit(glfwTerminate);
     
-    // OpenGL Version 3.2 Core Profile を選択する
+    // OpenGL Version 3.3 Core Profile を選択する（インスタンス描画の glVertexAttribDivisor は 3.3 から）
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
     glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER,GL_TRUE);
+    if(headless > 0) glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
     
     //ウィンドウを作成する
     Window window;
     
-    // 背景色を指定する
-    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
-    
-    // 背面カリングを有効にする（デフォルトなら一番下だけでもOK)
-    glFrontFace(GL_CCW);
-    glCullFace(GL_BACK);
-    glEnable(GL_CULL_FACE);
-    
-    // デプスバッファを有効にする (デフォルトなら一番下だけでもOK)
-    glClearDepth(1.0);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_DEPTH_TEST);
-    
-    //プログラムオブジェクトを作成する
-    const GLuint program(loadProgram("point.vert","point.frag"));
-    
-    // uniform変数の場所を取得する(2つ目のに指定したuniform変数の場所を探す）
-    const GLint modelviewLoc(glGetUniformLocation(program, "modelview"));
-    const GLint projectionLoc(glGetUniformLocation(program,"projection"));
-    const GLint normalMatrixLoc(glGetUniformLocation(program, "normalMatrix"));
-    const GLint LposLoc(glGetUniformLocation(program, "Lpos"));
-    const GLint LambLoc(glGetUniformLocation(program, "Lamb"));
-    const GLint LdiffLoc(glGetUniformLocation(program, "Ldiff"));
-    const GLint LspecLoc(glGetUniformLocation(program, "Lspec"));
-    
-    // uniform blockの場所を取得する
-    const GLint materialLoc(glGetUniformBlockIndex(program, "Material"));
-    
-    // uniform blockの場所を0番の結合ポイントに結びつける
-    glUniformBlockBinding(program, materialLoc, 0);
-    
-    //球の分割数
-    const int slices(16), stacks(8);
-    
-    //頂点属性を作る
-    std::vector<Object::Vertex> solidSphereVertex;
-    
-    for(int j = 0; j <= stacks ; j++)
+    //描画の設定（コンテキストごとに行う）
+    const auto initialize([]()
     {
-        const float t(static_cast<float>(j) / static_cast<float>(stacks));
-        const float y(cos(3.141693f * t)), r(sin(3.141693f * t));
+        // 背景色を指定する
+        glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
         
-        for(int i = 0; i <= slices; i++)
-        {
-            const float s(static_cast<float>(i) / static_cast<float>(slices));
-            const float z(r * cos(6.283185f * s)), x(r * sin(6.283185f * s));
-            
-            //頂点属性
-            const Object::Vertex v = { x, y, z, x, y, z};
-            
-            //頂点属性を追加する
-            solidSphereVertex.emplace_back(v);
-        }
-    }
-    
-    //インデックスを作る
-    std::vector<GLuint> solidSphereIndex;
-    
-    for(int j = 0; j < stacks; j++)
+        // 背面カリングを有効にする（デフォルトなら一番下だけでもOK)
+        glFrontFace(GL_CCW);
+        glCullFace(GL_BACK);
+        glEnable(GL_CULL_FACE);
+        
+        // デプスバッファを有効にする (デフォルトなら一番下だけでもOK)
+        glClearDepth(1.0);
+        glDepthFunc(GL_LESS);
+        glEnable(GL_DEPTH_TEST);
+    });
+    initialize();
+    
+    //GPU 資源を共有して場面を横から見る二つ目のウィンドウを作成する
+    std::unique_ptr<Window> overview;
+    if(split)
     {
-        const int k((slices + 1) * j);
+        overview.reset(new Window(480, 360, "Overview", &window));
+        initialize();
         
-        for(int i = 0; i < slices; i++)
-        {
-            //頂点のインデックス (左上、右上、左下、右下)
-            const GLuint k0(k + i);
-            const GLuint k1(k0 + 1);
-            const GLuint k2(k1 + slices);
-            const GLuint k3(k2 + 1);
-            
-            //左下の三角形
-            solidSphereIndex.emplace_back(k0);
-            solidSphereIndex.emplace_back(k2);
-            solidSphereIndex.emplace_back(k3);
-            
-            //右上の三角形
-            solidSphereIndex.emplace_back(k0);
-            solidSphereIndex.emplace_back(k3);
-            solidSphereIndex.emplace_back(k1);
-        }
+        //垂直同期はメインのウィンドウだけで待つ
+        glfwSwapInterval(0);
+        window.makeCurrent();
     }
-
-    // 図形データを作成する
-    std::unique_ptr<const Shape> shape(new SolidShapeIndex(3,
-        static_cast<GLsizei>(solidSphereVertex.size()),solidSphereVertex.data(),
-        static_cast<GLsizei>(solidSphereIndex.size()),solidSphereIndex.data()));
+    const int context(startup.mark("window"));
     
     // 光源データを作成する（光の色は赤と白, 下二つの引数はRGB）
     static constexpr int Lcount(2);
@@ -361,73 +400,411 @@ int main() {
         {0.1f, 0.1f, 0.5f,  0.1f, 0.1f, 0.5f,  0.4f, 0.4f, 0.4f,  60.0f}
     };
     
-    const Uniform<Material> material(color, 2);
+    // 材質ごとに最も軽いシェーダを選ぶ
+    const ShaderFeature feature[] =
+    {
+        ShaderVariants::choose(Lcount, color[0]),
+        ShaderVariants::choose(Lcount, color[1])
+    };
+    
+    // インポスタは二つの球を一度に描くので鏡面反射光のある方に合わせる
+    const ShaderFeature impostorFeature = { Lcount, true, false, true, false };
+    
+    //ソースを読み込んだらシェーダのコンパイルを始める（リンクの完了は待たない）
+    std::unique_ptr<ShaderVariants> variants, impostorVariants;
+    startup.add("shader compile", [&]
+    {
+        variants.reset(new ShaderVariants(std::move(pointSource[0]), std::move(pointSource[1])));
+        for(const ShaderFeature &f : feature) variants -> request(f);
+        if(!impostor) return;
+        impostorVariants.reset(new ShaderVariants(std::move(impostorSource[0]), std::move(impostorSource[1])));
+        impostorVariants -> request(impostorFeature);
+    }, { context, pointSources }, Startup::Main);
+    
+    // 球ができたら図形データを作成する
+    std::unique_ptr<const Shape> shape;
+    startup.add("sphere buffers", [&]
+    {
+        shape.reset(new SolidShapeIndex(3,
+            static_cast<GLsizei>(solidSphereVertex.size()),solidSphereVertex.data(),
+            static_cast<GLsizei>(solidSphereIndex.size()),solidSphereIndex.data()));
+    }, { context, sphere }, Startup::Main);
+    
+    // 噴水のパーティクル（一秒間に 50000 個放出し、寿命は最大 2 秒）
+    std::unique_ptr<ParticleSystem> fountain;
+    startup.add("particle system", [&]
+    {
+        const bool read(!particleSource[0].empty() && !particleSource[1].empty());
+        fountain.reset(new ParticleSystem(100000, 2.0f, pool,
+            read ? particleSource[0].data() : NULL, read ? particleSource[1].data() : NULL));
+    }, { context, particleSources }, Startup::Main);
+    
+    //前提の処理が終わったものから GL の処理を行い、ワーカースレッドの処理も全て終わるまで待つ
+    startup.run();
+    
+    // 材質を一つのバッファにまとめて登録する
+    MaterialRegistry material;
+    const GLuint colorIndex[] = { material.add(color[0]), material.add(color[1]) };
+    
+    // インポスタで描くときは二つの球（半径 1）を登録しておき、中心はフレームごとに書き換える
+    std::unique_ptr<SphereImpostors> spheres;
+    if(impostor)
+    {
+        spheres.reset(new SphereImpostors(2));
+        for(int i = 0; i < 2; i++)
+        {
+            const SphereImpostors::Sphere s = { { 0.0f, 0.0f, 0.0f }, 1.0f, colorIndex[i] };
+            spheres -> add(s);
+        }
+    }
+    
+    // 斜め上と真上と横から見るビュー変換（視点は動かないのでコンパイル時に求めておく）
+    static constexpr Transform oblique(Transform::lookat(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    static constexpr Transform above(Transform::lookat(0.0f, 8.0f, 1.5f, 0.0f, 0.0f, 1.5f, 0.0f, 0.0f, -1.0f));
+    static constexpr Transform beside(Transform::lookat(-7.0f, 1.0f, 1.5f, 0.0f, 0.0f, 1.5f, 0.0f, 1.0f, 0.0f));
+    
+    //メインのウィンドウは斜め上から見る（-split なら左右に分けて右半分で真上から見る）
+    Viewport views[] =
+    {
+        Viewport(0.0f, 0.0f, split ? 0.5f : 1.0f, 1.0f, oblique),
+        Viewport(0.5f, 0.0f, 0.5f, 1.0f, above)
+    };
+    const int viewCount(split ? 2 : 1);
+    
+    //二つ目のウィンドウは横から見る
+    Viewport side(0.0f, 0.0f, 1.0f, 1.0f, beside, 1.0f, 20.0f);
+    
+    // 入力イベントを読み出して斜め上から見るビューポートの中で図形を動かす
+    Control control(window.getEvents(), views[0]);
+    
+    // 一秒間に 120 回場面の状態を更新するシミュレーションのスレッドを開始する
+    Simulation<SceneState> simulation(120.0, SceneState(), [&control](SceneState &s, double dt)
+    {
+        //図形を回転する（誤差が溜まらないように毎回正規化する）
+        s.orientation = (Quaternion::rotate(static_cast<GLfloat>(dt), 0.0f, 1.0f, 0.0f) * s.orientation).normalize();
+        
+        //入力イベントに従って図形を移動する
+        control.apply(s);
+    });
+    
+    // 描画したフレームを数フレーム遅れで読み出してワーカースレッドで書き出す
+    //  ウィンドウを表示しないときは取りこぼさないように書き出しを待つ
+    std::unique_ptr<FrameCapture> capture;
+    if(capturePath != NULL)
+    {
+        const size_t length(strlen(capturePath));
+        const bool video(length >= 4 && strcmp(capturePath + length - 4, ".y4m") == 0);
+        capture.reset(new FrameCapture(capturePath, video ? FrameCapture::Y4m : FrameCapture::Png,
+                                       pool, 60.0, 3, 8, headless > 0));
+        
+        //書き出せない書き出し先は断る（理由は FrameCapture が表示している）
+        if(!*capture) return 1;
+    }
+    static constexpr GLfloat fountainOrigin[] = { 0.0f, -1.0f, 0.0f };
+    static constexpr GLfloat gravity[] = { 0.0f, -9.8f, 0.0f };
+    static constexpr GLfloat particleColor[] = { 0.2f, 0.4f, 1.0f };
+    double particleTime(glfwGetTime());
+    
+    // 右ボタンで選択できるように二つの球を登録する
+    Picker picker;
+    const int pickable[] = { picker.add(sphereMesh), picker.add(sphereMesh) };
+    
+    // マウスのボタン操作を描画のスレッドで読み出す
+    InputQueue::Reader clicks(window.getEvents());
+    
+    // シミュレーションの刻みにまだ反映されていない入力を描画のスレッドで足す
+    Control latest(window.getEvents(), views[0]);
+    
+    // 垂直同期を待ち、描画中のフレームを二つまでにして、入力は提出の直前に読み直す
+    //ウィンドウを表示しないときは垂直同期を待たない
+    FramePacer pacer(headless > 0 ? FramePacer::Uncapped : FramePacer::VSync, 60.0, 2, true);
+    
+    // 60fps に収まるように解像度を半分まで下げて描画する
+    DynamicResolution resolution(60.0, 0.5f);
+    
+    //描画した図形と視錐台の外で取り除いた図形の数
+    unsigned long drawn(0), culled(0);
+    
+    //フレームごとの GPU メモリの使用量の書き出し先
+    std::ofstream memoryLog;
+    if(memoryPath != NULL)
+    {
+        memoryLog.open(memoryPath);
+        if(memoryLog) GpuMemory::instance().setLog(&memoryLog);
+        else std::cerr << "Error: Can't open memory log: " << memoryPath << std::endl;
+    }
+    
+    //フレームごとの GL の呼び出しの回数の書き出し先
+    std::ofstream traceLog;
+    if(tracePath != NULL)
+    {
+        traceLog.open(tracePath);
+        if(traceLog) GlTrace::instance().setLog(&traceLog);
+        else std::cerr << "Error: Can't open trace log: " << tracePath << std::endl;
+        GlTrace::instance().setEnabled(true);
+    }
+    
+    //フレームごとの描画の記録（図形、材質、シェーダ、パーティクルを最初に定義する）
+    FrameRecorder recorder(recordPath);
+    recorder.defineShape(0, FrameRecorder::SolidIndex, 3,
+        static_cast<GLsizei>(solidSphereVertex.size()), solidSphereVertex.data(),
+        static_cast<GLsizei>(solidSphereIndex.size()), solidSphereIndex.data());
+    for(int i = 0; i < 2; i++)
+    {
+        recorder.defineMaterial(colorIndex[i], color[i]);
+        recorder.defineProgram(feature[i]);
+    }
+    recorder.defineParticles(100000, 2.0f);
+    
+    //ここまでの残りの準備を一つの処理として記録する
+    startup.mark("scene");
     
-    // タイマーを0にセット
-    glfwSetTime(0.0);
+    //描画したフレームの数
+    int frame(0);
     
-    //ウィンドウが開いている間繰り返す
-    while(window)
+    //ウィンドウが開いている間（ウィンドウを表示しないときは決まった数のフレームを描画するまで）繰り返す
+    while(window && !(overview && overview -> shouldClose()) && (headless == 0 || frame < headless))
     {
-        // ウィンドウを消去
+        recorder.beginFrame();
+        
+        // 変更された材質を転送する（全てのウィンドウで共有する）
+        material.update();
+        
+        //場面の状態を取り出す
+        SceneState scene(simulation.sample());
+        
+        //パーティクルを進めて転送する（全てのウィンドウで共有する）
+        const double now(glfwGetTime());
+        const GLfloat dt(static_cast<GLfloat>(std::min(now - particleTime, 0.1)));
+        particleTime = now;
+        const GLsizei emitted(static_cast<GLsizei>(dt * 50000.0f));
+        fountain -> emit(emitted, fountainOrigin, 5.0f, 0.3f);
+        fountain -> update(dt, gravity);
+        fountain -> upload();
+        recorder.stepParticles(dt, emitted, fountainOrigin, 5.0f, 0.3f, gravity);
+        
+        //入力に依存しない処理を済ませてから入力と場面の状態を読み直す
+        if(pacer.lateLatch())
+        {
+            window.pollEvents();
+            scene = simulation.sample();
+        }
+        
+        //シミュレーションがまだ反映していない入力を足し、このフレームで初めて使った入力として遅延を計る
+        const double input(latest.latch(scene));
+        if(input >= 0.0) pacer.latch(input);
+        
+        // 二つの図形のモデル変換行列を求める
+        const Transform model[] =
+        {
+            Transform(Transform::translate(scene.location[0], scene.location[1], 0.0f) * scene.orientation),
+            Transform(Transform::translate(scene.location[0], scene.location[1], 0.0f) * scene.orientation
+                      * Transform::translate(0.0f, 0.0f, 3.0f))
+        };
+        
+        // 右ボタンが押されたらマウスカーソルの下の図形を調べる
+        picker.setTransform(pickable[0], model[0]);
+        picker.setTransform(pickable[1], model[1]);
+        clicks.drain([&](const InputEvent &e)
+        {
+            if(e.type != InputEvent::MouseButton || e.code != GLFW_MOUSE_BUTTON_RIGHT || e.action != GLFW_PRESS) return;
+            
+            //選択に使った入力として遅延を計る
+            pacer.latch(e.time);
+            
+            //マウスカーソルのあるビューポートの正規化デバイス座標系に直して光線に戻す
+            for(int i = 0; i < viewCount; i++)
+            {
+                const Viewport &v(views[i]);
+                GLfloat ndc[2];
+                if(!v.contains(e.x, e.y, window.getSize(), ndc)) continue;
+                Picker::Hit hit;
+                if(picker.pick(unproject(v.getProjection(), v.getView().toMatrix(), ndc[0], ndc[1]), hit))
+                    std::cerr << "Picked object " << hit.object << " triangle " << hit.triangle
+                              << " at distance " << hit.distance << std::endl;
+            }
+        });
+        
+        // インポスタの球の中心を図形の原点に合わせて転送する（全てのウィンドウで共有する）
+        if(spheres)
+        {
+            for(int i = 0; i < 2; i++)
+            {
+                const Vector c(model[i] * Vector{ 0.0f, 0.0f, 0.0f, 1.0f });
+                const SphereImpostors::Sphere s = { { c[0], c[1], c[2] }, 1.0f, colorIndex[i] };
+                spheres -> set(i, s);
+            }
+            spheres -> upload();
+        }
+        
+        //図形の境界ボックス（視錐台の外にあれば描画しない）
+        const Bounds bounds[] = { sphereMesh -> getBounds().transform(model[0]), sphereMesh -> getBounds().transform(model[1]) };
+        
+        //一つのビューポートに場面を描画する
+        //  target: 描画先の大きさ
+        //  fovy: 画角
+        const auto render([&](Viewport &viewport, const GLsizei *target, GLfloat fovy)
+        {
+            // ビューポートを設定して透視投影変換行列を求める
+            viewport.apply(target, fovy);
+            const Matrix &projection(viewport.getProjection());
+            const Transform &view(viewport.getView());
+            
+            // 視点座標系での光源の位置を求める
+            Vector Lview[Lcount];
+            for(int i = 0; i < Lcount; i++) Lview[i] = view * Lpos[i];
+            recorder.view(viewport.getPixels(), projection.data(), Lcount, Lview, Lamb, Ldiff, Lspec);
+            
+            //使用中のプログラムオブジェクト
+            GLuint current(0);
+            
+            // シェーダプログラムの使用開始（切り替わったときだけ共通の uniform 変数を設定する）
+            const auto use([&](const ShaderVariants::Variant &v)
+            {
+                if(v.program == current) return;
+                current = v.program;
+                glUseProgram(v.program);
+                glUniform1i(v.materialLoc, 0);
+                glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, projection.data());
+                ShaderVariants::setLights(v, Lcount, Lview[0].data(), Lamb, Ldiff, Lspec);
+            });
+            
+            //法線ベクトルの変換行列の格納先
+            GLfloat normalMatrix[9];
+            
+            for(int i = 0; i < 2; i++)
+            {
+                //このビューポートから見えなければ描画しない
+                if(!viewport.visible(bounds[i]))
+                {
+                    ++culled;
+                    continue;
+                }
+                ++drawn;
+                
+                //インポスタは後でまとめて描画する
+                if(spheres) continue;
+                
+                //モデルビュー変換行列と法線ベクトルの変換行列を求める
+                const Transform modelview(view * model[i]);
+                modelview.getNormalMatrix(normalMatrix);
+                recorder.draw(0, feature[i], colorIndex[i], modelview.toMatrix().data(), normalMatrix);
+                
+                // uniform変数に値を設定する
+                const ShaderVariants::Variant &v(variants -> get(feature[i]));
+                use(v);
+                glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview.toMatrix().data());
+                glUniformMatrix3fv(v.normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+                
+                //図形を描画する
+                glUniform1i(v.materialIndexLoc, colorIndex[i]);
+                shape -> draw();
+            }
+            
+            //インポスタは視錐台の外のものも含めて一度に描画する（四角形なのでクリッピングで捨てられる）
+            if(spheres)
+            {
+                const ShaderVariants::Variant &v(impostorVariants -> get(impostorFeature));
+                use(v);
+                spheres -> draw(v, view.toMatrix().data());
+            }
+            
+            //パーティクルを一度に描画する
+            fountain -> draw(projection.data(), view.toMatrix().data(), 0.02f, particleColor);
+            recorder.drawParticles(projection.data(), view.toMatrix().data(), 0.02f, particleColor);
+        });
+        
+        //メインのウィンドウは縮小したフレームバッファオブジェクトに描画する
+        window.makeCurrent();
+        resolution.begin(window.getFramebufferSize());
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
-        // シェーダプログラムの使用開始(1つだけならwhileの前でも可能）
-        glUseProgram(program);
-        
-        // 透視投影変換行列を求める
-        const GLfloat *const size(window.getSize());
-        const GLfloat fovy(window.getScale() * 0.01f);
-        const GLfloat aspect(size[0] / size[1]);
-        const Matrix projection(Matrix::perspective(fovy, aspect, 1.0f, 10.0f));
-        
-        // モデル変換行列を求める
-        const GLfloat *const location(window.getLocation());
-        const Matrix r(Matrix::rotate(static_cast<GLfloat>(glfwGetTime()),
-                                      0.0f, 1.0f, 0.0f));
-        const Matrix model(Matrix::translate(location[0], location[1], 0.0f) * r);
-        
-        // ビュー変換行列を求める
-        const Matrix view(Matrix::lookat(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
-        
-        //法線ベクトルの変換行列の格納先
-        GLfloat normalMatrix[9];
-        
-        //モデルビュー変換行列を求める
-        const Matrix modelview(view * model);
-        
-        //法線ベクトルの変換行列を求める
-        modelview.getNormalMatrix(normalMatrix);
-         
-        // uniform変数に値を設定する
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection.data());
-        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, modelview.data());
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normalMatrix);
-        for(int i = 0; i< Lcount; i++)
-            glUniform4fv(LposLoc + i, 1, (view * Lpos[i]).data());
-        glUniform3fv(LambLoc, Lcount, Lamb);
-        glUniform3fv(LdiffLoc, Lcount, Ldiff);
-        glUniform3fv(LspecLoc, Lcount, Lspec);
-        
-        //図形を描画する
-        material.select(0, 0);
-        shape -> draw();
-        
-        //二つ目のモデルビュー変換行列を求める
-        const Matrix modelview1(modelview * Matrix::translate(0.0f, 0.0f, 3.0f));
-        
-        //二つ目の法線ベクトルの変換行列を求める
-        modelview1.getNormalMatrix(normalMatrix);
-        
-        //uniform変数に値を設定する
-        glUniformMatrix4fv(modelviewLoc, 1, GL_FALSE, modelview1.data());
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, normalMatrix);
-        
-        //二つ目の図形を描画する
-        material.select(0, 1);
-        shape -> draw();
+        //材質のバッファの結合はコンテキストごとに行う
+        material.select(0);
+        recorder.pass(resolution.getSize());
+        for(int i = 0; i < viewCount; i++) render(views[i], resolution.getSize(), window.getScale() * 0.01f);
+        
+        //ウィンドウに拡大して写す
+        resolution.end();
+        
+        //拡大したフレームを読み出す（取り出すのは数フレーム後）
+        if(capture) capture -> capture(window.getFramebufferSize());
         
         //カラーバッファを入れ替えてイベントを取り出す
         window.swapBuffers();
+        startup.firstFrame();
+        
+        //二つ目のウィンドウに描画する
+        if(overview)
+        {
+            overview -> makeCurrent();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            material.select(0);
+            recorder.pass(overview -> getFramebufferSize());
+            render(side, overview -> getFramebufferSize(), overview -> getScale() * 0.01f);
+            overview -> swapBuffers();
+            window.makeCurrent();
+        }
+        
+        //描画中のフレームが多すぎれば減るまで、Fixed なら次のフレームの時刻まで待つ
+        pacer.endFrame();
+        GpuMemory::instance().endFrame();
+        GlTrace::instance().endFrame();
+        recorder.endFrame();
+        ++frame;
     }
+    
+    // 起動の処理ごとの時間と最初のフレームまでの時間を表示する
+    startup.dump(std::cerr);
+    
+    // ビューポートごとの視錐台カリングの結果を表示する
+    std::cerr << "Culling: " << drawn << " drawn, " << culled << " culled" << std::endl;
+    
+    // 解像度の縮小率と描画の時間を表示する
+    const DynamicResolution::Stats scaling(resolution.stats());
+    std::cerr << "Resolution: scale " << scaling.scale << ", GPU mean " << scaling.gpuMean * 1000.0
+              << " ms max " << scaling.gpuMax * 1000.0 << " ms (budget " << scaling.budget * 1000.0
+              << " ms, " << scaling.over << "/" << scaling.frames << " over), "
+              << scaling.changes << " changes" << std::endl;
+    
+    // フレームの間隔と入力の遅延を表示する
+    const FramePacer::Stats pacing(pacer.stats());
+    std::cerr << "Frames: " << pacing.frames << ", interval mean " << pacing.frameMean * 1000.0
+              << " ms max " << pacing.frameMax * 1000.0 << " ms, stall mean " << pacing.stallMean * 1000.0
+              << " ms, input latency mean " << pacing.latencyMean * 1000.0 << " ms max "
+              << pacing.latencyMax * 1000.0 << " ms" << std::endl;
+    
+    // シミュレーションの揺らぎと遅延を表示する
+    const Simulation<SceneState>::Stats stats(simulation.stats());
+    std::cerr << "Simulation: " << stats.ticks << " ticks, jitter mean "
+              << stats.jitterMean * 1000.0 << " ms max " << stats.jitterMax * 1000.0
+              << " ms, latency mean " << stats.latencyMean * 1000.0 << " ms max "
+              << stats.latencyMax * 1000.0 << " ms" << std::endl;
+    
+    // 取り込んだフレームを全て書き出して結果を表示する
+    if(capture)
+    {
+        capture -> finish();
+        const FrameCapture::Stats captured(capture -> stats());
+        std::cerr << "Capture: " << captured.written << "/" << captured.captured << " written, "
+                  << captured.dropped << " dropped, read mean " << captured.readMean * 1000.0
+                  << " ms, encode mean " << captured.encodeMean * 1000.0 << " ms" << std::endl;
+    }
+    
+    // 持ち主ごとの GPU メモリの使用量を表示する
+    GpuMemory::instance().setLog(NULL);
+    GpuMemory::instance().dump(std::cerr);
+    
+    // GL の呼び出しの回数と無駄な呼び出しの回数を表示する
+    GlTrace::instance().setLog(NULL);
+    GlTrace::instance().dump(std::cerr);
+    
+    // 記録したフレームの数と大きさを表示する
+    if(recorder)
+        std::cerr << "Record: " << recorder.getFrames() << " frames, " << recorder.getBytes() << " bytes" << std::endl;
+    
+    // GPU 資源の作成と使い回しの回数を表示する
+    const GpuResources::Stats &resources(GpuResources::instance().getStats());
+    std::cerr << "GPU resources: " << resources.created << " created, "
+              << resources.reused << " reused, " << resources.deleted << " deleted" << std::endl;
 }
@@ -0,0 +1,11 @@
+#version 150 core
+uniform vec3 color;     //パーティクルの色
+in vec2 offset;         //ビルボードの中心からの位置
+in float fade;          //残り寿命の割合
+out vec4 fragment;
+
+void main(){
+    //円の外は描かない
+    if(dot(offset, offset) > 1.0) discard;
+    fragment = vec4(mix(vec3(1.0), color, fade), 1.0);
+}
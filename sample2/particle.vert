@@ -0,0 +1,18 @@
+#version 150 core
+uniform mat4 modelview;
+uniform mat4 projection;
+uniform float size;     //ビルボードの半径
+uniform float lifetime; //パーティクルの寿命
+in vec2 position;       //ビルボードの四隅（-1〜1）
+in vec4 particle;       //インスタンスごとのパーティクルの位置と残り寿命
+out vec2 offset;        //ビルボードの中心からの位置
+out float fade;         //残り寿命の割合
+
+void main(){
+    //視点座標系でビルボードを視線に向ける
+    vec4 P = modelview * vec4(particle.xyz, 1.0);
+    P.xy += position * size;
+    offset = position;
+    fade = clamp(particle.w / lifetime, 0.0, 1.0);
+    gl_Position = projection * P;
+}
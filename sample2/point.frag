@@ -1,17 +1,32 @@
 #version 150 core
-const int Lcount = 2;
+// 機能の組み合わせ（ShaderVariants が #version の直後に #define を差し込む）
+#ifndef LCOUNT
+#define LCOUNT 2     //光源の数
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1   //鏡面反射光を計算するか
+#endif
+#ifndef PER_VERTEX
+#define PER_VERTEX 0 //陰影を頂点ごとに計算するか
+#endif
+#if PER_VERTEX
+in vec3 Idiff;  //拡散反射光強度
+in vec3 Ispec;  //鏡面反射光強度
+out vec4 fragment;
+
+void main(){
+    fragment = vec4(Idiff + Ispec, 1.0);
+}
+#else
+const int Lcount = LCOUNT;
 uniform vec4 Lpos[Lcount]; //光源の位置
 uniform vec3 Lamb[Lcount];
 uniform vec3 Ldiff[Lcount];
 uniform vec3 Lspec[Lcount]; //光源強度の鏡面反射光成分
-layout (std140) uniform Material //材質データ
-{
-    vec3 Kamb;  // 環境光の反射係数
-    vec3 Kdiff; //拡散反射係数
-    vec3 Kspec; //鏡面反射係数
-    float Kshi; //輝き係数
-};
-in vec3 Idiff;  //拡散反射光強度
+flat in vec3 Kamb;  // 環境光の反射係数
+flat in vec3 Kdiff; //拡散反射係数
+flat in vec3 Kspec; //鏡面反射係数
+flat in float Kshi; //輝き係数
 
 in vec4 P;
 in vec3 N;
@@ -26,9 +41,12 @@ void main(){
         vec3 L = normalize((Lpos[i] * P.w - P * Lpos[i].w).xyz);
         vec3 Iamb = Kamb * Lamb[i];
         Idiff += max(dot(N,L), 0.0) * Kdiff * Ldiff[i] + Iamb;
+#if SPECULAR
         vec3 H = normalize(L + V);
         
         Ispec += pow(max(dot(N,H), 0.0), Kshi) * Kspec * Lspec[i]; //反転してもしなくてもここで結果は同じになる
+#endif
     }
     fragment = vec4(Idiff + Ispec, 1.0);
 }
+#endif
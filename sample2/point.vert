@@ -1,33 +1,108 @@
 #version 150 core
+// 機能の組み合わせ（ShaderVariants が #version の直後に #define を差し込む）
+#ifndef LCOUNT
+#define LCOUNT 2     //光源の数
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1   //鏡面反射光を計算するか
+#endif
+#ifndef PER_VERTEX
+#define PER_VERTEX 0 //陰影を頂点ごとに計算するか
+#endif
+#ifndef INSTANCING
+#define INSTANCING 0 //変換行列と材質の番号をインスタンスごとの頂点属性から受け取るか
+#endif
+#ifndef SKINNING
+#define SKINNING 0   //関節の変換行列を頂点の重みで混ぜてから変換するか
+#endif
+#define MAX_JOINTS 64 //関節の数の上限（Skeleton::maxJoints と同じ）
 uniform mat4 modelview;
 uniform mat4 projection;
 uniform mat3 normalMatrix;
-const int Lcount = 2;
+const int Lcount = LCOUNT;
 uniform vec4 Lpos[Lcount]; //光源の位置
+uniform vec3 Lamb[Lcount];
+uniform vec3 Ldiff[Lcount];
 uniform vec3 Lspec[Lcount]; //光源強度の鏡面反射光成分
-layout (std140) uniform Material //材質データ
+uniform samplerBuffer material; //材質データ(std140 の Material の配列）
+#if INSTANCING
+in mat4 instanceModelview; //インスタンスごとのモデルビュー変換行列
+in int instanceMaterial;   //インスタンスごとの材質の番号
+#else
+uniform int materialIndex;      //描画に使う材質の番号
+#endif
+#if SKINNING
+layout(std140) uniform Palette
 {
-    vec3 Kamb;  // 環境光の反射係数
-    vec3 Kdiff; //拡散反射係数
-    vec3 Kspec; //鏡面反射係数
-    float Kshi; //輝き係数
+    mat4 joint[MAX_JOINTS]; //関節の変換行列（逆バインド行列をかけたもの）
 };
+in ivec4 joints;  //影響する関節の番号
+in vec4 weights;  //関節の重み
+#endif
 in vec4 position;
 in vec3 normal;  //法線
+#if PER_VERTEX
 out vec3 Idiff;  //拡散反射光強度
 out vec3 Ispec;  //鏡面反射光強度
+#else
 out vec4 P;
 out vec3 N;
+flat out vec3 Kamb;  // 環境光の反射係数
+flat out vec3 Kdiff; //拡散反射係数
+flat out vec3 Kspec; //鏡面反射係数
+flat out float Kshi; //輝き係数
+#endif
 
 void main(){
-    P = modelview * position; //頂点の位置
-    N = normalize(normalMatrix * normal);  //鏡面に対する法線ベクトル
+#if INSTANCING
+    mat4 MV = instanceModelview;
+    mat3 NM = mat3(instanceModelview); //拡大率が均等なら法線もこれで変換できる
+    int index = instanceMaterial;
+#else
+    mat4 MV = modelview;
+    mat3 NM = normalMatrix;
+    int index = materialIndex;
+#endif
+#if SKINNING
+    //関節の変換行列を重みで混ぜて図形を変形する（法線は拡大率が均等なら同じ行列で変換できる）
+    mat4 S = weights.x * joint[joints.x] + weights.y * joint[joints.y]
+           + weights.z * joint[joints.z] + weights.w * joint[joints.w];
+    vec4 Q = S * position;
+    vec3 M = mat3(S) * normal;
+#else
+    vec4 Q = position;
+    vec3 M = normal;
+#endif
+    //材質を取り出す（一つの材質はテクセル三つ分）
+    vec4 K0 = texelFetch(material, index * 3);
+    vec4 K1 = texelFetch(material, index * 3 + 1);
+    vec4 K2 = texelFetch(material, index * 3 + 2);
+#if PER_VERTEX
+    vec3 Kamb = K0.rgb;
+    vec3 Kdiff = K1.rgb;
+    vec3 Kspec = K2.rgb;
+    float Kshi = K2.a;
+    vec4 P = MV * Q; //頂点の位置
+    vec3 N = normalize(NM * M);  //鏡面に対する法線ベクトル
     vec3 V = -normalize(P.xyz);  //視点方向のベクトル
+    Idiff = vec3(0.0);
+    Ispec = vec3(0.0);
     for(int i = 0; i < Lcount; i++)
     {
         vec3 L = normalize((Lpos[i] * P.w - P * Lpos[i].w).xyz); //光源方向のベクトル
-        vec3 H = normalize(L + V);    //中間ベクトル反射がHと一致するかどうかの確率でIspecが求められる
-                                      //正反射方向(ベクトルI、法線ベクトルN)を引数にする
+        Idiff += max(dot(N,L), 0.0) * Kdiff * Ldiff[i] + Kamb * Lamb[i];
+#if SPECULAR
+        vec3 H = normalize(L + V);    //中間ベクトル
+        Ispec += pow(max(dot(N,H), 0.0), Kshi) * Kspec * Lspec[i];
+#endif
     }
+#else
+    Kamb = K0.rgb;
+    Kdiff = K1.rgb;
+    Kspec = K2.rgb;
+    Kshi = K2.a;
+    P = MV * Q; //頂点の位置
+    N = normalize(NM * M);  //鏡面に対する法線ベクトル
+#endif
     gl_Position = projection * P;
 }
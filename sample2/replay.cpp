@@ -0,0 +1,497 @@
+#include<cstdlib>
+#include<cstring>
+#include<chrono>
+#include<iostream>
+#include<fstream>
+#include<vector>
+#include<memory>
+#include<algorithm>
+#include<GL/glew.h>
+#include<GLFW/glfw3.h>
+#include "GlTrace.h"
+#include "Window.h"
+#include "Shape.h"
+#include "ShapeIndex.h"
+#include "SolidShape.h"
+#include "SolidShapeIndex.h"
+#include "Material.h"
+#include "MaterialRegistry.h"
+#include "ShaderVariants.h"
+#include "ThreadPool.h"
+#include "ParticleSystem.h"
+#include "FrameRecorder.h"
+
+/*
+ 描画の記録の再現
+
+ main の -record で書き出したログを読み込み、見えないウィンドウに垂直同期を待たずに
+ 記録したフレームを順に描画して、フレームごとの CPU の処理時間と GPU の処理の完了までの時間を JSON で出力する
+ 時刻や入力に依存しないので、同じログで変更の前後の性能を比べられる
+
+ 使い方: replay ファイル [-output ファイル] [-repeat 回数]
+   -repeat を指定すると記録を繰り返し再現し、繰り返しごとの結果も passes に出力する
+   （パーティクルは繰り返しごとに作ったときの状態に戻すので、どの繰り返しも同じ描画になる）
+*/
+
+// ログから読み出す値の上限（壊れたログで大きな領域を確保しないようにする）
+static constexpr GLint maxLights(8);
+static constexpr GLsizei maxParticles(1 << 22);
+
+// 現在時刻（秒）
+static double now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[]) {
+
+    // 引数を調べる
+    const char *input(NULL);
+    const char *output(NULL);
+    int repeat(1);
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-output") == 0 && i + 1 < argc) output = argv[++i];
+        else if(strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+        else if(input == NULL && argv[i][0] != '-') input = argv[i];
+        else
+        {
+            input = NULL;
+            break;
+        }
+    }
+    if(input == NULL)
+    {
+        std::cerr << "Usage: " << argv[0] << " file [-output file] [-repeat count]" << std::endl;
+        return 2;
+    }
+
+    // 記録を全て読み込んでおく（再現中にファイルを読まない）
+    std::vector<unsigned char> data;
+    if(!FrameRecorder::load(input, data)) return 1;
+
+    // 描画先は記録した一番大きな描画先に合わせる
+    //  ついでに番号や数が正しいか確かめる（再現中に壊れたログで大きな領域を確保しない）
+    GLsizei size[] = { 1, 1 };
+    {
+        FrameRecorder::Reader reader(data);
+        FrameRecorder::Op op;
+        GLuint shapeCount(0), materialCount(0);
+        while(reader.next(op))
+        {
+            switch(op)
+            {
+            case FrameRecorder::DefineShape:
+            {
+                //番号は定義済みのものか次の番号に限る
+                const GLuint id(reader.get<GLuint>());
+                if(!reader.check(id <= shapeCount)) break;
+                if(id == shapeCount) ++shapeCount;
+                reader.get<FrameRecorder::Kind>();
+                reader.get<GLint>();
+                if(!reader.skip<Object::Vertex>(reader.get<GLsizei>())) break;
+                reader.skip<GLuint>(reader.get<GLsizei>());
+                break;
+            }
+            case FrameRecorder::DefineMaterial:
+            {
+                const GLuint index(reader.get<GLuint>());
+                if(!reader.check(index <= materialCount)) break;
+                if(index == materialCount) ++materialCount;
+                reader.getMaterial();
+                break;
+            }
+            case FrameRecorder::DefineProgram:
+                reader.getFeature();
+                break;
+            case FrameRecorder::DefineParticles:
+            {
+                const GLsizei capacity(reader.get<GLsizei>());
+                reader.check(capacity >= 0 && capacity <= maxParticles);
+                reader.get<GLfloat>();
+                break;
+            }
+            case FrameRecorder::StepParticles:
+            {
+                GLfloat values[10];
+                reader.get<GLsizei>();
+                reader.get(values, 10);
+                break;
+            }
+            case FrameRecorder::Pass:
+            {
+                GLsizei target[2];
+                reader.get(target, 2);
+                size[0] = std::max(size[0], target[0]);
+                size[1] = std::max(size[1], target[1]);
+                break;
+            }
+            case FrameRecorder::View:
+            {
+                GLint pixels[4];
+                GLfloat projection[16];
+                reader.get(pixels, 4);
+                reader.get(projection, 16);
+                const GLint lights(reader.get<GLint>());
+                if(!reader.check(lights >= 0 && lights <= maxLights)) break;
+                reader.skip<GLfloat>(lights * 13);
+                break;
+            }
+            case FrameRecorder::Draw:
+            {
+                GLfloat matrix[25];
+                reader.get<GLuint>();
+                reader.getFeature();
+                reader.get<GLuint>();
+                reader.get(matrix, 25);
+                break;
+            }
+            case FrameRecorder::DrawParticles:
+            {
+                GLfloat values[36];
+                reader.get(values, 36);
+                break;
+            }
+            case FrameRecorder::BeginFrame:
+            case FrameRecorder::EndFrame:
+                break;
+            default:
+                std::cerr << "Error: Unknown record op " << static_cast<int>(op) << std::endl;
+                return 1;
+            }
+        }
+        if(reader.fail())
+        {
+            std::cerr << "Error: Broken record file: " << input << std::endl;
+            return 1;
+        }
+    }
+
+    //GLFW初期化
+    if(glfwInit() == GL_FALSE){
+        std::cerr << "Can't initialize GLFW" << std::endl;
+        return 1;
+    }
+    atexit(glfwTerminate);
+
+    // OpenGL Version 3.3 Core Profile のウィンドウを表示せずに作る（インスタンス描画の glVertexAttribDivisor は 3.3 から）
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    Window window(size[0], size[1], "replay");
+
+    // 垂直同期を待たない
+    glfwSwapInterval(0);
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+
+    // 記録した定義から作るもの
+    ThreadPool pool;
+    ShaderVariants variants("point.vert", "point.frag");
+    std::vector<ShaderFeature> features;
+    std::vector<std::unique_ptr<const Shape>> shapes;
+    MaterialRegistry material;
+    std::vector<GLuint> materialIndex;
+    std::unique_ptr<ParticleSystem> particles;
+
+    //このビューポートの共通の uniform 変数
+    GLfloat projection[16];
+    GLint lights(0);
+    std::vector<GLfloat> Lview, Lamb, Ldiff, Lspec;
+
+    //使用中のプログラムオブジェクト
+    GLuint current(0);
+
+    //フレームごとの CPU の処理時間（ミリ秒）と GPU の処理の完了までの時間の合計（ミリ秒）
+    std::vector<double> cpu;
+    double frameTotal(0.0);
+    long drawCalls(0);
+
+    //一番遅かったフレームの番号（記録の中の番号）
+    int slowest(-1);
+    double slowestTime(0.0);
+
+    //繰り返しごとのフレームの数、CPU の処理時間の合計（ミリ秒）、描画命令の数、描画したパーティクルの数
+    //  同じ記録を再現しているので繰り返しごとに揃うはず
+    struct PassStats
+    {
+        int frames;
+        double cpu;
+        long drawCalls, particles;
+    };
+    std::vector<PassStats> passes;
+
+    // 定義は最初の一回だけ作り、フレームは繰り返す回数だけ再現する
+    for(int pass = 0; pass < repeat; pass++)
+    {
+        //パーティクルは前の繰り返しで残ったものを消して同じ状態から始める
+        if(particles) particles -> reset();
+        const PassStats start = { 0, 0.0, drawCalls, 0 };
+        passes.push_back(start);
+
+        FrameRecorder::Reader reader(data);
+        FrameRecorder::Op op;
+        int frame(-1);
+        double t0(0.0);
+        while(reader.next(op))
+        {
+            switch(op)
+            {
+            case FrameRecorder::DefineShape:
+            {
+                const GLuint id(reader.get<GLuint>());
+                const FrameRecorder::Kind kind(reader.get<FrameRecorder::Kind>());
+                const GLint dimension(reader.get<GLint>());
+                const GLsizei vertexcount(reader.get<GLsizei>());
+                if(!reader.fits<Object::Vertex>(vertexcount)) break;
+                std::vector<Object::Vertex> vertex(vertexcount);
+                reader.get(vertex.data(), vertex.size());
+                const GLsizei indexcount(reader.get<GLsizei>());
+                if(!reader.fits<GLuint>(indexcount)) break;
+                std::vector<GLuint> index(indexcount);
+                reader.get(index.data(), index.size());
+
+                //番号は定義済みのものか次の番号に限る
+                if(!reader.check(id <= shapes.size())) break;
+                if(pass > 0) break;
+
+                const GLsizei vc(static_cast<GLsizei>(vertex.size())), ic(static_cast<GLsizei>(index.size()));
+                Shape *shape;
+                switch(kind)
+                {
+                case FrameRecorder::LineIndex:
+                    shape = new ShapeIndex(dimension, vc, vertex.data(), ic, index.data());
+                    break;
+                case FrameRecorder::Solid:
+                    shape = new SolidShape(dimension, vc, vertex.data());
+                    break;
+                case FrameRecorder::SolidIndex:
+                    shape = new SolidShapeIndex(dimension, vc, vertex.data(), ic, index.data());
+                    break;
+                default:
+                    shape = new Shape(dimension, vc, vertex.data(), ic, index.data());
+                    break;
+                }
+                if(shapes.size() <= id) shapes.resize(id + 1);
+                shapes[id].reset(shape);
+                break;
+            }
+            case FrameRecorder::DefineMaterial:
+            {
+                const GLuint index(reader.get<GLuint>());
+                const Material m(reader.getMaterial());
+                if(!reader.check(index <= materialIndex.size())) break;
+                if(pass > 0) break;
+
+                //登録し直した番号に読み替える
+                if(materialIndex.size() <= index) materialIndex.resize(index + 1, 0);
+                materialIndex[index] = material.add(m);
+                break;
+            }
+            case FrameRecorder::DefineProgram:
+            {
+                const ShaderFeature f(reader.getFeature());
+                if(pass > 0) break;
+                variants.request(f);
+                features.push_back(f);
+                break;
+            }
+            case FrameRecorder::DefineParticles:
+            {
+                const GLsizei capacity(reader.get<GLsizei>());
+                const GLfloat lifetime(reader.get<GLfloat>());
+                if(!reader.check(capacity >= 0 && capacity <= maxParticles)) break;
+                if(pass == 0) particles.reset(new ParticleSystem(capacity, lifetime, pool));
+                break;
+            }
+            case FrameRecorder::BeginFrame:
+                // 最初のフレームの前にシェーダのリンクと図形データの転送を待つ
+                if(frame < 0)
+                {
+                    for(const ShaderFeature &f : features) variants.get(f);
+                    glFinish();
+                }
+                ++frame;
+                t0 = now();
+                material.update();
+                break;
+            case FrameRecorder::StepParticles:
+            {
+                const GLfloat dt(reader.get<GLfloat>());
+                const GLsizei count(reader.get<GLsizei>());
+                GLfloat origin[3], speed, spread, gravity[3];
+                reader.get(origin, 3);
+                reader.get(&speed);
+                reader.get(&spread);
+                reader.get(gravity, 3);
+                if(!particles) break;
+                particles -> emit(count, origin, speed, spread);
+                particles -> update(dt, gravity);
+                particles -> upload();
+                break;
+            }
+            case FrameRecorder::Pass:
+            {
+                GLsizei target[2];
+                reader.get(target, 2);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                material.select(0);
+                break;
+            }
+            case FrameRecorder::View:
+            {
+                GLint pixels[4];
+                reader.get(pixels, 4);
+                reader.get(projection, 16);
+                lights = reader.get<GLint>();
+                if(!reader.check(lights >= 0 && lights <= maxLights)) break;
+                Lview.resize(lights * 4);
+                Lamb.resize(lights * 3);
+                Ldiff.resize(lights * 3);
+                Lspec.resize(lights * 3);
+                reader.get(Lview.data(), Lview.size());
+                reader.get(Lamb.data(), Lamb.size());
+                reader.get(Ldiff.data(), Ldiff.size());
+                reader.get(Lspec.data(), Lspec.size());
+                glViewport(pixels[0], pixels[1], pixels[2], pixels[3]);
+                current = 0;
+                break;
+            }
+            case FrameRecorder::Draw:
+            {
+                const GLuint id(reader.get<GLuint>());
+                const ShaderFeature f(reader.getFeature());
+                const GLuint index(reader.get<GLuint>());
+                GLfloat modelview[16], normalMatrix[9];
+                reader.get(modelview, 16);
+                reader.get(normalMatrix, 9);
+                if(id >= shapes.size() || !shapes[id]) break;
+
+                // シェーダが切り替わったときだけ共通の uniform 変数を設定する（main と同じ呼び出し）
+                const ShaderVariants::Variant &v(variants.get(f));
+                if(v.program != current)
+                {
+                    current = v.program;
+                    glUseProgram(v.program);
+                    glUniform1i(v.materialLoc, 0);
+                    glUniformMatrix4fv(v.projectionLoc, 1, GL_FALSE, projection);
+                    ShaderVariants::setLights(v, lights, Lview.data(), Lamb.data(), Ldiff.data(), Lspec.data());
+                }
+                glUniformMatrix4fv(v.modelviewLoc, 1, GL_FALSE, modelview);
+                glUniformMatrix3fv(v.normalMatrixLoc, 1, GL_FALSE, normalMatrix);
+                glUniform1i(v.materialIndexLoc, index < materialIndex.size() ? materialIndex[index] : 0);
+                shapes[id] -> draw();
+                ++drawCalls;
+                break;
+            }
+            case FrameRecorder::DrawParticles:
+            {
+                GLfloat particleProjection[16], modelview[16], pointSize, color[3];
+                reader.get(particleProjection, 16);
+                reader.get(modelview, 16);
+                reader.get(&pointSize);
+                reader.get(color, 3);
+                if(particles)
+                {
+                    particles -> draw(particleProjection, modelview, pointSize, color);
+                    passes.back().particles += particles -> size();
+                }
+                current = 0;
+                break;
+            }
+            case FrameRecorder::EndFrame:
+            {
+                glFlush();
+                const double t1(now());
+
+                // GPU の処理の完了を待つ
+                glFinish();
+                const double t2(now());
+
+                cpu.push_back((t1 - t0) * 1000.0);
+                ++passes.back().frames;
+                passes.back().cpu += cpu.back();
+                frameTotal += (t2 - t0) * 1000.0;
+                if(slowest < 0 || cpu.back() > slowestTime)
+                {
+                    slowest = frame;
+                    slowestTime = cpu.back();
+                }
+                GlTrace::instance().endFrame();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        //壊れたログは途中で止める
+        if(reader.fail())
+        {
+            std::cerr << "Error: Broken record file: " << input << std::endl;
+            return 1;
+        }
+
+        //この繰り返しの描画命令の数（始めたときの累計を引く）
+        passes.back().drawCalls = drawCalls - passes.back().drawCalls;
+    }
+    if(cpu.empty())
+    {
+        std::cerr << "Error: No frame recorded in " << input << std::endl;
+        return 1;
+    }
+
+    // 統計を求める
+    std::vector<double> sorted(cpu);
+    std::sort(sorted.begin(), sorted.end());
+    double sum(0.0);
+    for(double c : cpu) sum += c;
+    const double frames(static_cast<double>(cpu.size()));
+
+    std::ofstream file;
+    if(output != NULL)
+    {
+        file.open(output);
+        if(file.fail())
+        {
+            std::cerr << "Error: Can't open output file: " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out(output != NULL ? file : std::cout);
+    out << "{" << std::endl;
+    out << "  \"name\": \"replay\"," << std::endl;
+    out << "  \"file\": \"" << input << "\"," << std::endl;
+    out << "  \"frames\": " << cpu.size() << "," << std::endl;
+    out << "  \"drawCalls\": " << static_cast<long>(drawCalls / frames) << "," << std::endl;
+    out << "  \"cpuMean\": " << sum / frames << "," << std::endl;
+    out << "  \"cpuMedian\": " << sorted[sorted.size() / 2] << "," << std::endl;
+    out << "  \"cpuP95\": " << sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)] << "," << std::endl;
+    out << "  \"cpuMax\": " << sorted.back() << "," << std::endl;
+    out << "  \"slowestFrame\": " << slowest << "," << std::endl;
+    out << "  \"frameMean\": " << frameTotal / frames << "," << std::endl;
+    out << "  \"total\": " << frameTotal << "," << std::endl;
+    out << "  \"passes\": [" << std::endl;
+    for(size_t i = 0; i < passes.size(); i++)
+    {
+        const PassStats &p(passes[i]);
+        out << "    { \"frames\": " << p.frames
+            << ", \"cpuMean\": " << (p.frames > 0 ? p.cpu / p.frames : 0.0)
+            << ", \"drawCalls\": " << p.drawCalls
+            << ", \"particles\": " << p.particles << " }" << (i + 1 < passes.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+
+    GlTrace::instance().dump(std::cerr);
+}